@@ -0,0 +1,272 @@
+//
+//  checkpoint.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "checkpoint.h"
+
+//Number of 'long long int' of the checkpoint file: number, size, identity,
+//ranges and the slots
+#define CHECKPOINT_HEADER       4
+#define CHECKPOINT_SLOT         3
+#define CHECKPOINT_VALUES       (CHECKPOINT_HEADER + CHECKPOINT_SLOT * PKT_MAX_STREAMS)
+
+
+/*  Return the path of the checkpoint of a file: the same name, in the same
+ *  directory, with a '.' before and CHECKPOINT_SUFFIX after
+ */
+static char *checkpoint_path(const char *filename) {
+    const char *name = strrchr(filename, '/');
+    size_t dir, size;
+    char *path;
+    
+    name = name != NULL ? name + 1 : filename;
+    dir = (size_t) (name - filename);
+    size = strlen(filename) + strlen(CHECKPOINT_SUFFIX) + 2;
+    path = malloc(size * sizeof(char));
+    if (path == NULL) {
+        perror("malloc() in checkpoint_path()");
+        exit(EXIT_FAILURE);
+    }
+    if (snprintf(path, size, "%.*s.%s%s", (int) dir, filename, name, CHECKPOINT_SUFFIX) < 0) {
+        perror("snprintf() in checkpoint_path()");
+        exit(EXIT_FAILURE);
+    }
+    return path;
+}
+
+/*  Read the checkpoint file into 'map'. Return the number of ranges, or -1 if
+ *  the file is not a valid checkpoint
+ */
+static int read_map(int fd, long long int *map) {
+    ssize_t n = pread(fd, map, sizeof(long long int) * CHECKPOINT_VALUES, 0);
+    
+    if (n < (ssize_t) (sizeof(long long int) * CHECKPOINT_HEADER))
+        return -1;
+    if (map[3] < 1 || map[3] > PKT_MAX_STREAMS)
+        return -1;
+    if (n < (ssize_t) (sizeof(long long int) * (size_t) (CHECKPOINT_HEADER + CHECKPOINT_SLOT * map[3])))
+        return -1;
+    return (int) map[3];
+}
+
+/*  Allocate a 'checkpoint' for the ranges in 'map' */
+static struct checkpoint *checkpoint_from_map(int fd, char *path, long long int *map) {
+    struct checkpoint *cp = malloc(sizeof(struct checkpoint));
+    int i;
+    
+    if (cp == NULL) {
+        fprintf(stderr, "Error in checkpoint_from_map(): cannot allocate memory for checkpoint\n");
+        exit(EXIT_FAILURE);
+    }
+    cp->fd = fd;
+    cp->path = path;
+    cp->ranges = (int) map[3];
+    for (i = 0; i < cp->ranges; ++i) {
+        cp->first[i] = map[CHECKPOINT_HEADER + CHECKPOINT_SLOT * i];
+        cp->last[i] = map[CHECKPOINT_HEADER + CHECKPOINT_SLOT * i + 1];
+    }
+    return cp;
+}
+
+struct checkpoint *new_checkpoint(const char *filename, unsigned long long int number, unsigned long long int size,
+                                  long long int identity, long long int first, int streams) {
+    long long int map[CHECKPOINT_VALUES];
+    long long int *slot;
+    size_t length;
+    char *path;
+    int i, fd;
+    
+    if (CHECKPOINT_INTERVAL == 0)
+        return NULL;
+    
+    path = checkpoint_path(filename);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0664);
+    if (fd == -1) {
+        perror("open() in new_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    map[0] = (long long int) number;
+    map[1] = (long long int) size;
+    map[2] = identity;
+    map[3] = streams;
+    for (i = 0; i < streams; ++i) {
+        //The same ranges of the streams, with nothing written yet
+        slot = map + CHECKPOINT_HEADER + CHECKPOINT_SLOT * i;
+        get_stream_range(first, (long long int) number, streams, i, &slot[0], &slot[1]);
+        slot[2] = slot[0];
+    }
+    length = sizeof(long long int) * (size_t) (CHECKPOINT_HEADER + CHECKPOINT_SLOT * streams);
+    if (pwrite(fd, map, length, 0) != (ssize_t) length) {
+        perror("pwrite() in new_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    return checkpoint_from_map(fd, path, map);
+}
+
+struct checkpoint *open_checkpoint(const char *filename) {
+    long long int map[CHECKPOINT_VALUES];
+    char *path;
+    int fd;
+    
+    if (CHECKPOINT_INTERVAL == 0)
+        return NULL;
+    
+    path = checkpoint_path(filename);
+    fd = open(path, O_RDWR);
+    if (fd == -1 || read_map(fd, map) < 0) {
+        if (fd != -1)
+            close(fd);
+        free(path);
+        return NULL;
+    }
+    return checkpoint_from_map(fd, path, map);
+}
+
+void checkpoint_update(struct checkpoint *cp, long long int first, long long int next) {
+    long long int map[CHECKPOINT_VALUES];
+    off_t offset;
+    int i, ranges;
+    
+    if (cp == NULL)
+        return;
+    
+    for (i = 0; i < cp->ranges && cp->first[i] != first; ++i);
+    if (i == cp->ranges)
+        return;
+    //Only this range writes its slot, so the streams do not need a lock
+    offset = (off_t) (sizeof(long long int) * (size_t) (CHECKPOINT_HEADER + CHECKPOINT_SLOT * i + 2));
+    if (pwrite(cp->fd, &next, sizeof(next), offset) != (ssize_t) sizeof(next)) {
+        perror("pwrite() in checkpoint_update()");
+        exit(EXIT_FAILURE);
+    }
+    if (next <= cp->last[i])
+        return;
+    //The range is complete: if the other ones are complete too, the file is
+    //complete and the checkpoint is not needed anymore
+    if ((ranges = read_map(cp->fd, map)) < 0)
+        return;
+    for (i = 0; i < ranges; ++i) {
+        if (map[CHECKPOINT_HEADER + CHECKPOINT_SLOT * i + 2] <= map[CHECKPOINT_HEADER + CHECKPOINT_SLOT * i + 1])
+            return;
+    }
+    //More streams can find the file complete at the same time
+    if (unlink(cp->path) == -1 && errno != ENOENT) {
+        perror("unlink() in checkpoint_update()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+long long int checkpoint_resume(const char *filename, unsigned long long int *number, unsigned long long int *size, long long int *identity) {
+    long long int map[CHECKPOINT_VALUES];
+    long long int *slot, resume = 0;
+    char *path;
+    int i, fd, ranges;
+    
+    *number = *size = 0;
+    *identity = 0;
+    if (CHECKPOINT_INTERVAL == 0)
+        return 0;
+    
+    path = checkpoint_path(filename);
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1)
+        return 0;
+    if ((ranges = read_map(fd, map)) > 0) {
+        *number = (unsigned long long int) map[0];
+        *size = (unsigned long long int) map[1];
+        *identity = map[2];
+        //No range written yet, or all of them complete: from the beginning
+        resume = 1;
+        //The first range not complete: the packets before its first missing
+        //one are all written
+        for (i = 0; i < ranges; ++i) {
+            slot = map + CHECKPOINT_HEADER + CHECKPOINT_SLOT * i;
+            if (slot[2] <= slot[1]) {
+                resume = slot[2];
+                break;
+            }
+        }
+    }
+    close(fd);
+    return resume;
+}
+
+char *checkpoint_search(char *filename) {
+    unsigned long long int number, file_size;
+    long long int identity;
+    char *path = NULL;
+    size_t size;
+    int retries = 0;
+    
+    while (1) {
+        //The names tried by 'search_file()': 'filename', '(1)filename', ...
+        if (retries == 0)
+            size = (size_t) snprintf(NULL, 0, "%s/%s", DATA_DIR, filename) + 1;
+        else
+            size = (size_t) snprintf(NULL, 0, "%s/(%d)%s", DATA_DIR, retries, filename) + 1;
+        path = realloc(path, size * sizeof(char));
+        if (path == NULL) {
+            perror("realloc() in checkpoint_search()");
+            exit(EXIT_FAILURE);
+        }
+        if (retries == 0)
+            snprintf(path, size, "%s/%s", DATA_DIR, filename);
+        else
+            snprintf(path, size, "%s/(%d)%s", DATA_DIR, retries, filename);
+        //No more copies of the file
+        if (access(path, F_OK) == -1)
+            break;
+        //A copy with a valid checkpoint, even if nothing was written yet
+        if (checkpoint_resume(path, &number, &file_size, &identity) > 0)
+            return path;
+        retries++;
+    }
+    free(path);
+    return NULL;
+}
+
+char *checkpoint_output(char *filename, long long int first) {
+    char *output = checkpoint_search(filename);
+    
+    //No partial copy: a new file, with a name not yet used
+    if (output == NULL)
+        return search_file(filename);
+    //The transfer starts again from the beginning: the bytes of the copy are
+    //not valid anymore (the file can be shorter than the copy)
+    if (first <= 1 && truncate(output, 0) == -1) {
+        perror("truncate() in checkpoint_output()");
+        exit(EXIT_FAILURE);
+    }
+    return output;
+}
+
+void checkpoint_delete(struct checkpoint *cp) {
+    if (cp == NULL)
+        return;
+    close(cp->fd);
+    free(cp->path);
+    free(cp);
+}
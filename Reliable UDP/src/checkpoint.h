@@ -0,0 +1,196 @@
+//
+//  checkpoint.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'checkpoint' of a file being received, that
+//  allows to resume a transfer that died (for example because the sender
+//  reached MAX_RETRIES_SENDING_PKT, or the receiver MAX_INACTIVITY_TIME),
+//  instead of starting it again from the beginning.
+//  The checkpoint is a small file next to the file being received (see
+//  CHECKPOINT_SUFFIX in 'settings.h'). It contains the number of packets, the
+//  size and the identity of the file (the time of its last modification on the
+//  sender, see 'get_modification_time()' in 'utils.h'), and, for each range of
+//  blocks being received (one for each stream, see 'streams.h'), the first
+//  packet of the range not yet written. Every CHECKPOINT_INTERVAL packets
+//  written, 'receive_range()' (see 'get.h') saves its progress in its own slot
+//  with 'checkpoint_update()', so the streams of a transfer (threads of the
+//  client or workers of the server) never write the same bytes. When all the
+//  ranges are complete, the checkpoint is removed.
+//  Before a GET, the client looks for a partial copy of the file with a
+//  checkpoint, and asks the server to send only the packets from the first one
+//  missing onwards. Before a PUT, the server does the same, and tells the
+//  client where to start (see PKT_FLAG_RESUME in 'packet.h'). A transfer is
+//  resumed only if the file of the sender has the same size and identity, that
+//  the sender puts in its request or response (see 'packet_set_file_info()' in
+//  'packet.h'), so a file modified in the meantime is not mixed with the bytes
+//  of its old version. Otherwise, the
+//  transfer starts again from the beginning into the same partial copy (see
+//  'checkpoint_output()'), so a copy that can not be resumed is never left in
+//  DATA_DIR next to the new one.
+//  The packets received after the first one missing are received again: with a
+//  single stream, at most CHECKPOINT_INTERVAL packets, but with more streams
+//  also all the packets already written in the ranges after the first one not
+//  complete, because only a single first packet is sent in the handshake.
+//
+//  The checkpoint file is an array of 'long long int', in the byte order of the
+//  machine:
+//
+//  ---------------------------------------------------------------------------------------
+//  | number | size | identity | ranges | first 1 | last 1 | next 1 | first 2 | ...        |
+//  ---------------------------------------------------------------------------------------
+//
+//  where 'next i' is the first packet of the range i not yet written (last i + 1
+//  if the range is complete).
+
+
+#ifndef __Reliable_UDP__checkpoint__
+#define __Reliable_UDP__checkpoint__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "settings.h"
+#include "packet.h"
+#include "utils.h"
+
+struct checkpoint {
+    int fd;                                 //The checkpoint file
+    char *path;                             //Path of the checkpoint file
+    int ranges;                             //Number of ranges of blocks being received
+    long long int first[PKT_MAX_STREAMS];   //First packet of each range
+    long long int last[PKT_MAX_STREAMS];    //Last packet of each range
+};
+
+
+/*  This function creates the checkpoint of a file that is going to be received
+ *  (a previous checkpoint of the file is overwritten). The packets from 'first'
+ *  to 'number' are split into 'streams' ranges, like the server does (see
+ *  'get_stream_range()' in 'utils.h').
+ *
+ *  Parameters:
+ *  - filename:     Path of the file being received
+ *  - number:       Number of packets of the file
+ *  - size:         Size of the file in bytes
+ *  - identity:     Identity of the file, sent by the sender
+ *  - first:        First packet to receive (the previous ones are already written)
+ *  - streams:      Number of streams of the transfer
+ *
+ *  Return:         Pointer to a new 'checkpoint' (NULL if CHECKPOINT_INTERVAL is 0)
+ */
+struct checkpoint *new_checkpoint(const char *filename, unsigned long long int number, unsigned long long int size,
+                                  long long int identity, long long int first, int streams);
+
+
+/*  This function opens the checkpoint of a file created by another process
+ *  with 'new_checkpoint()' (for example, by the father process of the server).
+ *
+ *  Parameters:
+ *  - filename:     Path of the file being received
+ *
+ *  Return:         Pointer to a new 'checkpoint' (NULL if the file has no
+ *                  checkpoint, or if CHECKPOINT_INTERVAL is 0)
+ */
+struct checkpoint *open_checkpoint(const char *filename);
+
+
+/*  This function saves the progress of a range: all its packets before 'next'
+ *  are written in the file. If 'next' is beyond the end of the range, and all
+ *  the other ranges are complete too, the checkpoint file is removed.
+ *
+ *  Parameters:
+ *  - cp:       The 'checkpoint' (if NULL, nothing is done)
+ *  - first:    First packet of the range (it identifies the range)
+ *  - next:     First packet of the range not yet written
+ *
+ *  Return:     Nothing
+ */
+void checkpoint_update(struct checkpoint *cp, long long int first, long long int next);
+
+
+/*  This function reads the checkpoint of a file, and calculates from which
+ *  packet its transfer can be resumed.
+ *
+ *  Parameters:
+ *  - filename:     Path of the file
+ *  - number:       Where the number of packets of the file is saved (0 if
+ *                  the file has no checkpoint)
+ *  - size:         Where the size of the file is saved (0 if the file has no
+ *                  checkpoint)
+ *  - identity:     Where the identity of the file is saved (0 if the file has
+ *                  no checkpoint)
+ *
+ *  Return:         The first packet not yet written of the first range not
+ *                  complete, so all the packets before it are written (1 if
+ *                  no packet was written yet, or if the file is complete), or
+ *                  0 if the file has no valid checkpoint
+ */
+long long int checkpoint_resume(const char *filename, unsigned long long int *number, unsigned long long int *size, long long int *identity);
+
+
+/*  This function looks in DATA_DIR for a partial copy of a file, with a valid
+ *  checkpoint (even if the transfer died before any packet was written). The names are tried in the same order of 'search_file()' (see
+ *  'utils.h'): 'filename', '(1)filename', '(2)filename' and so on, while they
+ *  exist.
+ *
+ *  Parameters:
+ *  - filename:     Name of the file
+ *
+ *  Return:         The path of the partial copy (to free with 'free()'), or
+ *                  NULL if no copy has a checkpoint
+ */
+char *checkpoint_search(char *filename);
+
+
+/*  This function chooses the file where a transfer is received: the partial
+ *  copy of the file found with 'checkpoint_search()', if any, otherwise a new
+ *  file with 'search_file()' (see 'utils.h'). If the transfer starts from the
+ *  first packet, the copy is emptied, and it is received again from scratch.
+ *
+ *  Parameters:
+ *  - filename:     Name of the file
+ *  - first:        First packet to receive (1, unless the transfer is resumed)
+ *
+ *  Return:         The path of the file (to free with 'free()')
+ */
+char *checkpoint_output(char *filename, long long int first);
+
+
+/*  This function closes and deletes a 'checkpoint'. The checkpoint file is not
+ *  removed: it remains until the transfer is complete.
+ *
+ *  Parameters:
+ *  - cp:       The 'checkpoint' to delete (it can be NULL)
+ *
+ *  Return:     Nothing
+ */
+void checkpoint_delete(struct checkpoint *cp);
+
+
+#endif /* defined(__Reliable_UDP__checkpoint__) */
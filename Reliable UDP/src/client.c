@@ -33,9 +33,13 @@
 //  1)  The user types in the operation that he wants to make
 //  2)  The client connects to the server welcome port and requires the execution
 //      of operation
-//  3)  The client receives the communication port number from the server
-//  4)  The client begins the operation
+//  3)  The client receives the communication port number from the server (and
+//      a connection ID, if the server runs all the transfers on its welcome port)
+//  4)  The client begins the operation (split into many streams, each with its
+//      own communication port, if the server grants them for a GET or a PUT)
 //  5)  At the end, the client return to listening a for new operation
+//  A GET or a PUT of a file whose last transfer died is resumed from the first
+//  packet missing in the partial copy of the receiver (see 'checkpoint.h').
 
 
 #include <sys/types.h>
@@ -49,6 +53,8 @@
 #include "put.h"
 #include "get.h"
 #include "list.h"
+#include "streams.h"
+#include "checkpoint.h"
 #include "strings.h"
 
 
@@ -56,11 +62,14 @@
  *
  *  verbose_mode:   if 1, the verbose mode will be activated
  *  log_file:       if 1, the log file will be written
+ *  cc_selected:    congestion control of the transfers (CONGESTION_CONTROL in
+ *                  'settings.h', unless it is chosen with '-cc')
  *
  *  These variables are configured via input
  */
 int verbose_mode = 0;
 int log_file = 0;
+int cc_selected = CONGESTION_CONTROL;
 
 
 /*  This function is used to read the help file when user type HELP on the
@@ -101,8 +110,15 @@ void read_help_file() {
  *  request, it selects a communication port for data transmission.
  *  All data received from the server at this stage, is saved in a 'long int'
  *  array (named 'data'), that will contains the communication port selected
- *  by server (data[0]) and, depending on the case, the number of packets
- *  to receive (data[1]).
+ *  by server (data[0]), depending on the case, the number of packets
+ *  to receive (data[1]) and the connection ID of the transfer (data[2]).
+ *  For a GET or a PUT, the first packet to transfer is saved in data[3]: it is
+ *  1, unless the transfer resumes one that died (see 'checkpoint.h').
+ *  A GET or a PUT asks for TRANSFER_STREAMS streams (see 'settings.h'): the
+ *  number of streams granted by the server is saved in data[4]. The size and
+ *  the identity of the file are saved in data[5] and data[6], and the
+ *  communication ports of the streams from data[7] onwards (data[7] is the
+ *  same port of data[0]).
  *
  *  Parameters:
  *  - type:     Type of pkt to send (PKT_PUT, PKT_GET, PKT_LS)
@@ -110,9 +126,12 @@ void read_help_file() {
  *  - addr:     Address to send the pkt for connection request
  *  - filename: The name of file to receive or to send
  *
- *  Return:     A two element array that contains the communication port selected
- *              by server (data[0]) and, depending on the case, the number of
- *              packets to receive (data[1])
+ *  Return:     An array that contains the communication port selected by
+ *              server (data[0]), depending on the case, the number of packets
+ *              to receive (data[1]), the connection ID (data[2]), the first
+ *              packet to transfer (data[3]), the number of streams (data[4]),
+ *              the size and the identity of the file (data[5] and data[6])
+ *              and their ports (data[7]...)
  *
  *
  *
@@ -124,7 +143,8 @@ void read_help_file() {
  *              and the fields are filled as follows:
  *              - type:         PKT_PUT
  *              - seq:          0, because it is the first pkt
- *              - data:         the name of file to send
+ *              - data:         the name of file to send (and its size
+ *                              and identity, see below)
  *              - dimension:    number of pkts to send
  *              The server responds by sending an ACK packet on successful, 
  *              otherwise a PKT_ERR packet. On successful, the received packet
@@ -135,9 +155,11 @@ void read_help_file() {
  *  2) GET:     The client sends a PKT_GET packet with fields filled as
  *              follow:
  *              - type:         PKT_GET
- *              - seq:          0, because it is the first pkt
+ *              - seq:          0, because it is the first pkt (or the first
+ *                              packet missing of a partial copy, see below)
  *              - data:         the name of the file you want to receive
- *              - dimension:    0
+ *                              (and the size and identity of the partial copy)
+ *              - dimension:    0 (or the number of packets of the partial copy)
  *              The server looks for the requested file. If the file is not found, 
  *              it sends a ERR_PKT. Otherwise, the server calculates the number of 
  *              packets required to send the file, and responds with a PKT_ACK 
@@ -158,14 +180,43 @@ void read_help_file() {
  *              port for data transmission, and in the field 'date' the number 
  *              of packets that must be sent.
  *
+ *  The receiving process of a GET or a PUT looks for a partial copy of the file,
+ *  left by a transfer that died (see 'checkpoint.h'). For a GET, the client
+ *  puts in the request the first packet missing ('seq') and the number of
+ *  packets of its copy ('dimension'), and the size and the identity of the
+ *  file saved in the checkpoint of the copy after the name of the file (see
+ *  'packet_set_file_info()' in 'packet.h'); for a PUT, the client always puts
+ *  the size and the identity of its file, and the server looks for its own
+ *  copy. The response carries in the field 'data' the number of packets, the
+ *  size and the identity of the file (the receiver saves them in its
+ *  checkpoint). If the copy has the same size and identity of the file, the
+ *  response has PKT_FLAG_RESUME, and the field 'data' carries the first packet
+ *  to transfer after them.
+ *
+ *  If more than one stream is granted for a GET or a PUT, the response carries
+ *  the number of streams in its flags (see PKT_STREAMS_MASK in 'packet.h'), and
+ *  the field 'data' ends with the ports of the streams after the first one.
+ *  Each stream transfers its own range of blocks of the file (see
+ *  'get_stream_range()' in 'utils.h').
+ *
+ *  In all the cases, the event-driven server (option '-e') selects its welcome
+ *  port and puts a connection ID in the response: the transfer runs on 'sockfd',
+ *  and each packet carries the connection ID. The other servers use 0.
+ *  The datagrams left on 'sockfd' by a previous transfer are not responses, so
+ *  they are discarded while waiting for the response.
  */
 long int *sendCMD(int type, int sockfd, struct sockaddr_in addr, char *old_filename) {
     unsigned long long int size = 0;
     unsigned long long int number = 0;
     char *filename = NULL;
     //Allocate memory for the array
-    long int *data = malloc(sizeof(long int) * 2);
+    long int *data = malloc(sizeof(long int) * (7 + PKT_MAX_STREAMS));
     struct packet *pkt = NULL;
+    char *next, *end;
+    long int port;
+    long long int first = 0;
+    long long int identity = 0;
+    int streams;
     if (data == NULL) {
         perror("malloc()\n");
         exit(EXIT_FAILURE);
@@ -182,18 +233,39 @@ long int *sendCMD(int type, int sockfd, struct sockaddr_in addr, char *old_filen
         filename = old_filename;
     
     //Initialize elements
-    data[0] = data[1] = (long int) 0;
+    data[0] = data[1] = data[2] = (long int) 0;
+    data[3] = data[4] = (long int) 1;
+    data[5] = data[6] = (long int) 0;
     //If it is a PUT operation, calculate number of pkts to send
     if (type == PKT_PUT) {
             size = get_dimension(filename);
             number = get_number(size);
+            identity = get_modification_time(filename);
+    }
+    //If it is a GET operation, look for a partial copy of the file to resume
+    else if (type == PKT_GET && (filename = checkpoint_search(old_filename)) != NULL) {
+            first = checkpoint_resume(filename, &number, &size, &identity);
+            free(filename);
+            filename = old_filename;
     }
     //Create the pkt
-    pkt = new_packet(type, 0, old_filename, number);
+    pkt = new_packet(type, first, old_filename, number);
+    //The receiver resumes its partial copy only if it is of the same file
+    if (type == PKT_PUT || (type == PKT_GET && first > 0))
+        packet_set_file_info(pkt, size, identity);
+    //Ask the server to use the same congestion control of the client
+    pkt->flags = (cc_selected << PKT_CC_SHIFT) & PKT_CC_MASK;
+    //...and to split a GET or a PUT into many streams
+    if (type == PKT_GET || type == PKT_PUT)
+        pkt->flags |= (TRANSFER_STREAMS << PKT_STREAMS_SHIFT) & PKT_STREAMS_MASK;
     //Send the pkt
     send_pkt(sockfd, pkt, addr);
     //Receive the response pkt
-    pkt = recv_pkt(sockfd, NULL, NULL);
+    pkt = recv_pkt(sockfd, NULL, NULL, NULL);
+    while (pkt->type != PKT_ERR && (pkt->type != PKT_ACK || pkt->seq != 0 || (pkt->flags & PKT_FLAG_SACK))) {
+        free(pkt);
+        pkt = recv_pkt(sockfd, NULL, NULL, NULL);
+    }
     //If the response is a PKT_ERR, print on screen the error and exit
     if (pkt->type == PKT_ERR) {
         fprintf(stderr, "%s\n", pkt->data);
@@ -201,15 +273,34 @@ long int *sendCMD(int type, int sockfd, struct sockaddr_in addr, char *old_filen
     }
     //If the response is a PKT_ACK...
     else {
-        //...save the port number...
+        //...save the port number and the connection ID...
         data[0] = (long int) pkt->dimension;
+        data[2] = (long int) pkt->conn;
+        data[7] = data[0];
         //...if it is a GET or LIST operation, save the number of pkts to receive too
         if (type == PKT_GET || type == PKT_LS)
-            /*  I can use atol() because i am sure that the server sends a
-             *  'long int' type. If it was not sure, i should have used the
-             *  'strtol()' function, wich is more secure.
-             */
-            data[1] = atol(pkt->data);  //Convert the string in a 'long int'
+            data[1] = strtol(pkt->data, &next, 10);
+        if (type == PKT_GET || type == PKT_PUT) {
+            next = pkt->data;
+            strtol(next, &next, 10);
+            //...the size and the identity of the file...
+            data[5] = (long int) strtoull(next, &next, 10);
+            data[6] = (long int) strtoll(next, &next, 10);
+            //...the first packet to transfer, if the server resumes the transfer...
+            if ((pkt->flags & PKT_FLAG_RESUME) && (first = strtoll(next, &end, 10)) > 1) {
+                data[3] = (long int) first;
+                next = end;
+            }
+            //...and the ports of the other streams, if the server granted them
+            streams = (int) ((pkt->flags & PKT_STREAMS_MASK) >> PKT_STREAMS_SHIFT);
+            for (data[4] = 1; data[4] < streams; ++data[4]) {
+                port = strtol(next, &end, 10);
+                if (end == next || port <= 0)
+                    break;
+                data[7 + data[4]] = port;
+                next = end;
+            }
+        }
     }
     return data;
 }
@@ -221,27 +312,21 @@ int main(int argc, char *argv[]) {
     select_language(LANG_EN);
     
     //Input control begin
-    if (argc > 4 || argc < 2) {
+    if (argc > 6 || argc < 2) {
         fprintf(stderr, "%s\n", _(STRING_CLIENT_INSTRUCTION));
         exit(EXIT_FAILURE);
     }
-    if (argc >= 3) {
-        if (strcmp(argv[2], "-l") == 0)     //log service activated
-            log_file = 1;
-        else if (strcmp(argv[2], "-v") == 0)//verbose mode activated
-            verbose_mode = 1;
-        else {
-            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[1]);
-            exit(EXIT_FAILURE);
-        }
-    }
-    if (argc == 4) {
-        if (strcmp(argv[3], "-l") == 0)     //log service activated
+    int i;
+    for (i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-l") == 0)     //log service activated
             log_file = 1;
-        else if (strcmp(argv[3], "-v") == 0)//verbose service activated
+        else if (strcmp(argv[i], "-v") == 0)//verbose mode activated
             verbose_mode = 1;
+        //congestion control selected: "none", "reno" or "cubic"
+        else if (strcmp(argv[i], "-cc") == 0 && i + 1 < argc && congestion_control_parse(argv[i + 1]) != -1)
+            cc_selected = congestion_control_parse(argv[++i]);
         else {
-            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[3]);
+            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[i]);
             exit(EXIT_FAILURE);
         }
     }
@@ -321,7 +406,14 @@ int main(int argc, char *argv[]) {
                         break;
                     }
                     //Prepare and send the file
-                    send_file((int)port[0], argv[1], sockfd, fd, my_name, LS_CLIENT, NULL, log, verbose_mode);
+                    if (port[4] > 1)
+                        send_streams(my_name, port[3], (int) port[4], port + 7, argv[1], verbose_mode, log, cc_selected);
+                    //A resumed transfer sends only the packets that the server misses
+                    else if (port[3] > 1)
+                        send_range((int)port[0], argv[1], sockfd, fd, get_dimension(my_name), port[3], (long long int) get_number(get_dimension(my_name)),
+                                   LS_CLIENT, NULL, log, verbose_mode, cc_selected, (unsigned int) port[2]);
+                    else
+                        send_file((int)port[0], argv[1], sockfd, fd, my_name, LS_CLIENT, NULL, log, verbose_mode, cc_selected, (unsigned int) port[2]);
                     //Close the file
                     close_file(fd);
                 }
@@ -335,7 +427,10 @@ int main(int argc, char *argv[]) {
                     break;
                 }
                 //Prepare to receive the file
-                receive_file(operation+4, (int)port[0], port[1], LS_CLIENT, argv[1], sockfd, verbose_mode, NULL, log);
+                if (port[4] > 1)
+                    receive_streams(operation+4, port[1], (unsigned long long int) port[5], port[6], port[3], (int) port[4], port + 7, argv[1], verbose_mode, log);
+                else
+                    receive_file(operation+4, (int)port[0], port[1], (unsigned long long int) port[5], port[6], port[3], LS_CLIENT, argv[1], sockfd, verbose_mode, NULL, log, (unsigned int) port[2]);
                 break;
             //LIST OPERATION
             case PKT_LS:
@@ -347,7 +442,7 @@ int main(int argc, char *argv[]) {
                 //Remove previous file list if exists
                 remove_list(LIST_FILE);
                 //Prepare to receive the new file list
-                receive_file(NULL, (int)port[0], port[1], LS_CLIENT, argv[1], sockfd, verbose_mode, NULL, log);
+                receive_file(NULL, (int)port[0], port[1], 0, 0, 1, LS_CLIENT, argv[1], sockfd, verbose_mode, NULL, log, (unsigned int) port[2]);
                 //Print file list on the screen
                 print_list();
                 break;
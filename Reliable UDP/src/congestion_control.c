@@ -0,0 +1,200 @@
+//
+//  congestion_control.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "congestion_control.h"
+
+
+/*  CC_NONE: the congestion window is always the whole sliding window */
+
+static void none_on_ack(struct congestion_control *cc, int acked, long double rtt) {
+    (void) cc;
+    (void) acked;
+    (void) rtt;
+}
+
+static void none_on_loss(struct congestion_control *cc, int timeout) {
+    (void) cc;
+    (void) timeout;
+}
+
+
+/*  CC_RENO: slow start and additive increase, multiplicative decrease */
+
+static void reno_on_ack(struct congestion_control *cc, int acked, long double rtt) {
+    (void) rtt;
+    if (cc->cwnd < cc->ssthresh)
+        cc->cwnd += acked;                      //Slow start: +1 packet for each ACK
+    else
+        cc->cwnd += (double) acked / cc->cwnd;  //Congestion avoidance: +1 packet for each RTT
+}
+
+static void reno_on_loss(struct congestion_control *cc, int timeout) {
+    cc->ssthresh = cc->cwnd / 2 < 2 ? 2 : cc->cwnd / 2;
+    //After a timeout the ACK clock is lost: restart from slow start
+    cc->cwnd = timeout == 1 ? 1 : cc->ssthresh;
+}
+
+
+/*  CC_CUBIC: RFC 8312 */
+
+static void cubic_on_ack(struct congestion_control *cc, int acked, long double rtt) {
+    long long int now = get_monotonic_usec();
+    double t, target;
+    
+    if (cc->cwnd < cc->ssthresh) {              //Slow start, as in Reno
+        cc->cwnd += acked;
+        return;
+    }
+    
+    //Start a new epoch of growth from the current 'cwnd'
+    if (cc->epoch_start == 0) {
+        cc->epoch_start = now;
+        if (cc->cwnd < cc->w_max) {
+            cc->k = cbrt((cc->w_max - cc->cwnd) / CUBIC_C);
+            cc->origin = cc->w_max;
+        }
+        else {
+            cc->k = 0;
+            cc->origin = cc->cwnd;
+        }
+        cc->w_est = cc->cwnd;
+    }
+    
+    //W(t) = C x (t - K)^3 + origin, evaluated one RTT ahead
+    t = (now - cc->epoch_start + rtt) / 1000000.0;
+    target = CUBIC_C * (t - cc->k) * (t - cc->k) * (t - cc->k) + cc->origin;
+    
+    //Approach the target in one RTT, growing at least slowly
+    if (target > cc->cwnd)
+        cc->cwnd += (target - cc->cwnd) * acked / cc->cwnd;
+    else
+        cc->cwnd += 0.01 * acked / cc->cwnd;
+    
+    //TCP-friendly region: never grow slower than Reno with the same decrease
+    cc->w_est += 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * acked / cc->cwnd;
+    if (cc->w_est > cc->cwnd)
+        cc->cwnd = cc->w_est;
+}
+
+static void cubic_on_loss(struct congestion_control *cc, int timeout) {
+    cc->epoch_start = 0;
+    //Fast convergence: if the window is shrinking, release bandwidth to the others
+    if (cc->cwnd < cc->w_max)
+        cc->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+    else
+        cc->w_max = cc->cwnd;
+    cc->ssthresh = cc->cwnd * CUBIC_BETA < 2 ? 2 : cc->cwnd * CUBIC_BETA;
+    cc->cwnd = timeout == 1 ? 1 : cc->ssthresh;
+}
+
+
+struct congestion_control *new_congestion_control(int algorithm, int max_cwnd) {
+    struct congestion_control *cc;
+    
+    cc = malloc(sizeof(struct congestion_control));
+    if (cc == NULL) {
+        fprintf(stderr, "Error in new_congestion_control(): cannot allocate memory for congestion_control\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    if (algorithm != CC_NONE && algorithm != CC_RENO && algorithm != CC_CUBIC)
+        algorithm = CONGESTION_CONTROL;
+    
+    cc->algorithm = algorithm;
+    cc->max_cwnd = max_cwnd < 1 ? 1 : max_cwnd;
+    cc->cwnd = CC_INITIAL_WINDOW < cc->max_cwnd ? CC_INITIAL_WINDOW : cc->max_cwnd;
+    cc->ssthresh = cc->max_cwnd;                //No threshold until the first loss
+    cc->recover = 0;
+    cc->w_max = 0;
+    cc->origin = 0;
+    cc->k = 0;
+    cc->w_est = 0;
+    cc->epoch_start = 0;
+    
+    switch (algorithm) {
+        case CC_RENO:
+            cc->on_ack = reno_on_ack;
+            cc->on_loss = reno_on_loss;
+            break;
+        case CC_CUBIC:
+            cc->on_ack = cubic_on_ack;
+            cc->on_loss = cubic_on_loss;
+            break;
+        default:
+            cc->cwnd = cc->max_cwnd;
+            cc->on_ack = none_on_ack;
+            cc->on_loss = none_on_loss;
+            break;
+    }
+    
+    return cc;
+}
+
+int congestion_control_parse(const char *name) {
+    if (strcmp(name, "none") == 0)
+        return CC_NONE;
+    if (strcmp(name, "reno") == 0)
+        return CC_RENO;
+    if (strcmp(name, "cubic") == 0)
+        return CC_CUBIC;
+    return -1;
+}
+
+int congestion_control_window(struct congestion_control *cc) {
+    int cwnd = (int) cc->cwnd;
+    if (cwnd < 1)
+        return 1;
+    if (cwnd > cc->max_cwnd)
+        return cc->max_cwnd;
+    return cwnd;
+}
+
+void congestion_control_on_ack(struct congestion_control *cc, int acked, long double rtt) {
+    if (acked <= 0)
+        return;
+    cc->on_ack(cc, acked, rtt);
+    //'cwnd' can not grow beyond the sliding window, or it would keep growing
+    //while the sender is limited by the window
+    if (cc->cwnd > cc->max_cwnd)
+        cc->cwnd = cc->max_cwnd;
+}
+
+void congestion_control_on_loss(struct congestion_control *cc, long long int seq, long long int last_sent) {
+    if (seq <= cc->recover)                     //Already handled in this window
+        return;
+    cc->recover = last_sent;
+    cc->on_loss(cc, 0);
+}
+
+void congestion_control_on_timeout(struct congestion_control *cc, long long int seq, long long int last_sent) {
+    if (seq <= cc->recover)
+        return;
+    cc->recover = last_sent;
+    cc->on_loss(cc, 1);
+}
+
+void congestion_control_delete(struct congestion_control *cc) {
+    free(cc);
+}
@@ -0,0 +1,168 @@
+//
+//  congestion_control.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'congestion_control' data structure, used by
+//  the sending process to decide how many packets can be in flight. The limit
+//  is the congestion window ('cwnd'), always smaller than the sliding window:
+//  'window_controller' does not send a new packet while the packets in the
+//  'window' are 'cwnd' or more. The algorithm is selected for each transfer,
+//  and it is implemented by two functions, called by 'window_controller':
+//
+//  - on_ack:       some packets were acked for the first time
+//  - on_loss:      a packet was lost: it was detected by the ACKs (fast
+//                  retransmit) or its timer expired ('timeout' == 1)
+//
+//  Available algorithms:
+//
+//  CC_NONE:        'cwnd' is always equal to the sliding window (no congestion
+//                  control, as in the previous releases)
+//  CC_RENO:        NewReno-style AIMD: slow start up to 'ssthresh', then 'cwnd'
+//                  grows by one packet for each RTT; on loss 'cwnd' is halved,
+//                  on timeout it restarts from one packet
+//  CC_CUBIC:       CUBIC: after a loss, 'cwnd' grows as a cubic function of the
+//                  time elapsed, independently from the RTT, quickly near the
+//                  window of the last loss and slowly around it
+//
+//  A loss is handled only once for each window of data: the losses of the
+//  packets sent before the last reduction ('recover') are ignored, so a burst
+//  of losses (or the timeouts of all the packets in flight) halves 'cwnd' once.
+
+
+#ifndef __Reliable_UDP__congestion_control__
+#define __Reliable_UDP__congestion_control__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "settings.h"
+#include "utils.h"
+
+
+enum cc_algorithm {CC_NONE, CC_RENO, CC_CUBIC};
+
+
+/*  Initial congestion window, in packets (RFC 6928) */
+#define CC_INITIAL_WINDOW   10
+
+/*  Multiplicative decrease and scaling constant of CUBIC (RFC 8312) */
+#define CUBIC_BETA          0.7
+#define CUBIC_C             0.4
+
+
+struct congestion_control {
+    int algorithm;                  //Algorithm in use (see 'cc_algorithm')
+    double cwnd;                    //Congestion window (in packets)
+    double ssthresh;                //Slow start threshold (in packets)
+    int max_cwnd;                   //Maximum congestion window: the capacity of the 'window'
+    long long int recover;          //Last sequence number sent when 'cwnd' was reduced
+    double w_max;                   //CUBIC: 'cwnd' before the last reduction
+    double origin;                  //CUBIC: 'cwnd' reached by the cubic function after 'k' secs
+    double k;                       //CUBIC: time (in secs) to reach 'origin'
+    double w_est;                   //CUBIC: 'cwnd' that Reno would have (TCP-friendly region)
+    long long int epoch_start;      //CUBIC: start of the current growth (usecs), 0 if not started
+    //Functions of the algorithm
+    void (*on_ack)(struct congestion_control *cc, int acked, long double rtt);
+    void (*on_loss)(struct congestion_control *cc, int timeout);
+};
+
+
+/*  This function creates a new 'congestion_control' data structure.
+ *
+ *  Parameters:
+ *  - algorithm:    The algorithm to use (from 'cc_algorithm'). An unknown value
+ *                  selects CONGESTION_CONTROL (see 'settings.h')
+ *  - max_cwnd:     Maximum congestion window (in packets)
+ *
+ *  Return:         Pointer to a new initialized 'congestion_control'
+ */
+struct congestion_control *new_congestion_control(int algorithm, int max_cwnd);
+
+
+/*  This function returns the algorithm with the given name, as it is typed by
+ *  the user ("none", "reno" or "cubic").
+ *
+ *  Parameters:
+ *  - name:         Name of the algorithm
+ *
+ *  Return:         The algorithm (from 'cc_algorithm'), -1 if the name is unknown
+ */
+int congestion_control_parse(const char *name);
+
+
+/*  This function returns the number of packets that can be in flight.
+ *
+ *  Parameters:
+ *  - cc:           Pointer to the 'congestion_control'
+ *
+ *  Return:         The congestion window, between 1 and 'max_cwnd'
+ */
+int congestion_control_window(struct congestion_control *cc);
+
+
+/*  This function must be called when some packets are acked for the first time.
+ *
+ *  Parameters:
+ *  - cc:           Pointer to the 'congestion_control'
+ *  - acked:        Number of packets acked
+ *  - rtt:          The smoothed RTT (in usecs), 0 if unknown
+ *
+ *  Return:         Nothing
+ */
+void congestion_control_on_ack(struct congestion_control *cc, int acked, long double rtt);
+
+
+/*  This function must be called when a packet is detected as lost from the
+ *  ACKs, before its timer expires.
+ *
+ *  Parameters:
+ *  - cc:           Pointer to the 'congestion_control'
+ *  - seq:          Sequence number of the packet lost
+ *  - last_sent:    Last sequence number sent
+ *
+ *  Return:         Nothing
+ */
+void congestion_control_on_loss(struct congestion_control *cc, long long int seq, long long int last_sent);
+
+
+/*  This function must be called when the timer of a packet expires.
+ *
+ *  Parameters:
+ *  - cc:           Pointer to the 'congestion_control'
+ *  - seq:          Sequence number of the packet
+ *  - last_sent:    Last sequence number sent
+ *
+ *  Return:         Nothing
+ */
+void congestion_control_on_timeout(struct congestion_control *cc, long long int seq, long long int last_sent);
+
+
+/*  This function frees all memory occupied by a 'congestion_control' */
+void congestion_control_delete(struct congestion_control *cc);
+
+
+#endif /* defined(__Reliable_UDP__congestion_control__) */
@@ -0,0 +1,413 @@
+//
+//  event_server.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "event_server.h"
+
+//Maximum number of events handled with a single 'epoll_wait()'
+#define EVENT_BATCH_SIZE    64
+
+
+/*  Bucket of a connection ID in the hash table of a loop */
+static int bucket(unsigned int conn) {
+    return (int) (conn % EVENT_MAX_SESSIONS);
+}
+
+/*  Search the session of a connection ID, NULL if it does not exist */
+static struct session *lookup(struct event_loop *loop, unsigned int conn) {
+    struct session *s;
+    
+    for (s = loop->table[bucket(conn)]; s != NULL; s = s->hnext)
+        if (s->conn == conn)
+            return s;
+    return NULL;
+}
+
+/*  Reserve a place for a new session and choose its connection ID.
+ *  It returns 0 if there are already EVENT_MAX_SESSIONS sessions.
+ */
+static unsigned int new_conn(struct event_loop *loop) {
+    struct event_server *es = loop->server;
+    unsigned int conn = 0;
+    
+    get_mutex(&es->MTX);
+    if (es->count < EVENT_MAX_SESSIONS) {
+        es->count++;
+        //The IDs are unique for all the loops; 0 is not a valid ID
+        do {
+            conn = es->next_conn++;
+        } while (conn == 0 || lookup(loop, conn) != NULL);
+    }
+    release_mutex(&es->MTX);
+    
+    return conn;
+}
+
+/*  Release the place of a session */
+static void put_conn(struct event_loop *loop) {
+    get_mutex(&loop->server->MTX);
+    loop->server->count--;
+    release_mutex(&loop->server->MTX);
+}
+
+/*  Arm the 'timerfd' of a loop at the earliest deadline of its sessions */
+static void arm_timer(struct event_loop *loop) {
+    struct itimerspec its;
+    struct session *s;
+    long long int deadline = -1, t;
+    
+    for (s = loop->sessions; s != NULL; s = s->next) {
+        t = session_next_deadline(s);
+        if (deadline == -1 || t < deadline)
+            deadline = t;
+    }
+    
+    //Without sessions, the timer is disarmed
+    memset((void *)&its, 0, sizeof(its));
+    if (deadline > 0) {
+        its.it_value.tv_sec = deadline / 1000000;
+        its.it_value.tv_nsec = (deadline % 1000000) * 1000;
+    }
+    if (timerfd_settime(loop->tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        perror("timerfd_settime() in event_loop");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*  Create the session for a request, and send the response to the client.
+ *  It returns the new session, or NULL if the request was refused.
+ */
+static struct session *handle_request(struct event_loop *loop, struct packet *pkt, struct sockaddr_in addr) {
+    struct event_server *es = loop->server;
+    struct session *s = NULL;
+    struct packet *response;
+    char *filename;
+    char data[64];
+    size_t length;
+    unsigned int conn;
+    int fd, cc;
+    unsigned long long int size = 0, info_size;
+    long long int identity = 0;
+    
+    //The size and the identity of the file in a GET or a PUT are not used: the
+    //sessions never resume a transfer, so only the name of the file remains
+    packet_get_file_info(pkt, &info_size, &identity);
+    
+    //Congestion control chosen by the client, used to send the file
+    cc = (pkt->flags & PKT_CC_MASK) >> PKT_CC_SHIFT;
+    
+    conn = new_conn(loop);
+    if (conn == 0) {
+        print_max_processes_msg(es->log, es->status);
+        response = new_packet(PKT_ERR, 0, _(STRING_SERVER_BUSY_ERR), 0);
+        send_pkt(loop->sockfd, response, addr);
+        free(response);
+        return NULL;
+    }
+    
+    switch (pkt->type) {
+        //PUT REQUEST RECEIVED
+        case PKT_PUT:
+            print_request_accepted(es->log, es->status);
+            s = new_recv_session(loop->sockfd, addr, conn, pkt->data, (long long int) pkt->dimension,
+                                 es->status, es->log, es->verbose);
+            break;
+        //GET REQUEST RECEIVED
+        case PKT_GET:
+            //Modify the filename to search inside the right directory
+            length = strlen(pkt->data) + strlen(DATA_DIR) + 2;
+            filename = malloc(length * sizeof(char));
+            if (filename == NULL || snprintf(filename, length, "%s/%s", DATA_DIR, pkt->data) < 0) {
+                perror("snprintf() in handle_request() [case PKT_GET]");
+                exit(EXIT_FAILURE);
+            }
+            fd = open(filename, O_RDONLY);
+            if (fd == -1) {
+                print_file_not_found_msg(es->log, es->status, pkt->data);
+                free(filename);
+                put_conn(loop);
+                response = new_packet(PKT_ERR, 0, _(STRING_FILE_NOT_FOUND), 0);
+                send_pkt(loop->sockfd, response, addr);
+                free(response);
+                return NULL;
+            }
+            print_request_accepted(es->log, es->status);
+            size = get_dimension(filename);
+            identity = get_modification_time(filename);
+            free(filename);
+            s = new_send_session(loop->sockfd, addr, conn, fd, size, cc, "GET", es->status, es->log, es->verbose);
+            break;
+        //LIST REQUEST RECEIVED
+        case PKT_LS:
+            //The list file is removed as soon as it is opened: the session
+            //reads it through 'fd', and the name can be used by another request
+            print_request_accepted(es->log, es->status);
+            filename = create_list();
+            fd = open_file(READ, filename);
+            size = get_dimension(filename);
+            if (remove(filename) != 0) {
+                perror("remove() in handle_request() [case PKT_LS]");
+                exit(EXIT_FAILURE);
+            }
+            free(filename);
+            s = new_send_session(loop->sockfd, addr, conn, fd, size, cc, "LIST", es->status, es->log, es->verbose);
+            break;
+    }
+    
+    //The transfer runs on SERV_PORT, with the connection ID of the session.
+    //The number of packets is sent only for the files that the client receives,
+    //and for a GET also the size and the identity of the file (see 'checkpoint.h')
+    if (pkt->type == PKT_PUT)
+        response = new_packet(PKT_ACK, 0, NULL, (size_t) SERV_PORT);
+    else {
+        if (pkt->type == PKT_GET)
+            snprintf(data, sizeof(data), "%llu %llu %lld", s->data.number, size, identity);
+        else
+            snprintf(data, sizeof(data), "%llu", s->data.number);
+        response = new_packet(PKT_ACK, 0, data, (size_t) SERV_PORT);
+    }
+    response->conn = conn;
+    send_pkt(loop->sockfd, response, addr);
+    free(response);
+    
+    //Add the session to the loop
+    s->next = loop->sessions;
+    loop->sessions = s;
+    s->hnext = loop->table[bucket(conn)];
+    loop->table[bucket(conn)] = s;
+    
+    return s;
+}
+
+/*  Receive all the datagrams ready on the socket of a loop */
+static void recv_all(struct event_loop *loop) {
+    struct packet *batch[IO_BATCH_SIZE];
+    struct sockaddr_in addrs[IO_BATCH_SIZE];
+    //Sessions that received packets in the batch
+    struct session *touched[IO_BATCH_SIZE];
+    struct session *s;
+    int i, j, n, t;
+    
+    do {
+        n = recv_pkts_from(loop->sockfd, loop->pool, batch, addrs, IO_BATCH_SIZE);
+        t = 0;
+        for (i = 0; i < n; ++i) {
+            //A request creates a new session
+            if (batch[i]->conn == 0 && (batch[i]->type == PKT_PUT || batch[i]->type == PKT_GET || batch[i]->type == PKT_LS))
+                s = handle_request(loop, batch[i], addrs[i]);
+            //The other packets are given to their session. The packets of a
+            //session already over are discarded
+            else {
+                s = lookup(loop, batch[i]->conn);
+                if (s != NULL)
+                    session_recv_pkt(s, batch[i]);
+            }
+            packet_pool_put(loop->pool, batch[i]);
+            
+            for (j = 0; j < t && touched[j] != s; ++j);
+            if (s != NULL && j == t)
+                touched[t++] = s;
+        }
+        //Send the ACKs of the batch and the packets allowed by the ACKs
+        for (j = 0; j < t; ++j)
+            session_run(touched[j]);
+    } while (n > 0);
+}
+
+/*  Delete the sessions that are over */
+static void remove_sessions(struct event_loop *loop) {
+    struct session **p = &loop->sessions, **h, *s;
+    
+    while (*p != NULL) {
+        s = *p;
+        if (session_is_over(s) == 1) {
+            *p = s->next;
+            for (h = &loop->table[bucket(s->conn)]; *h != s; h = &(*h)->hnext);
+            *h = s->hnext;
+            session_delete(s);
+            put_conn(loop);
+        }
+        else
+            p = &s->next;
+    }
+}
+
+/*  Function executed by each event loop */
+static void *event_loop_work(void *arg) {
+    struct event_loop *loop = (struct event_loop *) arg;
+    struct epoll_event events[EVENT_BATCH_SIZE];
+    struct session *s;
+    uint64_t value;
+    long long int now;
+    int i, n;
+    
+    while (1) {
+        n = epoll_wait(loop->epfd, events, EVENT_BATCH_SIZE, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait() in event_loop");
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < n; ++i) {
+            //Datagrams: requests, ACKs and packets of the files
+            if (events[i].data.ptr == &loop->sockfd)
+                recv_all(loop);
+            //A deadline has expired: move forward all the sessions that are late
+            else {
+                if (read(loop->tfd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    perror("read() of timerfd in event_loop");
+                    exit(EXIT_FAILURE);
+                }
+                now = get_monotonic_usec();
+                for (s = loop->sessions; s != NULL; s = s->next)
+                    if (session_next_deadline(s) <= now)
+                        session_run(s);
+            }
+        }
+        remove_sessions(loop);
+        arm_timer(loop);
+    }
+    
+    return NULL;
+}
+
+/*  Create the socket of an event loop, bound to SERV_PORT */
+static int new_loop_socket(void) {
+    struct sockaddr_in addr;
+    int sockfd, one = 1;
+    
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        perror("socket() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    memset((void *)&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(SERV_PORT);
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    
+    return sockfd;
+}
+
+/*  Initialize an event loop on a socket */
+static void init_loop(struct event_server *es, struct event_loop *loop, int sockfd) {
+    struct epoll_event ev;
+    int flags, size = EVENT_SOCKET_BUFFER;
+    
+    loop->server = es;
+    loop->sessions = NULL;
+    loop->sockfd = sockfd;
+    loop->pool = new_packet_pool(IO_BATCH_SIZE);
+    loop->table = calloc(EVENT_MAX_SESSIONS, sizeof(struct session *));
+    if (loop->table == NULL) {
+        fprintf(stderr, "Error in event_server_run(): cannot allocate memory for hash table\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    flags = fcntl(sockfd, F_GETFL, 0);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        perror("fcntl() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    //The socket is shared by all the sessions of the loop
+    if (setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0 ||
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0) {
+        perror("setsockopt() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    loop->epfd = epoll_create1(0);
+    loop->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (loop->epfd < 0 || loop->tfd < 0) {
+        perror("epoll_create1() or timerfd_create() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    //The two descriptors of the loop are identified by their address
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop->sockfd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->sockfd, &ev) < 0) {
+        perror("epoll_ctl() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+    ev.data.ptr = &loop->tfd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->tfd, &ev) < 0) {
+        perror("epoll_ctl() in event_server_run()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void event_server_run(int sockfd, struct server_status *status, FILE *log, int verbose) {
+    struct event_server *es;
+    long n;
+    int i;
+    
+    es = malloc(sizeof(struct event_server));
+    if (es == NULL) {
+        fprintf(stderr, "Error in event_server_run(): cannot allocate memory for event_server\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_mutex_init(&es->MTX, NULL) != 0) {
+        fprintf(stderr, "Error in event_server_run(): cannot initialize mutex\n");
+        exit(EXIT_FAILURE);
+    }
+    es->count = 0;
+    es->next_conn = 1;
+    es->status = status;
+    es->log = log;
+    es->verbose = verbose;
+    
+    //One event loop for each core, if EVENT_LOOPS is 0
+    n = EVENT_LOOPS;
+    if (n <= 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n <= 0)
+        n = 1;
+    es->n = (int) n;
+    es->loops = malloc(sizeof(struct event_loop) * es->n);
+    if (es->loops == NULL) {
+        fprintf(stderr, "Error in event_server_run(): cannot allocate memory for event loops\n");
+        exit(EXIT_FAILURE);
+    }
+    //All the sockets join the SO_REUSEPORT group before the first request
+    init_loop(es, &es->loops[0], sockfd);
+    for (i = 1; i < es->n; ++i)
+        init_loop(es, &es->loops[i], new_loop_socket());
+    for (i = 1; i < es->n; ++i) {
+        if (pthread_create(&es->loops[i].thread, NULL, event_loop_work, &es->loops[i]) != 0) {
+            perror("pthread_create() in event_server_run()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    print_waiting_msg(log, status);
+    es->loops[0].thread = pthread_self();
+    event_loop_work(&es->loops[0]);
+}
@@ -0,0 +1,101 @@
+//
+//  event_server.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the event-driven mode of the server (option '-e').
+//  In the default mode, the server creates a child process for each request,
+//  and each child uses its own port, a thread for the ACKs and a thread for the
+//  timeouts, so at most MAX_PROCESSES_NUMBER transfers run at the same time.
+//  In the event-driven mode, the server does not create processes and does not
+//  use other ports: each transfer is a 'session' (see 'session.h') owned by an
+//  event loop, and it is identified by a connection ID carried by all its packets
+//  (see PKT_HEADER_SIZE in 'packet.h').
+//  There are EVENT_LOOPS event loops, each one with its own socket bound to
+//  SERV_PORT with SO_REUSEPORT: the kernel sends all the datagrams of a client
+//  socket to the same loop, so the request and all the packets of a transfer
+//  arrive to the loop that owns its session, without locks between the loops.
+//  Each loop waits with 'epoll' for:
+//  - its socket: a request creates a new session, the other packets are given
+//    to the session of their connection ID, found in a hash table
+//  - a 'timerfd', armed at the earliest deadline of its sessions (a timeout,
+//    the 'pacer', the inactivity)
+//  At most EVENT_MAX_SESSIONS transfers run at the same time.
+
+
+#ifndef __Reliable_UDP__event_server__
+#define __Reliable_UDP__event_server__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "settings.h"
+#include "session.h"
+#include "server_status.h"
+#include "list.h"
+
+
+struct event_loop {
+    pthread_t thread;               //Thread of the loop (the first loop uses the main thread)
+    int epfd;                       //'epoll' instance
+    int tfd;                        //'timerfd': earliest deadline of the sessions
+    int sockfd;                     //Non-blocking socket bound to SERV_PORT
+    struct packet_pool *pool;       //Packets received, until they are given to a session
+    struct session *sessions;       //Sessions owned by the loop
+    struct session **table;         //Hash table of the sessions, by connection ID
+    struct event_server *server;    //The server of the loop
+};
+
+
+struct event_server {
+    struct event_loop *loops;       //Array of event loops
+    int n;                          //Number of event loops
+    pthread_mutex_t MTX;            //Mutex for 'count' and 'next_conn'
+    int count;                      //Number of sessions of all the loops
+    unsigned int next_conn;         //Next connection ID
+    struct server_status *status;   //To print messages
+    FILE *log;                      //Log file (can be NULL)
+    int verbose;                    //1 if verbose mode is on
+};
+
+
+/*  This function starts the event loops and serves the requests forever. The
+ *  main thread runs the first event loop.
+ *
+ *  Parameters:
+ *  - sockfd:       Socket bound to SERV_PORT, with SO_REUSEPORT
+ *  - status:       Pointer to 'server_status', to print messages
+ *  - log:          Log file (can be NULL)
+ *  - verbose:      1 if verbose mode is on
+ *
+ *  Return:         Nothing (it never returns)
+ */
+void event_server_run(int sockfd, struct server_status *status, FILE *log, int verbose);
+
+
+#endif /* defined(__Reliable_UDP__event_server__) */
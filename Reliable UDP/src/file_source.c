@@ -0,0 +1,95 @@
+//
+//  file_source.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "file_source.h"
+
+struct file_source *new_file_source(int fd, unsigned long long int size) {
+    struct file_source *src = malloc(sizeof(struct file_source));
+    void *map;
+    
+    if (src == NULL) {
+        fprintf(stderr, "Error in new_file_source(): cannot allocate memory for file_source\n");
+        exit(EXIT_FAILURE);
+    }
+    src->fd = fd;
+    src->size = size;
+    src->offset = 0;
+    src->end = size;
+    src->map = NULL;
+    
+    if (FILE_SOURCE_MMAP == 1 && size > 0) {
+        map = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+        //If the file can not be mapped, it is read with 'read()'
+        if (map != MAP_FAILED)
+            src->map = map;
+    }
+    
+    return src;
+}
+
+void file_source_set_range(struct file_source *src, long long int first, long long int last) {
+    src->offset = (unsigned long long int) (first - 1) * MAX_BLOCK_SIZE;
+    src->end = (unsigned long long int) last * MAX_BLOCK_SIZE;
+    if (src->end > src->size)
+        src->end = src->size;
+    if (src->offset > src->end)
+        src->offset = src->end;
+    //Without the map, the blocks are read from the first one of the range
+    if (src->map == NULL && lseek(src->fd, (off_t) src->offset, SEEK_SET) == -1) {
+        perror("lseek() in file_source_set_range()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+size_t file_source_fill(struct file_source *src, struct packet *pkt) {
+    unsigned long long int left = src->end - src->offset;
+    size_t dimension = left >= MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : (size_t) left;
+    ssize_t m;
+    
+    if (dimension == 0)
+        return 0;
+    if (src->map != NULL)
+        pkt->payload = src->map + src->offset;
+    else {
+        m = read(src->fd, pkt->data, dimension);
+        if (m < 0 || (size_t) m != dimension) {
+            perror("read() in file_source_fill()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pkt->dimension = dimension;
+    src->offset += dimension;
+    
+    return dimension;
+}
+
+void file_source_delete(struct file_source *src) {
+    if (src->map != NULL && munmap(src->map, (size_t) src->size) == -1) {
+        perror("munmap() in file_source_delete()");
+        exit(EXIT_FAILURE);
+    }
+    free(src);
+}
@@ -0,0 +1,114 @@
+//
+//  file_source.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'file_source' data structure, that gives the
+//  blocks of a file to the sending process (see 'send_file()' in 'put.c' and
+//  'session.h'). If FILE_SOURCE_MMAP is 1 (see 'settings.h'), the whole file is
+//  mapped in memory with 'mmap()': the 'payload' of each packet points to the
+//  pages of its block (see 'packet.h'), and the block is sent from there with
+//  'sendmsg()'. So a block is never read into the packet, nor copied into a
+//  buffer to be sent, and the retransmissions of a packet refer to the same
+//  pages.
+//  If the file can not be mapped (for example because it is empty), or if
+//  FILE_SOURCE_MMAP is 0, each block is read with 'read()' into the 'data'
+//  field of the packet, as before.
+//  A stream of a transfer split into many streams (see 'streams.h') sends only
+//  a range of blocks of the file: 'file_source_set_range()' limits the blocks
+//  given to the packets to that range.
+
+
+#ifndef __Reliable_UDP__file_source__
+#define __Reliable_UDP__file_source__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "settings.h"
+#include "packet.h"
+
+struct file_source {
+    int fd;                             //File to send
+    char *map;                          //The file mapped in memory (NULL if it is read with 'read()')
+    unsigned long long int size;        //Size of the file in bytes
+    unsigned long long int offset;      //Offset of the next block to give to a packet
+    unsigned long long int end;         //Offset where the blocks to give end (the size, if the whole file is sent)
+};
+
+
+/*  This function creates a new 'file_source' for a file already opened, and
+ *  maps it in memory if FILE_SOURCE_MMAP is 1.
+ *
+ *  Parameters:
+ *  - fd:       The file to send (it is not closed by 'file_source_delete()')
+ *  - size:     Size of the file in bytes
+ *
+ *  Return:     Pointer to a new initialized 'file_source'
+ */
+struct file_source *new_file_source(int fd, unsigned long long int size);
+
+
+/*  This function limits the blocks given by 'file_source_fill()' to a range of
+ *  blocks of the file, from 'first' to 'last' (included).
+ *
+ *  Parameters:
+ *  - src:      The 'file_source'
+ *  - first:    Sequence number of the first block (the first block of the file is 1)
+ *  - last:     Sequence number of the last block
+ *
+ *  Return:     Nothing
+ */
+void file_source_set_range(struct file_source *src, long long int first, long long int last);
+
+
+/*  This function gives the next block of the file to a PKT_DATA, and sets its
+ *  'dimension'. The block is referred by 'payload' if the file is mapped in
+ *  memory, otherwise it is read into the 'data' field.
+ *
+ *  Parameters:
+ *  - src:      The 'file_source'
+ *  - pkt:      The packet to fill
+ *
+ *  Return:     Number of bytes of the block (0 if the whole file was already given)
+ */
+size_t file_source_fill(struct file_source *src, struct packet *pkt);
+
+
+/*  This function deletes a 'file_source' and unmaps the file. It must be called
+ *  only when no packet refers to the file anymore.
+ *
+ *  Parameters:
+ *  - src:      The 'file_source' to delete
+ *
+ *  Return:     Nothing
+ */
+void file_source_delete(struct file_source *src);
+
+
+#endif /* defined(__Reliable_UDP__file_source__) */
@@ -34,9 +34,9 @@ void sig_handler(int sig) {
     (void) sig;
     //Print user message
     print_interrupted_operation_msg(LOG, STATUS, USER);
-    //Free port that was used before receiving signal
+    //Free port that was used before receiving signal, and the process
     if (USER == LS_SERVER)
-        close_port1(STATUS, getpid());
+        process_terminated(STATUS, getpid());
     //Kill current process. If the user == LS_CLIENT, kill the entire program
     _exit(0);
 }
@@ -63,69 +63,54 @@ void install_signal_handler(void) {
 }
 
 
-/*  In the event that the sliding window is full, this function allows you to 
- *  request forcibly sending a package, and still receive packets until the 
- *  required package not reach its destination.
- *
- *  Parameters:
- *  - min:      The sequence number of the required packet
- *  - sockfd:   Descriptor for the socket
- *  - addr:     Address of the sending process
- *
- *  Return:     The required packet
- */
-struct packet *recovery_mode(long long int min, int sockfd, struct sockaddr_in addr) {
-    int flag = 0, retries = 0;
-    socklen_t len;
-    struct packet *pkt = NULL;
-    struct packet *req = new_packet(PKT_REQ, min, NULL, 0);
-    //Send a request for a specific packet
-    send_pkt(sockfd, req, addr);
-    
-    while (flag == 0) {
-        len = sizeof(addr);
-        //Receive packet
-        pkt = recv_pkt(sockfd, &addr, &len);
-        //If the packet is what was requested, exit the loop and return.
-        //Else, continue to receive packets.
-        if (pkt->seq == min && is_accepted() == 1)
-            flag = 1;
-        else {
-            free(pkt);
-            retries++;
-            //Every 10 retries, send a request pkt to sending process
-            if (retries == 10) {
-                retries = 0;
-                send_pkt(sockfd, req, addr);
-            }
-        }
-    }
-    return pkt;
-}
-
-void receive_file(char *filename, int childPort, long int pkts_number, int user, char *ip, int old_sockfd, int verbose_mode, struct server_status *status, FILE *log) {
-    USER = user;        //Set global variables
-    LOG = log;          //
-    STATUS = status;    //
+void receive_file(char *filename, int childPort, long int pkts_number, unsigned long long int size, long long int identity, long long int first, int user, char *ip, int old_sockfd, int verbose_mode, struct server_status *status, FILE *log, unsigned int conn) {
     /*  fd:     if 'filename' == NULL, 'fd' represent the file descriptor for the
      *          list file. Infact, when a client requests the list of files to the server,
      *          the storage location of this text file is stored in LIST_FILE maco,
      *          so 'filename' must be NULL.
      *          See the case 'PKT_LS' in 'client.c' and 'server.c' to see how server
      *          and client work to get/send the file list
-     *
-     *  end:    this variable represents a marker to verify when the reception of a 
+     */
+    int fd;
+    struct checkpoint *cp = NULL;
+    if (filename != NULL) {
+        //resume the partial copy of the file, or search if the file name already exists
+        char *output = checkpoint_output(filename, first);
+        fd = open_file(WRITE, output);
+        cp = new_checkpoint(output, (unsigned long long int) pkts_number, size, identity, first, 1);
+        free(output);
+    }
+    else {
+        //create a file for the list file
+        fd = open_file(WRITE, LIST_FILE);
+        first = 1;
+    }
+    //The packets are written at their own offsets: reserve the space of the file
+    allocate_file(fd, pkts_number);
+    //The whole file is a single range, from the first packet to the last one
+    receive_range(fd, first, pkts_number, childPort, user, ip, old_sockfd, verbose_mode, status, log, conn, filename != NULL ? "GET" : "LIST", cp);
+    checkpoint_delete(cp);
+    close_file(fd);                 //close the file just written
+}
+
+
+void receive_range(int fd, long long int first, long long int last, int childPort, int user, char *ip, int old_sockfd, int verbose_mode,
+                   struct server_status *status, FILE *log, unsigned int conn, const char *operation, struct checkpoint *cp) {
+    USER = user;        //Set global variables
+    LOG = log;          //
+    STATUS = status;    //
+    /*  end:    this variable represents a marker to verify when the reception of a 
      *          file is finished. This variable is setted initially to 0. When
      *          a PKT_FIN si received, end is setted to 1 and the function exits 
      *          the loop of waiting for new packets
      */
-    int new_sockfd = old_sockfd, fd, end = 0;
+    int new_sockfd = old_sockfd, end = 0;
     /*  These variables are used to calculate and write the percentage of completion 
      *  of the transaction in progress.
      */
     int percentage = 0, last_percentage = 0;
-    /*  min:        it represents the sequence number of the last packet written into the file.
-     *              For more details, see 'write_contiguous()' in window_controller.h' and
+    /*  min:        it represents the sequence number of the first packet not yet received.
+     *              For more details, see 'window_controller_advance()' in window_controller.h' and
      *              'window_controller.c'.
      *
      *  total:      it represents the total number of packets arrived, including those
@@ -133,7 +118,9 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
      *
      *  discarded:  it represents the total number of discarded packets
      */
-    long long int min = 1, total = 0, discarded = 0;
+    long long int min = first, total = 0, discarded = 0;
+    //Number of packets of the range, and its size (used to calculate the download speed)
+    long int pkts_number = last >= first ? (long int) (last - first + 1) : 0;
     unsigned long long int size = MAX_BLOCK_SIZE * pkts_number;
     struct sockaddr_in addr;
     socklen_t len;
@@ -148,42 +135,23 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
     long long int laps = 0;
     /* This variable is used to calculate the average time */
     double average = 0.0;
-    /* See comment about variable 'end' at the beginning of this function */
-    if (filename != NULL) {
-        //search if the file name already exists
-        char *output = search_file(filename);
-        fd = open_file(WRITE, output);
-    }
-    else {
-        //create a file for the list file
-        fd = open_file(WRITE, LIST_FILE);
-    }
     
     struct packet *pkt;
     //ACK packet, prepared to be sent
     struct packet *ack = new_packet(PKT_ACK, 0, NULL, 0);
+    ack->conn = conn;
+    //PKT_NACK with the ranges of packets missing, prepared to be sent
+    struct packet *nack = new_packet(PKT_NACK, 0, NULL, 0);
+    nack->conn = conn;
     struct window_controller *wc = NULL;
-    
-    /*  This array is used to idetify if a packet is already received or not.
-     *  The number of array's slots are equal to the number of packets that
-     *  it should receive.
-     *  All slots in the array are initially set to 0. When a packet is
-     *  received, the slot idetifies by sequence number of the pkt just received
-     *  is set to 1.
-     */
-    int *v = malloc(sizeof(int) * pkts_number);
-    if (v == NULL) {
-        perror("malloc() in receive_file()");
-        exit(EXIT_FAILURE);
-    }
-    int index;
-    for (index = 0; index < pkts_number; ++index)
-        v[index] = 0;
+    struct packet_pool *pool = NULL;
+    struct io_engine *io = NULL;
 
-    //Create a new socket descriptor
-    new_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    //Create a new socket descriptor, if the transfer has its own port
+    if (conn == 0)
+        new_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if(new_sockfd < 0) {
-        perror("socket() in receive_file()");
+        perror("socket() in receive_range()");
         exit(EXIT_FAILURE);
     }
     //Initalize memory
@@ -197,26 +165,32 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
     else {
         //Convert string in a dot-decimal IP address
         if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
-            perror("inet_pton() in receive_file()");
+            perror("inet_pton() in receive_range()");
             exit(EXIT_FAILURE);
         }
     }
-    //Binding
-    if(bind(new_sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("bind() in receive_file()");
+    //Binding (with a connection ID, the packets arrive on 'old_sockfd')
+    if(conn == 0 && bind(new_sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind() in receive_range()");
         exit(EXIT_FAILURE);
     }
     /*  Initialize the 'window_controller' data structure. The second parameter
      *  is NULL, because to receive files doesn't need a 'time_controller'.
      *  See 'window_controller.h' for more details.
      */
-    wc = new_window_controller(WINDOW_DIMENSION, NULL, new_sockfd, addr, fd);
+    /*  The packets are received directly into the entries of 'pool', and each
+     *  one is written as soon as it is added in the sliding window: the pool
+     *  contains a batch being received and a batch being written by the
+     *  'io_engine' (if any). See 'packet_pool.h' and 'io_engine.h' for details.
+     */
+    pool = new_packet_pool(2 * IO_BATCH_SIZE);
+    wc = new_window_controller(WINDOW_DIMENSION, NULL, new_sockfd, addr, fd, pool, CC_NONE);
+    window_controller_start_at(wc, first);
+    io = new_io_engine(pool);
+    wc->io = io;
     
     //Print messages
-    if (filename != NULL)
-        print_operation_started_msg(log, status, user, "GET");
-    else
-        print_operation_started_msg(log, status, user, "LIST");
+    print_operation_started_msg(log, status, user, operation);
     print_pkt_to_receive(log, status, user, pkts_number);
     
     /*  Install a new signal handler.
@@ -227,16 +201,54 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
     alarm(MAX_INACTIVITY_TIME);
     //Start timer
     set_timer(timer, TIMER_START);
+    /*  Delayed ACKs (see DELAYED_ACK_PKTS in 'settings.h'): 'pending' is the
+     *  number of packets received in order and not yet acked, 'deadline' is the
+     *  time (CLOCK_MONOTONIC, in usecs) within which they have to be acked.
+     *  'delay' is set to 1 when the ACK of the packet just received can wait.
+     */
+    int pending = 0, delay;
+    long long int deadline = 0, last_min;
+    //First packet not yet written, the last time that the checkpoint was saved
+    long long int saved = first;
+    //Sequence number of the packet received, saved because the packet can be
+    //written and returned to the pool before the ACK is sent
+    long long int seq;
+    //Packets received with a single 'recv_pkts()', and index of the next one
+    struct packet *batch[IO_BATCH_SIZE];
+    int batched = 0, next = 0;
     //Run the cycle until receipt of PKT_FIN
     while (end == 0) {
-        len = sizeof(addr);
-        //Receive packet from network
-        pkt = recv_pkt(new_sockfd, &addr, &len);
+        //Submit the writes of the last batch before waiting for the next one:
+        //the kernel writes them while the process waits (see 'io_engine.h')
+        if (next == batched)
+            io_engine_submit(io, IO_BATCH_SIZE);
+        //If there are packets waiting for the ACK, wait for a new packet only
+        //until the deadline, then send the cumulative ACK
+        if (pending > 0 && next == batched && wait_pkt(new_sockfd, deadline - get_monotonic_usec()) == 0) {
+            window_controller_fill_sack(wc, ack, min);
+            send_pkt(new_sockfd, ack, addr);
+            pending = 0;
+            continue;
+        }
+        delay = 0;
+        //Receive a new batch of packets from network when the previous one is over
+        if (next == batched) {
+            len = sizeof(addr);
+            batched = recv_pkts(new_sockfd, pool, batch, IO_BATCH_SIZE, &addr, &len);
+            next = 0;
+        }
+        pkt = batch[next++];
+        //Discard the datagrams of other transfers on the same socket
+        if (pkt->conn != conn) {
+            packet_pool_put(pool, pkt);
+            continue;
+        }
+        seq = pkt->seq;
         total++;
         //Simulate loss probability
         //If pkt cannot be accepted, delete it
         if (is_accepted() == 0) {
-            free(pkt);
+            packet_pool_put(pool, pkt);
             discarded++;
         }
         
@@ -260,6 +272,9 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
             if (pkt->type == PKT_FIN) {
                 end = 1;
                 ack->type = PKT_FINACK;
+                //The whole file is written before the PKT_FINACK
+                io_engine_submit(io, 0);
+                checkpoint_update(cp, first, last + 1);
                 
                 print_fin_arrived_msg(status, user, verbose_mode);
             }
@@ -271,47 +286,67 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
             //If received pkt is PKT_DATA...
             else {
                 //If a package has already been received, send only an ack...
-                if (v[pkt->seq - 1] == 1) {
+                if (window_controller_is_received(wc, pkt->seq) == 1) {
+                    ack->type = PKT_ACK;
+                }
+                //...if it is beyond the sliding window, discard it (the sender
+                //will send it again) and send only an ack...
+                else if (window_controller_in_window(wc, pkt->seq) == 0) {
                     ack->type = PKT_ACK;
                 }
                 //...else, excecute all these operations:
                 else {
-                    //If sliding window is full, go to recovery mode
-                    if (window_controller_is_full(wc) == 1) {
-                        if (pkt->seq != min) {
-                            free(pkt);
-                            //See 'recovery_mode()' in 'get.c' for details
-                            pkt = recovery_mode(min, new_sockfd, addr);
-                        }
-                        ssize_t m;
-                        //Write pkt just received
-                        m = write(fd, pkt->data, pkt->dimension);
-                        if (m < 0 || (size_t) m != pkt->dimension) {
-                            perror("write() in receive_file()");
-                            exit(EXIT_FAILURE);
-                        }
-                        //Update the last seq. number of pkt just written
-                        min++;
-                    }
-                    //If sliding window is not full:
-                    else {
-                        //Set the pkt as arrived
-                        v[pkt->seq - 1] = 1;
-                        //Add pkt into sliding window
-                        window_controller_add_packet(wc, pkt);
-                        //Write contiguous pkts and update 'min'
-                        min = write_contiguous(wc, min);
-                        ack->type = PKT_ACK;
+                    //Add pkt into sliding window, that writes it in the file:
+                    //from now on, the window owns it
+                    window_controller_add_packet(wc, pkt);
+                    pkt = NULL;
+                    //Move the window over the contiguous pkts and update 'min'
+                    last_min = min;
+                    min = window_controller_advance(wc);
+                    ack->type = PKT_ACK;
+                    //Save the progress: the packets before 'min' must be
+                    //written, not only queued (see 'io_engine.h')
+                    if (cp != NULL && min - saved >= CHECKPOINT_INTERVAL) {
+                        io_engine_submit(io, 0);
+                        checkpoint_update(cp, first, min);
+                        saved = min;
                     }
+                    //Only a packet received in order, with no gaps after it,
+                    //can have a delayed ACK
+                    if (seq == last_min && min == last_min + 1 && window_controller_is_empty(wc) == 1)
+                        delay = 1;
                 }
+                //Request again the holes opened by a packet out of order at once,
+                //without waiting for the timeout of the sender
+                if (window_controller_fill_nack(wc, nack) > 0)
+                    send_pkt(new_sockfd, nack, addr);
             }
-            //Set sequence number for the ACK
-            ack->seq = pkt->seq;
-            //Send ACK
-            send_pkt(new_sockfd, ack, addr);
+            //Set sequence number for the ACK: the sender uses the last packet
+            //received to calculate the RTT
+            ack->seq = seq;
+            //Delay the ACK until DELAYED_ACK_PKTS packets are waiting for it
+            if (delay == 1 && ++pending < DELAYED_ACK_PKTS) {
+                if (pending == 1)
+                    deadline = get_monotonic_usec() + DELAYED_ACK_USEC;
+            }
+            else {
+                //A PKT_ACK carries the cumulative ACK and the SACK bitmap
+                if (ack->type == PKT_ACK)
+                    window_controller_fill_sack(wc, ack, min);
+                else
+                    ack->flags = 0;
+                //Send ACK
+                send_pkt(new_sockfd, ack, addr);
+                pending = 0;
+            }
+            //If the packet is not in the window, return it to the pool
+            packet_pool_put(pool, pkt);
         }
         
     }
+    //Return the packets received after the last one
+    while (next < batched)
+        packet_pool_put(pool, batch[next++]);
     //Get the last lap time
     set_timer(timer, TIMER_LAP);
     
@@ -362,13 +397,15 @@ void receive_file(char *filename, int childPort, long int pkts_number, int user,
     
     alarm(0);                       //deactivate the alarm
     free(timer);                    //free the timer
-    free(v);                        //free the vector of received pkts
     free(ack);                      //free the ack packet
+    free(nack);
     fflush(stdout);                 //empty the buffer of standard output
     fflush(log);                    //empty the buffer of 'log' file
-    close_file(fd);                 //close the file just written
-    close(new_sockfd);              //close the created socket
+    io_engine_delete(io);           //wait for the last writes
+    if (conn == 0)
+        close(new_sockfd);          //close the created socket
     window_controller_dispose(wc);  //free sliding window
+    packet_pool_delete(pool);       //free the packets
     USER = -1;                      //set global variables to default values
     STATUS = NULL;                  //
     if(log)
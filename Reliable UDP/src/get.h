@@ -31,6 +31,13 @@
 //  'receive_file' prepares the server or the client to receive a file from the
 //  network. it is advisable to view the comments within the code to study the
 //  behavior of this function, because it is very complex.
+//  'receive_range' receives only a range of blocks of the file into a file
+//  already opened: it is used by the streams of a transfer split into many
+//  streams (see 'streams.h'), and by 'receive_file', that receives the whole
+//  file as a single range.
+//  While a file is received, its progress is saved in a checkpoint (see
+//  'checkpoint.h'): if the transfer dies, the next one can be resumed from the
+//  first packet missing.
 
 
 #ifndef __Reliable_UDP__get__
@@ -48,6 +55,7 @@
 #include "server_status.h"
 #include "timer.h"
 #include "print_messages.h"
+#include "checkpoint.h"
 
 
 /*  See the ABSTRACT for details
@@ -58,6 +66,12 @@
  *  - pktsNumber:       Number of packets to receive. This number is related to 
  *                      the size of the field 'data' of each package. See
  *                      MAX_BLOCK_SIZE in 'settings.h' for more details.
+ *  - size:             Size of the file in bytes, and...
+ *  - identity:         ...identity of the file, sent by the server: they are
+ *                      saved in the checkpoint of the file (see 'checkpoint.h')
+ *  - first:            First packet to receive: 1, or the first packet missing
+ *                      if the transfer is resumed (the file is chosen with
+ *                      'checkpoint_output()', see 'checkpoint.h')
  *  - user:             ID of the caller: LS_CLIENT for client, LS_SERVER fors server
  *  - ip:               The IP of the caller. The server use NULL
  *  - old_sockfd:       Socket file descriptor previously opened
@@ -68,14 +82,40 @@
  *                      See 'server_status.h' for details. The client use NULL.
  *  - log:              Pointer to a log file previously opened. If the log
  *                      service is unavailable, 'log' is NULL.
+ *  - conn:             Connection ID of the transfer, or 0 if the transfer has
+ *                      its own port (see PKT_HEADER_SIZE in 'packet.h'). If it
+ *                      is not 0, the file is received on 'old_sockfd' and the
+ *                      datagrams of other transfers are discarded.
  *
  *  Return:             Nothing
  *
  *  Effects:
  *  Prepares the server or the client to receive a file
  */
-void receive_file(char *filename, int childPort, long int pktsNumber, int user, char *ip,
+void receive_file(char *filename, int childPort, long int pktsNumber, unsigned long long int size, long long int identity,
+                  long long int first, int user, char *ip,
                   int old_sockfd, int verbose_mode,
-                  struct server_status *status, FILE *log);
+                  struct server_status *status, FILE *log, unsigned int conn);
+
+
+/*  This function is like 'receive_file()', but it receives only the packets
+ *  from 'first' to 'last', sent by 'send_range()' (see 'put.h'), and writes
+ *  them at their offsets into a file already opened. The other packets of the
+ *  file can be written at the same time by other streams, into the same file.
+ *
+ *  Params:
+ *  - fd:               File descriptor of the file opened to write (it is not closed)
+ *  - first:            Sequence number of the first packet to receive
+ *  - last:             Sequence number of the last packet to receive
+ *  - operation:        Name of the operation, for the messages ("GET" or "LIST")
+ *  - cp:               Checkpoint of the file, where the progress of the range is
+ *                      saved every CHECKPOINT_INTERVAL packets (NULL if the
+ *                      transfer can not be resumed, as for LIST)
+ *  - others:           See 'receive_file()'
+ *
+ *  Return:             Nothing
+ */
+void receive_range(int fd, long long int first, long long int last, int childPort, int user, char *ip, int old_sockfd, int verbose_mode,
+                   struct server_status *status, FILE *log, unsigned int conn, const char *operation, struct checkpoint *cp);
 
 #endif /* defined(__Reliable_UDP__get__) */
@@ -0,0 +1,240 @@
+//
+//  io_engine.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "io_engine.h"
+
+#if IO_URING && defined(__linux__)
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+
+/* System calls of io_uring, not wrapped by the C library */
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+/* Unmap the queues and close the io_uring */
+static void unmap_rings(struct io_engine *eng, size_t sqes_size) {
+    if (eng->sqes != NULL && (void *) eng->sqes != MAP_FAILED)
+        munmap(eng->sqes, sqes_size);
+    if (eng->cq_map != NULL && eng->cq_map != MAP_FAILED && eng->cq_map != eng->sq_map)
+        munmap(eng->cq_map, eng->cq_map_size);
+    if (eng->sq_map != NULL && eng->sq_map != MAP_FAILED)
+        munmap(eng->sq_map, eng->sq_map_size);
+    close(eng->fd);
+}
+
+struct io_engine *new_io_engine(struct packet_pool *pool) {
+    struct io_engine *eng;
+    struct io_uring_params p;
+    struct iovec iov;
+    
+    eng = malloc(sizeof(struct io_engine));
+    if (eng == NULL) {
+        fprintf(stderr, "Error in new_io_engine(): cannot allocate memory for io_engine\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(eng, 0, sizeof(struct io_engine));
+    memset(&p, 0, sizeof(p));
+    //Two batches: the one being submitted and the one still being written
+    eng->fd = sys_io_uring_setup(2 * IO_BATCH_SIZE, &p);
+    if (eng->fd < 0) {
+        //io_uring is not supported or not allowed: the blocks are written with 'pwrite()'
+        free(eng);
+        return NULL;
+    }
+    //Map the queues shared with the kernel (with a single mapping, if possible)
+    eng->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    eng->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (eng->cq_map_size > eng->sq_map_size)
+            eng->sq_map_size = eng->cq_map_size;
+        eng->cq_map_size = eng->sq_map_size;
+    }
+    eng->sq_map = mmap(NULL, eng->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, eng->fd, IORING_OFF_SQ_RING);
+    if (eng->sq_map != MAP_FAILED) {
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            eng->cq_map = eng->sq_map;
+        else
+            eng->cq_map = mmap(NULL, eng->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, eng->fd, IORING_OFF_CQ_RING);
+    }
+    if (eng->sq_map != MAP_FAILED && eng->cq_map != MAP_FAILED)
+        eng->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, eng->fd, IORING_OFF_SQES);
+    if (eng->sq_map == MAP_FAILED || eng->cq_map == MAP_FAILED || eng->sqes == MAP_FAILED) {
+        perror("mmap() in new_io_engine()");
+        unmap_rings(eng, p.sq_entries * sizeof(struct io_uring_sqe));
+        free(eng);
+        return NULL;
+    }
+    eng->sq_head = (unsigned int *) ((char *) eng->sq_map + p.sq_off.head);
+    eng->sq_tail = (unsigned int *) ((char *) eng->sq_map + p.sq_off.tail);
+    eng->sq_mask = (unsigned int *) ((char *) eng->sq_map + p.sq_off.ring_mask);
+    eng->sq_array = (unsigned int *) ((char *) eng->sq_map + p.sq_off.array);
+    eng->sq_entries = p.sq_entries;
+    eng->cq_head = (unsigned int *) ((char *) eng->cq_map + p.cq_off.head);
+    eng->cq_tail = (unsigned int *) ((char *) eng->cq_map + p.cq_off.tail);
+    eng->cq_mask = (unsigned int *) ((char *) eng->cq_map + p.cq_off.ring_mask);
+    eng->cqes = (struct io_uring_cqe *) ((char *) eng->cq_map + p.cq_off.cqes);
+    eng->queued = 0;
+    eng->inflight = 0;
+    eng->pool = pool;
+    //Register all the entries of the pool as a single fixed buffer
+    iov.iov_base = pool->packets;
+    iov.iov_len = sizeof(struct packet) * (size_t) pool->dim;
+    eng->fixed = sys_io_uring_register(eng->fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0 ? 1 : 0;
+    
+    return eng;
+}
+
+void io_engine_write(struct io_engine *eng, int fd, struct packet *pkt, off_t offset) {
+    struct io_uring_sqe *sqe;
+    const char *buf = packet_payload(pkt);
+    size_t length = packet_payload_length(pkt);
+    unsigned int tail, index;
+    
+    //The submission queue is full: submit the writes already queued
+    if (eng->queued == eng->sq_entries)
+        io_engine_submit(eng, eng->sq_entries);
+    
+    //Only the submission tail is written by the process: it can be read without atomics
+    tail = *eng->sq_tail;
+    index = tail & *eng->sq_mask;
+    sqe = &eng->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    //A payload into the entries of the pool is written from the fixed buffer
+    if (eng->fixed == 1 && buf >= (const char *) eng->pool->packets &&
+        buf + length <= (const char *) (eng->pool->packets + eng->pool->dim)) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->buf_index = 0;
+    }
+    else
+        sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long) (uintptr_t) buf;
+    sqe->len = (unsigned int) length;
+    sqe->off = (unsigned long long) offset;
+    sqe->user_data = (unsigned long long) (uintptr_t) pkt;
+    eng->sq_array[index] = index;
+    //The entry must be visible to the kernel before the new tail
+    __atomic_store_n(eng->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    eng->queued++;
+}
+
+
+/* Return to the pool the packets of all the writes completed */
+static void reap_completions(struct io_engine *eng) {
+    struct io_uring_cqe *cqe;
+    struct packet *pkt;
+    unsigned int head, tail;
+    
+    head = *eng->cq_head;
+    tail = __atomic_load_n(eng->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        cqe = &eng->cqes[head & *eng->cq_mask];
+        pkt = (struct packet *) (uintptr_t) cqe->user_data;
+        if (cqe->res < 0 || (size_t) cqe->res != packet_payload_length(pkt)) {
+            errno = cqe->res < 0 ? -cqe->res : EIO;
+            perror("write in io_engine_submit()");
+            exit(EXIT_FAILURE);
+        }
+        packet_pool_put(eng->pool, pkt);
+        eng->inflight--;
+        head++;
+    }
+    //The entries can be used again by the kernel
+    __atomic_store_n(eng->cq_head, head, __ATOMIC_RELEASE);
+}
+
+void io_engine_submit(struct io_engine *eng, unsigned int max_inflight) {
+    unsigned int wait;
+    int ret;
+    
+    if (eng == NULL)
+        return;
+    reap_completions(eng);
+    while (eng->queued > 0 || eng->inflight > max_inflight) {
+        //Submit all the writes queued and wait for as many as needed, with one call
+        wait = eng->inflight + eng->queued > max_inflight ? eng->inflight + eng->queued - max_inflight : 0;
+        ret = sys_io_uring_enter(eng->fd, eng->queued, wait, wait > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0) {
+            //Interrupted, or completion queue full: get the completions and retry
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                perror("io_uring_enter() in io_engine_submit()");
+                exit(EXIT_FAILURE);
+            }
+            ret = 0;
+        }
+        eng->queued -= (unsigned int) ret;
+        eng->inflight += (unsigned int) ret;
+        reap_completions(eng);
+    }
+}
+
+void io_engine_delete(struct io_engine *eng) {
+    if (eng == NULL)
+        return;
+    //Wait until all the blocks are written
+    io_engine_submit(eng, 0);
+    unmap_rings(eng, eng->sq_entries * sizeof(struct io_uring_sqe));
+    free(eng);
+}
+
+#else
+
+/* Without io_uring, the blocks are always written with 'pwrite()' */
+struct io_engine *new_io_engine(struct packet_pool *pool) {
+    (void) pool;
+    return NULL;
+}
+
+void io_engine_write(struct io_engine *eng, int fd, struct packet *pkt, off_t offset) {
+    (void) eng; (void) fd; (void) pkt; (void) offset;
+    fprintf(stderr, "Error in io_engine_write(): io_uring not available\n");
+    exit(EXIT_FAILURE);
+}
+
+void io_engine_submit(struct io_engine *eng, unsigned int max_inflight) {
+    (void) eng; (void) max_inflight;
+}
+
+void io_engine_delete(struct io_engine *eng) {
+    (void) eng;
+}
+
+#endif
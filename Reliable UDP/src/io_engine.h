@@ -0,0 +1,141 @@
+//
+//  io_engine.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'io_engine' data structure, used by the
+//  receiving process to write the blocks of the file with an io_uring (see
+//  IO_URING in 'settings.h'). Instead of a 'pwrite()' for each packet added in
+//  the sliding window (see 'window_controller_add_packet()'), the writes of a
+//  batch of packets are only queued, and they are submitted all together with a
+//  single 'io_uring_enter()' before the next batch is received. The kernel
+//  writes them asynchronously, while the process goes on receiving, and each
+//  packet goes back to its 'packet_pool' only when its write is completed.
+//  The entries of the pool are registered in the kernel once, as fixed buffers,
+//  so the pages of the payloads are not mapped again for each write.
+//  The ring is used directly through the system calls and the shared memory
+//  described in 'linux/io_uring.h', so no library is needed. If IO_URING is 0,
+//  or if the kernel does not allow io_uring (for example because of a seccomp
+//  filter), 'new_io_engine()' returns NULL and the blocks are written with
+//  'pwrite()' as before.
+
+
+#ifndef __Reliable_UDP__io_engine__
+#define __Reliable_UDP__io_engine__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "settings.h"
+#include "packet.h"
+#include "packet_pool.h"
+
+struct io_engine {
+    int fd;                             //File descriptor of the io_uring
+    void *sq_map;                       //Submission queue mapped in memory
+    void *cq_map;                       //Completion queue mapped in memory (can be 'sq_map')
+    size_t sq_map_size;                 //Size of the mapping of the submission queue
+    size_t cq_map_size;                 //Size of the mapping of the completion queue
+    unsigned int *sq_head;              //Head of the submission queue (written by the kernel)
+    unsigned int *sq_tail;              //Tail of the submission queue (written by the process)
+    unsigned int *sq_mask;              //Mask of the indexes of the submission queue
+    unsigned int *sq_array;             //Indexes of the entries submitted
+    struct io_uring_sqe *sqes;          //Entries of the submission queue
+    unsigned int sq_entries;            //Number of entries of the submission queue
+    unsigned int *cq_head;              //Head of the completion queue (written by the process)
+    unsigned int *cq_tail;              //Tail of the completion queue (written by the kernel)
+    unsigned int *cq_mask;              //Mask of the indexes of the completion queue
+    struct io_uring_cqe *cqes;          //Entries of the completion queue
+    unsigned int queued;                //Writes queued and not yet submitted
+    unsigned int inflight;              //Writes submitted and not yet completed
+    struct packet_pool *pool;           //Pool where the packets written are returned
+    int fixed;                          //1 if the entries of 'pool' are registered as fixed buffers
+};
+
+
+/*  This function creates a new 'io_engine' with an io_uring large enough for
+ *  two batches of packets (see IO_BATCH_SIZE in 'settings.h'), and registers
+ *  the entries of 'pool' as fixed buffers. If they can not be registered (for
+ *  example because of RLIMIT_MEMLOCK), the writes use normal buffers.
+ *
+ *  Parameters:
+ *  - pool:     Pool of the packets that are written. It must contain at least
+ *              two batches of packets: one being received, and one being written
+ *
+ *  Return:     Pointer to a new initialized 'io_engine', or NULL if IO_URING is
+ *              0 or the kernel does not allow io_uring: in this case the caller
+ *              writes the blocks with 'pwrite()'
+ */
+struct io_engine *new_io_engine(struct packet_pool *pool);
+
+
+/*  This function queues the write of the payload of a packet at an offset of a
+ *  file. The write is not submitted until 'io_engine_submit()' is called (or
+ *  until the submission queue is full). From now on, the 'io_engine' owns the
+ *  packet: it is returned to the pool when the write is completed.
+ *
+ *  Parameters:
+ *  - eng:      The 'io_engine'
+ *  - fd:       File descriptor of the file opened to write
+ *  - pkt:      The packet to write (it must belong to the pool of 'eng')
+ *  - offset:   Offset of the block into the file
+ *
+ *  Return:     Nothing
+ */
+void io_engine_write(struct io_engine *eng, int fd, struct packet *pkt, off_t offset);
+
+
+/*  This function submits all the writes queued with a single 'io_uring_enter()',
+ *  returns to the pool the packets of the writes completed, and waits until at
+ *  most 'max_inflight' writes are still in progress. No system call is made if
+ *  nothing is queued and the writes in progress are already few enough.
+ *  If a write fails, the process exits, as it does when 'pwrite()' fails.
+ *
+ *  Parameters:
+ *  - eng:              The 'io_engine'
+ *  - max_inflight:     Maximum number of writes in progress when the function
+ *                      returns (0 to wait until all the blocks are written)
+ *
+ *  Return:             Nothing
+ */
+void io_engine_submit(struct io_engine *eng, unsigned int max_inflight);
+
+
+/*  This function waits until all the writes are completed, and deletes the
+ *  'io_engine'. It accepts a NULL 'io_engine'.
+ *
+ *  Parameters:
+ *  - eng:      The 'io_engine' to delete
+ *
+ *  Return:     Nothing
+ */
+void io_engine_delete(struct io_engine *eng);
+
+
+#endif /* defined(__Reliable_UDP__io_engine__) */
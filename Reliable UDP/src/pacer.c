@@ -0,0 +1,118 @@
+//
+//  pacer.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "pacer.h"
+
+
+static void get_time(struct timespec *t) {
+    if (clock_gettime(CLOCK_MONOTONIC, t) != 0) {
+        perror("clock_gettime() in pacer");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*  Add the tokens earned since the last update */
+static void refill(struct pacer *p) {
+    struct timespec now;
+    double elapsed;
+    
+    get_time(&now);
+    if (p->rate <= 0)
+        p->tokens = p->burst;
+    else {
+        elapsed = (now.tv_sec - p->last.tv_sec) + (now.tv_nsec - p->last.tv_nsec) / 1e9;
+        p->tokens += elapsed * p->rate;
+        if (p->tokens > p->burst)
+            p->tokens = p->burst;
+    }
+    p->last = now;
+}
+
+
+struct pacer *new_pacer(int burst) {
+    struct pacer *p;
+    
+    p = malloc(sizeof(struct pacer));
+    if (p == NULL) {
+        fprintf(stderr, "Error in new_pacer(): cannot allocate memory for pacer\n");
+        exit(EXIT_FAILURE);
+    }
+    p->rate = 0;
+    p->burst = burst < 1 ? 1 : burst;
+    p->tokens = p->burst;
+    get_time(&p->last);
+    
+    return p;
+}
+
+void pacer_set_rate(struct pacer *p, double rate) {
+    refill(p);                          //The tokens earned until now use the old rate
+    p->rate = rate < 0 ? 0 : rate;
+}
+
+void pacer_wait(struct pacer *p) {
+    struct timespec deadline;
+    double wait;
+    
+    refill(p);
+    while (p->tokens < 1) {
+        //Sleep until the next token, with an absolute deadline
+        wait = (1 - p->tokens) / p->rate;
+        deadline = p->last;
+        deadline.tv_sec += (time_t) wait;
+        deadline.tv_nsec += (long) ((wait - (time_t) wait) * 1e9);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        errno = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        if (errno != 0 && errno != EINTR) {
+            perror("clock_nanosleep() in pacer_wait()");
+            exit(EXIT_FAILURE);
+        }
+        refill(p);
+    }
+}
+
+int pacer_available(struct pacer *p) {
+    refill(p);
+    return (int) p->tokens;
+}
+
+long long int pacer_delay(struct pacer *p) {
+    refill(p);
+    if (p->tokens >= 1)
+        return 0;
+    //Round up, so the token is available when the time is over
+    return (long long int) ((1 - p->tokens) / p->rate * 1e6) + 1;
+}
+
+void pacer_consume(struct pacer *p, int n) {
+    p->tokens -= n;
+}
+
+void pacer_delete(struct pacer *p) {
+    free(p);
+}
@@ -0,0 +1,127 @@
+//
+//  pacer.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'pacer' data structure, used by the sending
+//  process to spread the packets over time instead of sending a whole window
+//  at once each time the ACKs free some slots. It is a token bucket: the tokens
+//  are added at the pacing 'rate' (packets per second), each packet sent uses a
+//  token, and at most 'burst' tokens can be saved while the sender is idle.
+//  The rate is calculated by 'window_controller' from the congestion window and
+//  the RTT, so that a window is spread over a RTT (see 'window_controller.c'),
+//  and it can be limited by PACING_MAX_RATE in 'settings.h'.
+//  The process waits for a token with 'clock_nanosleep()' on CLOCK_MONOTONIC,
+//  until an absolute deadline, so the sleeps do not accumulate errors.
+//  The 'pacer' is used only by the thread that sends new packets, so it has no mutex.
+
+
+#ifndef __Reliable_UDP__pacer__
+#define __Reliable_UDP__pacer__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+#include "settings.h"
+
+
+struct pacer {
+    double rate;                //Tokens (packets) added each second, 0 if there is no limit
+    double tokens;              //Tokens available
+    double burst;               //Maximum number of tokens
+    struct timespec last;       //Last time the tokens were updated (CLOCK_MONOTONIC)
+};
+
+
+/*  This function creates a new 'pacer', without limits of rate.
+ *
+ *  Parameters:
+ *  - burst:        Maximum number of packets that can be sent together
+ *
+ *  Return:         Pointer to a new initialized 'pacer'
+ */
+struct pacer *new_pacer(int burst);
+
+
+/*  This function changes the pacing rate. The tokens earned with the previous
+ *  rate are saved.
+ *
+ *  Parameters:
+ *  - p:            Pointer to the 'pacer'
+ *  - rate:         The new rate, in packets per second (0 to remove the limit)
+ *
+ *  Return:         Nothing
+ */
+void pacer_set_rate(struct pacer *p, double rate);
+
+
+/*  This function suspends the process until at least one token is available.
+ *
+ *  Parameters:
+ *  - p:            Pointer to the 'pacer'
+ *
+ *  Return:         Nothing
+ */
+void pacer_wait(struct pacer *p);
+
+
+/*  This function returns the number of packets that can be sent now.
+ *
+ *  Parameters:
+ *  - p:            Pointer to the 'pacer'
+ *
+ *  Return:         The number of tokens available (between 0 and 'burst')
+ */
+int pacer_available(struct pacer *p);
+
+
+/*  This function returns the time until the next token.
+ *
+ *  Parameters:
+ *  - p:            Pointer to the 'pacer'
+ *
+ *  Return:         The time in usecs, 0 if a token is available
+ */
+long long int pacer_delay(struct pacer *p);
+
+
+/*  This function uses the tokens of the packets just sent.
+ *
+ *  Parameters:
+ *  - p:            Pointer to the 'pacer'
+ *  - n:            Number of packets sent
+ *
+ *  Return:         Nothing
+ */
+void pacer_consume(struct pacer *p, int n);
+
+
+/*  This function frees all memory occupied by a 'pacer' */
+void pacer_delete(struct pacer *p);
+
+
+#endif /* defined(__Reliable_UDP__pacer__) */
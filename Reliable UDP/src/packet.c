@@ -31,22 +31,216 @@ struct packet *new_packet(int type, long long int seq, char *data, size_t dimens
         fprintf(stderr, "Error in new_packet(): cannot allocate memory for packet\n");
         exit(EXIT_FAILURE);
     }
-    //If 'data' is NULL, fill the 'data' field with '\0'
-    if (data != NULL)
-        memcpy(new->data, data, MAX_BLOCK_SIZE);
-    else
-        memcpy(new->data, "\0", MAX_BLOCK_SIZE);
-    //Initialize all the parameters
-    new->acked = 0;
-    new->seq = seq;
-    new->type = type;
-    new->dimension = dimension;
+    packet_init(new, type, seq, data, dimension);
     new->td = new_time_data(seq);
-    new->retries = 0;
     
     return new;
 }
 
+void packet_init(struct packet *pkt, int type, long long int seq, char *data, size_t dimension) {
+    //If 'data' is NULL, fill the 'data' field with '\0'. The caller fills a
+    //PKT_DATA, so its 'data' field is not cleared for nothing
+    if (type != PKT_DATA || data != NULL)
+        memset(pkt->data, 0, MAX_BLOCK_SIZE);
+    pkt->payload = NULL;
+    if (data != NULL) {
+        //A PKT_DATA carries 'dimension' bytes, all the others carry a string
+        if (type == PKT_DATA)
+            memcpy(pkt->data, data, dimension < MAX_BLOCK_SIZE ? dimension : MAX_BLOCK_SIZE);
+        else
+            strncpy(pkt->data, data, MAX_BLOCK_SIZE - 1);
+    }
+    //Initialize all the parameters
+    pkt->acked = 0;
+    pkt->seq = seq;
+    pkt->type = type;
+    pkt->flags = 0;
+    pkt->dimension = dimension;
+    pkt->retries = 0;
+    pkt->retransmitted = 0;
+    pkt->conn = 0;
+}
+
+void packet_copy(struct packet *dst, struct packet *src) {
+    size_t length = packet_payload_length(src);
+    
+    dst->type = src->type;
+    dst->flags = src->flags;
+    dst->seq = src->seq;
+    dst->acked = src->acked;
+    dst->dimension = src->dimension;
+    dst->retries = src->retries;
+    dst->retransmitted = src->retransmitted;
+    dst->conn = src->conn;
+    dst->payload = NULL;
+    memcpy(dst->data, packet_payload(src), length);
+    if (length < MAX_BLOCK_SIZE)
+        dst->data[length] = '\0';
+}
+
 void packet_delete(struct packet *pkt) {
     free(pkt);
 }
+
+
+/*  These functions write and read an unsigned integer of 'n' bytes in network
+ *  byte order (big endian), independently from the endianness of the machine.
+ */
+static void put_uint(unsigned char *buf, unsigned long long int value, int n) {
+    int i;
+    for (i = n - 1; i >= 0; --i) {
+        buf[i] = (unsigned char) (value & 0xFF);
+        value >>= 8;
+    }
+}
+
+static unsigned long long int get_uint(const unsigned char *buf, int n) {
+    unsigned long long int value = 0;
+    int i;
+    for (i = 0; i < n; ++i)
+        value = (value << 8) | buf[i];
+    return value;
+}
+
+void packet_set_sack(struct packet *ack, long long int cumulative) {
+    ack->flags |= PKT_FLAG_SACK;
+    put_uint((unsigned char *) ack->data, (unsigned long long int) cumulative, 8);
+    memset(ack->data + 8, 0, SACK_BITMAP_SIZE);     //Empty bitmap
+}
+
+void packet_sack_mark(struct packet *ack, long long int seq) {
+    long long int bit = seq - packet_get_cumulative(ack) - 2;
+    
+    if (bit < 0 || bit >= SACK_BITMAP_SIZE * 8)
+        return;                                     //Not covered by the bitmap
+    ack->data[8 + bit / 8] |= (char) (1 << (bit % 8));
+}
+
+void packet_set_nack(struct packet *nack) {
+    nack->type = PKT_NACK;
+    nack->flags = 0;
+    nack->dimension = 0;                            //No ranges
+}
+
+int packet_nack_add(struct packet *nack, long long int first, long long int last) {
+    unsigned char *range = (unsigned char *) nack->data + nack->dimension * NACK_RANGE_SIZE;
+    
+    if (nack->dimension >= NACK_MAX_RANGES)
+        return 1;
+    put_uint(range, (unsigned long long int) first, 8);
+    put_uint(range + 8, (unsigned long long int) last, 8);
+    nack->dimension++;
+    return 0;
+}
+
+void packet_get_nack_range(struct packet *nack, int i, long long int *first, long long int *last) {
+    unsigned char *range = (unsigned char *) nack->data + i * NACK_RANGE_SIZE;
+    
+    *first = (long long int) get_uint(range, 8);
+    *last = (long long int) get_uint(range + 8, 8);
+}
+
+void packet_set_file_info(struct packet *req, unsigned long long int size, long long int identity) {
+    size_t length = strnlen(req->data, MAX_BLOCK_SIZE);
+    
+    if (length >= MAX_BLOCK_SIZE ||
+        snprintf(req->data + length, MAX_BLOCK_SIZE - length, "\n%llu %lld", size, identity) >= (int) (MAX_BLOCK_SIZE - length)) {
+        fprintf(stderr, "Error in packet_set_file_info(): the name of the file is too long\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int packet_get_file_info(struct packet *req, unsigned long long int *size, long long int *identity) {
+    size_t length = strnlen(req->data, MAX_BLOCK_SIZE);
+    char *info = memchr(req->data, '\n', length);
+    char *end;
+    
+    *size = 0;
+    *identity = 0;
+    //The text is terminated by 'packet_deserialize()' only if it is shorter
+    if (info == NULL || length == MAX_BLOCK_SIZE)
+        return -1;
+    *info++ = '\0';                 //Only the name of the file remains
+    *size = strtoull(info, &end, 10);
+    *identity = strtoll(end, NULL, 10);
+    return 0;
+}
+
+long long int packet_get_cumulative(struct packet *ack) {
+    return (long long int) get_uint((unsigned char *) ack->data, 8);
+}
+
+unsigned char *packet_get_sack(struct packet *ack) {
+    return (unsigned char *) ack->data + 8;
+}
+
+size_t packet_payload_length(struct packet *pkt) {
+    if (pkt->type == PKT_DATA)
+        return pkt->dimension < MAX_BLOCK_SIZE ? pkt->dimension : MAX_BLOCK_SIZE;
+    if (pkt->type == PKT_NACK)
+        return (pkt->dimension < NACK_MAX_RANGES ? pkt->dimension : NACK_MAX_RANGES) * NACK_RANGE_SIZE;
+    if (pkt->flags & PKT_FLAG_SACK)
+        return 8 + SACK_BITMAP_SIZE;
+    //Text payload: the string without the terminator
+    return strnlen(pkt->data, MAX_BLOCK_SIZE);
+}
+
+const char *packet_payload(struct packet *pkt) {
+    return pkt->payload != NULL ? pkt->payload : pkt->data;
+}
+
+size_t packet_serialize_header(struct packet *pkt, unsigned char *buf) {
+    size_t length = packet_payload_length(pkt);
+    
+    buf[0] = PROTOCOL_VERSION;                                      //version
+    buf[1] = (unsigned char) pkt->type;                             //type
+    put_uint(buf + 2, pkt->flags, 2);                               //flags
+    put_uint(buf + 4, length, 4);                                   //payload length
+    put_uint(buf + 8, (unsigned long long int) pkt->seq, 8);        //sequence number
+    put_uint(buf + 16, (unsigned long long int) pkt->dimension, 8); //dimension
+    put_uint(buf + 24, pkt->conn, 4);                               //connection ID
+    
+    return length;
+}
+
+size_t packet_serialize(struct packet *pkt, unsigned char *buf) {
+    size_t length = packet_serialize_header(pkt, buf);
+    
+    //Payload: only the bytes really used
+    memcpy(buf + PKT_HEADER_SIZE, packet_payload(pkt), length);
+    
+    return PKT_HEADER_SIZE + length;
+}
+
+int packet_deserialize(struct packet *pkt, const unsigned char *buf, size_t n) {
+    size_t length;
+    //The datagram must contain at least a valid header
+    if (n < PKT_HEADER_SIZE || buf[0] != PROTOCOL_VERSION)
+        return -1;
+    
+    length = (size_t) get_uint(buf + 4, 4);
+    if (length > MAX_BLOCK_SIZE || PKT_HEADER_SIZE + length > n)
+        return -1;
+    
+    pkt->type = buf[1];
+    pkt->flags = (unsigned int) get_uint(buf + 2, 2);
+    pkt->seq = (long long int) get_uint(buf + 8, 8);
+    pkt->dimension = (size_t) get_uint(buf + 16, 8);
+    pkt->conn = (unsigned int) get_uint(buf + 24, 4);
+    //The ranges of a PKT_NACK, and the cumulative ACK and the bitmap of a
+    //PKT_ACK with PKT_FLAG_SACK, must be all in the payload
+    if ((pkt->type == PKT_NACK || (pkt->type == PKT_ACK && (pkt->flags & PKT_FLAG_SACK))) &&
+        length != packet_payload_length(pkt))
+        return -1;
+    memcpy(pkt->data, buf + PKT_HEADER_SIZE, length);
+    if (length < MAX_BLOCK_SIZE)
+        pkt->data[length] = '\0';
+    //These fields are local to the process and are never sent
+    pkt->payload = NULL;
+    pkt->td = NULL;
+    pkt->acked = 0;
+    pkt->retries = 0;
+    pkt->retransmitted = 0;
+    
+    return 0;
+}
@@ -32,16 +32,25 @@
 //  information (such as the type and sequence number), but only the process that
 //  sends data (through the PUT operation) connects each packets to a structure
 //  'time_data', that contains information to the timing of sending, receiving
-//  and timeout. In fact, when a data packet is sent via 'sendto()', the parameter
-//  'time_data *td' is not unreferenced. In this way, to the receiving process,
-//  it is sent only a pointer to a memory area that is not in any way connected
-//  to the sending process. The sending process uses the parameter 'td' to calculate
-//  and control the timeout for each packet, while the receiving process does not
-//  use in any way the fields 'td' of received packets, because it has a detection
-//  mechanism of inactivity. The maximum inactivity time (MAX_INACTIVITY_TIME)
-//  is configurable in 'settings.h'. Moreover, you can also change the maximum
-//  number of bytes that can be sent with each packet, changing the value of
-//  MAX_BLOCK_SIZE in 'settings.h'.
+//  and timeout. The 'td' pointer is never sent over the network, so for the
+//  receiving process it is always NULL. The sending process uses the parameter
+//  'td' to calculate and control the timeout for each packet, while the receiving
+//  process does not need it, because it has a detection mechanism of
+//  inactivity. The maximum inactivity time (MAX_INACTIVITY_TIME) is configurable
+//  in 'settings.h'. Moreover, you can also change the maximum number of bytes
+//  that can be sent with each packet, changing the value of MAX_BLOCK_SIZE in
+//  'settings.h'.
+//  The 'packet' structure is never sent over the network as it is: 'send_pkt()'
+//  and 'recv_pkt()' (see 'utils.h') use 'packet_serialize()' and
+//  'packet_deserialize()' to convert it in a compact header of PKT_HEADER_SIZE
+//  bytes, written in network byte order, followed only by the bytes of the
+//  payload really used. So, an ACK is only PKT_HEADER_SIZE bytes long, and the
+//  last block of a file carries only its real dimension.
+//  The payload of a PKT_DATA does not need to be in the 'data' field: if
+//  'payload' is not NULL, it points to the bytes to send, for example to the
+//  pages of the file mapped in memory (see 'file_source.h'). The header and the
+//  payload are passed to the kernel as two separate buffers, so the bytes of a
+//  file are never copied by the sending process, not even for retransmissions.
 
 
 #ifndef __Reliable_UDP__packet__
@@ -80,24 +89,143 @@
  *                      the connection between client and server
  *  PKT_ERR:            It is used to send an error message between client and
  *                      server and to stop the connection
- *  PKT_REQ:            In the 'recovery_mode', it is used to request the forced
- *                      sending of a packet with a given sequence number
+ *  PKT_NACK:           It is used by the receiving process to request again the
+ *                      ranges of packets missing before the highest packet
+ *                      received (see 'packet_set_nack()' below)
  *
  *  In a future release, PKT_HELP and PKT_LANG could be used not only locally ,
  *  but respectively to request the help page for the server configuration and 
  *  the language setting for the server.
  */
-enum packet_type {PKT_LS, PKT_GET, PKT_PUT, PKT_HELP, PKT_LANG, PKT_INFO, PKT_ACK, PKT_DATA, PKT_FIN, PKT_FINACK, PKT_ERR, PKT_REQ};
+enum packet_type {PKT_LS, PKT_GET, PKT_PUT, PKT_HELP, PKT_LANG, PKT_INFO, PKT_ACK, PKT_DATA, PKT_FIN, PKT_FINACK, PKT_ERR, PKT_NACK};
+
+
+/*  Version of the on-wire format. A datagram with a different version is
+ *  discarded by 'packet_deserialize()'.
+ */
+#define PROTOCOL_VERSION    3
+
+
+/*  The header that precedes the payload of each datagram. All the fields are
+ *  written in network byte order (big endian), byte by byte, so the format does
+ *  not depend on the padding or on the endianness of the machine.
+ *
+ *   0       1       2               4                               8
+ *  ---------------------------------------------------------------
+ *  |version| type  |     flags     |        payload length         |
+ *  ---------------------------------------------------------------
+ *  |                        sequence number                        |
+ *  ---------------------------------------------------------------
+ *  |                           dimension                           |
+ *  ---------------------------------------------------------------
+ *  |         connection ID         |
+ *  ---------------------------------
+ *  28
+ *
+ *  'dimension' is sent separately from the payload length because, during the
+ *  connection phase, it is used to carry the number of packets or the port
+ *  number (see 'sendCMD()' in 'client.c').
+ *  The connection ID identifies the transfer of a packet. It is 0 in the requests
+ *  and in all the packets of a transfer on its own port. The event-driven server
+ *  (see 'event_server.h') runs all the transfers on SERV_PORT: it chooses a
+ *  connection ID for each request, sends it in the response, and from then on
+ *  both sides put it in every packet, so the server finds the transfer of each
+ *  datagram and both sides discard the datagrams of other transfers.
+ */
+#define PKT_HEADER_SIZE     28
+
+
+/*  Maximum size of a datagram on the wire: header plus a full data block */
+#define PKT_MAX_WIRE_SIZE   (PKT_HEADER_SIZE + MAX_BLOCK_SIZE)
+
+
+/*  Flags of the header.
+ *
+ *  PKT_FLAG_SACK:      The packet (a PKT_ACK) carries a cumulative ACK and a
+ *                      selective ACK (SACK) bitmap in the 'data' field:
+ *
+ *                      0                               8
+ *                      ---------------------------------------------
+ *                      |        cumulative ACK         |  bitmap   |
+ *                      ---------------------------------------------
+ *                                                      SACK_BITMAP_SIZE bytes
+ *
+ *                      All the packets with sequence number <= cumulative ACK
+ *                      were received. The bit 'i' of the bitmap (bit i % 8 of
+ *                      the byte i / 8) is set if the packet with sequence number
+ *                      'cumulative ACK + 2 + i' was received. The packet
+ *                      'cumulative ACK + 1' is the first one missing, so it is
+ *                      not in the bitmap. The 'seq' field contains the sequence
+ *                      number of the packet that generated the ACK, used by the
+ *                      sender to calculate the RTT.
+ *
+ *  PKT_FLAG_RESUME:    The response to a GET or a PUT (a PKT_ACK) resumes a
+ *                      transfer that died: only the packets from a first
+ *                      sequence number onwards are transferred, and the text in
+ *                      the 'data' field carries that sequence number after the
+ *                      number of packets, the size and the identity of the file
+ *                      (see 'checkpoint.h').
+ */
+enum packet_flags {PKT_FLAG_SACK = 1, PKT_FLAG_RESUME = 2};
+
+
+/*  In a request (PKT_LS, PKT_GET, PKT_PUT), the bits of PKT_CC_MASK in the flags
+ *  carry the congestion control algorithm chosen by the client (a value from
+ *  'cc_algorithm', see 'congestion_control.h'), used by the server to send a file.
+ */
+#define PKT_CC_SHIFT        8
+#define PKT_CC_MASK         (0x0F << PKT_CC_SHIFT)
+
+
+/*  In a request for a GET or a PUT, the bits of PKT_STREAMS_MASK in the flags
+ *  carry the number of streams asked by the client (see TRANSFER_STREAMS in
+ *  'settings.h'); in the PKT_ACK of the response, the number of streams granted
+ *  by the server. 0 means a single stream. With more than one stream, the text
+ *  in the 'data' field of the response is followed by the ports of the streams
+ *  after the first one, separated by spaces (the first one is in 'dimension').
+ *  The streams split only the packets that are transferred: with
+ *  PKT_FLAG_RESUME, the packets from the first sequence number onwards.
+ */
+#define PKT_STREAMS_SHIFT   12
+#define PKT_STREAMS_MASK    (0x0F << PKT_STREAMS_SHIFT)
+#define PKT_MAX_STREAMS     (PKT_STREAMS_MASK >> PKT_STREAMS_SHIFT)
+
+
+/*  A PKT_NACK carries in the 'data' field a list of ranges of sequence numbers,
+ *  and the number of ranges in the 'dimension' field:
+ *
+ *  0                               8                              16
+ *  -----------------------------------------------------------------
+ *  |        first missing          |         last missing          |  ...
+ *  -----------------------------------------------------------------
+ *
+ *  All the packets from 'first' to 'last' (included) of each range are missing.
+ *  At most NACK_MAX_RANGES ranges fit in a packet.
+ */
+#define NACK_RANGE_SIZE     16
+#define NACK_MAX_RANGES     (MAX_BLOCK_SIZE / NACK_RANGE_SIZE)
+
+
+/*  Size in bytes of the SACK bitmap: it covers the whole sliding window */
+#define SACK_BITMAP_SIZE    ((WINDOW_DIMENSION + 7) / 8)
+
+#if SACK_BITMAP_SIZE + 8 > MAX_BLOCK_SIZE
+#error "WINDOW_DIMENSION too large: the SACK bitmap does not fit in MAX_BLOCK_SIZE"
+#endif
 
 
 struct packet {
     struct time_data *td;       //Pointer to a 'time_data' structure
     int type;                   //Indicates the type of the packet
+    unsigned int flags;         //Flags sent in the header (see 'packet_flags')
     long long int seq;          //Sequence number (It is unique for each packet)
     int acked;                  //Indicates if a packets was acked (1) or not (0)
     char data[MAX_BLOCK_SIZE];  //Data read from the file
+    const char *payload;        //If not NULL, the payload is here (e.g. in a file mapped in memory) in place of 'data'
     size_t dimension;           //Real size of the 'data' field
-    int retries;                //How many times it was sent back a package
+    int retries;                //How many times its timer expired and it was sent back
+    int retransmitted;          //Indicates if the packet was sent again (1) or not (0), for any reason
+    unsigned int conn;          //Connection ID of the transfer (0 if not used)
 };
 
 
@@ -108,7 +236,9 @@ struct packet {
  *  - type:             The type (from 'packet_type' enumeration) of the packet
  *  - seq:              The sequence number of the packet
  *  - data:             bytes to be sent with the packet; if NULL, the field is
- *                      filled by '\0'
+ *                      filled by '\0', except for a PKT_DATA, that is filled
+ *                      by the caller (or refers to the bytes of a file with
+ *                      'payload')
  *  - dimensio:         The real dimension of the data field
  *
  *  Return:             Pointer to a new packet
@@ -116,6 +246,26 @@ struct packet {
 struct packet *new_packet(int type, long long int seq, char *data, size_t dimension);
 
 
+/*  This function initializes all the fields of a packet already allocated,
+ *  except 'td' (see 'new_packet()' above for the parameters). It is used also
+ *  for the packets taken from a 'packet_pool' (see 'packet_pool.h').
+ */
+void packet_init(struct packet *pkt, int type, long long int seq, char *data, size_t dimension);
+
+
+/*  This function copies a packet received into another one, for example into
+ *  an entry of a different 'packet_pool'. The 'td' of 'dst' is not modified,
+ *  and only the bytes of the payload really used are copied.
+ *
+ *  Parameters:
+ *  - dst:              The packet to fill
+ *  - src:              The packet to copy
+ *
+ *  Return:             Nothing
+ */
+void packet_copy(struct packet *dst, struct packet *src);
+
+
 /*  This function physically deletes a packet
  *
  *  Parameters:
@@ -126,4 +276,166 @@ struct packet *new_packet(int type, long long int seq, char *data, size_t dimens
 void packet_delete(struct packet *pkt);
 
 
+/*  This function transforms a packet into a cumulative and selective ACK
+ *  (see PKT_FLAG_SACK above), with an empty bitmap.
+ *
+ *  Parameters:
+ *  - ack:              The packet
+ *  - cumulative:       The sequence number of the last packet received in order
+ *
+ *  Return:             Nothing
+ */
+void packet_set_sack(struct packet *ack, long long int cumulative);
+
+
+/*  This function sets in the SACK bitmap of 'ack' the bit of a packet received
+ *  out of order. If 'seq' is not covered by the bitmap, nothing is done.
+ *
+ *  Parameters:
+ *  - ack:              The packet, already initialized with 'packet_set_sack()'
+ *  - seq:              Sequence number of the packet received
+ *
+ *  Return:             Nothing
+ */
+void packet_sack_mark(struct packet *ack, long long int seq);
+
+
+/*  This function transforms a packet into a PKT_NACK without ranges.
+ *
+ *  Parameters:
+ *  - nack:             The packet
+ *
+ *  Return:             Nothing
+ */
+void packet_set_nack(struct packet *nack);
+
+
+/*  This function adds a range of missing packets to a PKT_NACK.
+ *
+ *  Parameters:
+ *  - nack:             The packet, already initialized with 'packet_set_nack()'
+ *  - first:            Sequence number of the first packet missing
+ *  - last:             Sequence number of the last packet missing
+ *
+ *  Return:             0 on success, 1 if the packet already contains
+ *                      NACK_MAX_RANGES ranges (the range is not added)
+ */
+int packet_nack_add(struct packet *nack, long long int first, long long int last);
+
+
+/*  This function reads the range 'i' of a PKT_NACK, with 0 <= i < 'dimension'.
+ *
+ *  Parameters:
+ *  - nack:             The packet
+ *  - i:                Index of the range
+ *  - first:            Filled with the sequence number of the first packet missing
+ *  - last:             Filled with the sequence number of the last packet missing
+ *
+ *  Return:             Nothing
+ */
+void packet_get_nack_range(struct packet *nack, int i, long long int *first, long long int *last);
+
+
+/*  This function adds to a request for a GET or a PUT the size and the identity
+ *  of the file (see 'get_modification_time()' in 'utils.h'), so the receiver
+ *  can check that its partial copy is of the same file (see 'checkpoint.h').
+ *  They are written in the 'data' field as text, after the name of the file
+ *  and a new line: "<name>\n<size> <identity>".
+ *
+ *  Parameters:
+ *  - req:              The request, with the name of the file in 'data'
+ *  - size:             Size of the file in bytes
+ *  - identity:         Identity of the file
+ *
+ *  Return:             Nothing
+ */
+void packet_set_file_info(struct packet *req, unsigned long long int size, long long int identity);
+
+
+/*  This function reads the size and the identity of the file from a request
+ *  for a GET or a PUT (see 'packet_set_file_info()'), and removes them from the
+ *  'data' field, where only the name of the file remains.
+ *
+ *  Parameters:
+ *  - req:              The request
+ *  - size:             Filled with the size of the file (0 if not present)
+ *  - identity:         Filled with the identity of the file (0 if not present)
+ *
+ *  Return:             0 on success, -1 if the request does not carry them
+ */
+int packet_get_file_info(struct packet *req, unsigned long long int *size, long long int *identity);
+
+
+/*  This function returns the cumulative ACK of a packet with PKT_FLAG_SACK */
+long long int packet_get_cumulative(struct packet *ack);
+
+
+/*  This function returns the SACK bitmap of a packet with PKT_FLAG_SACK */
+unsigned char *packet_get_sack(struct packet *ack);
+
+
+/*  This function returns the number of bytes of the 'data' field that are
+ *  really sent over the network. For PKT_DATA packets it is the 'dimension'
+ *  of the packet, for a PKT_NACK it is the size of its ranges, for a SACK it
+ *  is the size of cumulative ACK and bitmap, for
+ *  all the other packets 'data' contains a string (a file name, an error
+ *  message, a number) or nothing, so its length is used.
+ *
+ *  Parameters:
+ *  - pkt:              The packet
+ *
+ *  Return:             Number of bytes of the payload (at most MAX_BLOCK_SIZE)
+ */
+size_t packet_payload_length(struct packet *pkt);
+
+
+/*  This function returns the bytes of the payload of a packet: 'payload' if it
+ *  is not NULL, the 'data' field otherwise.
+ */
+const char *packet_payload(struct packet *pkt);
+
+
+/*  This function writes only the header of a packet in a buffer, in the format
+ *  described above. The buffer must be at least PKT_HEADER_SIZE bytes. It is used
+ *  to send the header and the payload (see 'packet_payload()') without copying
+ *  them into a single buffer.
+ *
+ *  Parameters:
+ *  - pkt:              The packet
+ *  - buf:              The buffer
+ *
+ *  Return:             Number of bytes of the payload (see 'packet_payload_length()')
+ */
+size_t packet_serialize_header(struct packet *pkt, unsigned char *buf);
+
+
+/*  This function writes a packet in a buffer, in the format described above
+ *  (header + payload). The buffer must be at least PKT_MAX_WIRE_SIZE bytes.
+ *
+ *  Parameters:
+ *  - pkt:              The packet to write
+ *  - buf:              The buffer
+ *
+ *  Return:             Number of bytes written into 'buf'
+ */
+size_t packet_serialize(struct packet *pkt, unsigned char *buf);
+
+
+/*  This function fills a packet with a datagram received from the network.
+ *  The fields that are not sent ('td', 'acked', 'retries', 'retransmitted') are reset, and the
+ *  'data' field is terminated by '\0' after the payload.
+ *
+ *  Parameters:
+ *  - pkt:              The packet to fill
+ *  - buf:              The datagram
+ *  - n:                Size of the datagram in bytes
+ *
+ *  Return:             0 on success, -1 if the datagram is too short, has a
+ *                      different PROTOCOL_VERSION or an invalid payload length
+ *                      (also for the ranges of a PKT_NACK and for the
+ *                      bitmap of a PKT_ACK with PKT_FLAG_SACK)
+ */
+int packet_deserialize(struct packet *pkt, const unsigned char *buf, size_t n);
+
+
 #endif /* defined(__Reliable_UDP__packet__) */
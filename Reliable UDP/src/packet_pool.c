@@ -0,0 +1,134 @@
+//
+//  packet_pool.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "packet_pool.h"
+
+
+struct packet_pool *new_packet_pool(int dim) {
+    struct packet_pool *pool;
+    int i;
+    
+    pool = malloc(sizeof(struct packet_pool));
+    if (pool == NULL) {
+        fprintf(stderr, "Error in new_packet_pool(): cannot allocate memory for packet_pool\n");
+        exit(EXIT_FAILURE);
+    }
+    //Allocate all the entries at once
+    pool->packets = malloc(sizeof(struct packet) * dim);
+    pool->tds = malloc(sizeof(struct time_data) * dim);
+    pool->free_list = malloc(sizeof(int) * dim);
+    if (pool->packets == NULL || pool->tds == NULL || pool->free_list == NULL) {
+        fprintf(stderr, "Error in new_packet_pool(): cannot allocate memory for entries\n");
+        exit(EXIT_FAILURE);
+    }
+    if (pthread_mutex_init(&pool->MTX, NULL) != 0 || pthread_cond_init(&pool->available, NULL) != 0) {
+        fprintf(stderr, "Error in new_packet_pool(): cannot initialize mutex\n");
+        exit(EXIT_FAILURE);
+    }
+    //All the entries are free
+    for (i = 0; i < dim; ++i)
+        pool->free_list[i] = dim - 1 - i;
+    pool->top = dim;
+    pool->dim = dim;
+    
+    return pool;
+}
+
+struct packet *packet_pool_get(struct packet_pool *pool) {
+    struct packet *pkt;
+    int i;
+    
+    if (pool == NULL) {
+        pkt = malloc(sizeof(struct packet));
+        if (pkt == NULL) {
+            fprintf(stderr, "Error in packet_pool_get(): cannot allocate memory for packet\n");
+            exit(EXIT_FAILURE);
+        }
+        pkt->td = NULL;
+        return pkt;
+    }
+    
+    if (pthread_mutex_lock(&pool->MTX) != 0) {
+        fprintf(stderr, "Error in packet_pool_get(): cannot lock mutex\n");
+        exit(EXIT_FAILURE);
+    }
+    //Wait until at least one entry is free
+    while (pool->top == 0)
+        pthread_cond_wait(&pool->available, &pool->MTX);
+    i = pool->free_list[--pool->top];
+    pthread_mutex_unlock(&pool->MTX);
+    
+    pkt = &pool->packets[i];
+    pkt->td = &pool->tds[i];
+    return pkt;
+}
+
+void packet_pool_put(struct packet_pool *pool, struct packet *pkt) {
+    long int i;
+    
+    if (pkt == NULL)
+        return;
+    //Find the entry of the packet
+    if (pool != NULL && pkt >= pool->packets && pkt < pool->packets + pool->dim)
+        i = pkt - pool->packets;
+    else {
+        //The packet does not belong to the pool
+        free(pkt);
+        return;
+    }
+    
+    if (pthread_mutex_lock(&pool->MTX) != 0) {
+        fprintf(stderr, "Error in packet_pool_put(): cannot lock mutex\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->free_list[pool->top++] = (int) i;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->MTX);
+}
+
+struct packet *packet_pool_new_packet(struct packet_pool *pool, int type, long long int seq, char *data, size_t dimension) {
+    struct packet *pkt;
+    
+    if (pool == NULL)
+        return new_packet(type, seq, data, dimension);
+    
+    pkt = packet_pool_get(pool);
+    packet_init(pkt, type, seq, data, dimension);
+    //Reset the 'time_data' of the entry, as 'new_time_data()' does
+    memset(pkt->td, 0, sizeof(struct time_data));
+    pkt->td->seq = seq;
+    pkt->td->time_send = get_monotonic_nsec();
+    
+    return pkt;
+}
+
+void packet_pool_delete(struct packet_pool *pool) {
+    pthread_mutex_destroy(&pool->MTX);
+    pthread_cond_destroy(&pool->available);
+    free(pool->packets);
+    free(pool->tds);
+    free(pool->free_list);
+    free(pool);
+}
@@ -0,0 +1,122 @@
+//
+//  packet_pool.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'packet_pool' data structure, an arena of
+//  packets allocated once for each transfer. Like 'packet' and 'time_data', it
+//  is located on the first level of the N-layer architecture of the project.
+//  Each entry of the pool is a 'packet' with its own 'time_data', so a packet
+//  taken from the pool never needs 'malloc()' or 'free()': the free entries are
+//  kept in a stack (free list), and taking or returning an entry costs O(1).
+//  The pool has a fixed capacity: it is sized by the caller from the sliding
+//  window, because a process never holds more packets than the ones in the
+//  window plus the ones of a batch of I/O (see IO_BATCH_SIZE in 'settings.h').
+//  All functions accept a NULL pool: in this case the packets are allocated
+//  with 'malloc()', as the ones used to establish the connection.
+
+
+#ifndef __Reliable_UDP__packet_pool__
+#define __Reliable_UDP__packet_pool__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "packet.h"
+#include "time_data.h"
+
+
+struct packet_pool {
+    struct packet *packets;     //Array of the packets of the pool
+    struct time_data *tds;      //Array of 'time_data': tds[i] belongs to packets[i]
+    int *free_list;             //Stack of the indexes of the free entries
+    int top;                    //Number of free entries
+    int dim;                    //Capacity of the pool
+    pthread_mutex_t MTX;        //Mutex to ensuring mutual exclusion for each thread
+    pthread_cond_t available;   //Used to wait until at least one entry is free
+};
+
+
+/*  This function creates a new 'packet_pool' with all the entries free
+ *
+ *  Parameters:
+ *  - dim:      Capacity of the pool
+ *
+ *  Return:     Pointer to a new initializated 'packet_pool'
+ */
+struct packet_pool *new_packet_pool(int dim);
+
+
+/*  This function takes a free packet from the pool. If all the entries are in
+ *  use, the thread waits until one of them is returned with 'packet_pool_put()'.
+ *  The fields of the packet are not initialized, except 'td', that points to
+ *  the 'time_data' of the entry.
+ *
+ *  Parameters:
+ *  - pool:     Pointer to the 'packet_pool' (if NULL, the packet is allocated
+ *              with 'malloc()' and 'td' is NULL)
+ *
+ *  Return:     Pointer to a packet
+ */
+struct packet *packet_pool_get(struct packet_pool *pool);
+
+
+/*  This function returns a packet to the pool. A packet that does not belong
+ *  to the pool is deleted with 'free()'.
+ *
+ *  Parameters:
+ *  - pool:     Pointer to the 'packet_pool' (can be NULL)
+ *  - pkt:      The packet to return
+ *
+ *  Return:     Nothing
+ */
+void packet_pool_put(struct packet_pool *pool, struct packet *pkt);
+
+
+/*  This function is like 'new_packet()' (see 'packet.h'), but the packet and its
+ *  'time_data' are taken from the pool.
+ *
+ *  Parameters:
+ *  - pool:     Pointer to the 'packet_pool' (if NULL, 'new_packet()' is used)
+ *  - type, seq, data, dimension: see 'new_packet()'
+ *
+ *  Return:     Pointer to a new packet
+ */
+struct packet *packet_pool_new_packet(struct packet_pool *pool, int type, long long int seq, char *data, size_t dimension);
+
+
+/*  This function frees all memory occupied by a 'packet_pool'. The packets of
+ *  the pool can not be used anymore.
+ *
+ *  Parameters:
+ *  - pool:     Pointer to the 'packet_pool'
+ *
+ *  Return:     Nothing
+ */
+void packet_pool_delete(struct packet_pool *pool);
+
+
+#endif /* defined(__Reliable_UDP__packet_pool__) */
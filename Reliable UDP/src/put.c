@@ -23,101 +23,211 @@
 //  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
 
 
+//Needed for 'ppoll()'
+#define _GNU_SOURCE
 
 #include "put.h"
 
-void *receiver_work(void *arg) {
-    struct thread_data *data = (struct thread_data *) arg;
-    struct packet *pkt;
-    int end = 0;
-    int percentage = 0, last_percentage = 0;
-    long long int received = 0;
+int sender_handle_pkt(struct thread_data *data, struct packet *pkt) {
+    int end = 0, percentage;
     
-    //while (arrived < data->number && end == 0) {
-    while (end == 0) {
-        
-        pkt = recv_pkt(data->sockfd, NULL, NULL);
-        
-        switch (pkt->type) {
-            case PKT_ERR:
-                print_err_arrived_msg(data->log, data->status, data->user, pkt->data);
-                data->stop_err++;
+    switch (pkt->type) {
+        case PKT_ERR:
+            print_err_arrived_msg(data->log, data->status, data->user, pkt->data);
+            (*data->stop_err)++;
+            end = 1;
+            break;
+        case PKT_NACK:
+            //Send again, in a single batch, all the packets of the ranges missing
+            window_controller_resend_ranges(data->wc, pkt);
+            break;
+        case PKT_FINACK:
+            print_finack_arrived_msg(data->status, data->user, data->verbose);
+            data->received++;
+            if (window_controller_set_ack(data->wc, pkt->seq) == 0) {
+                fprintf(stderr, "Error: PKT_FIN not found in the window\n");
+                exit(EXIT_FAILURE);
+            }
+            else {
                 end = 1;
-                break;
-            case PKT_REQ:
-                if (window_controller_resend_packet(data->wc, pkt->seq) == 1) {
-                    fprintf(stderr, "%s\n", _(STRING_PKT_NOT_FOUND_IN_WINDOW));
-                    exit(EXIT_FAILURE);
-                }
-                else
-                    free(pkt);
-                break;
-            case PKT_FINACK:
-                print_finack_arrived_msg(data->status, data->user, data->verbose);
-                received++;
-                if (window_controller_set_ack(data->wc, pkt->seq) == 0) {
-                    fprintf(stderr, "Error: PKT_FIN not found in the window\n");
-                    exit(EXIT_FAILURE);
-                }
-                else {
-                    end = 1;
-                    if (time_controller_delete_timer(data->tc, pkt->seq) == 0) {
-                        //In this case, 'time_data' was not found in 'timer_wheel'
-                    }
-                    else {
-                        //In this case, the 'time_data' was found and deleted
-                        //pthread_cond_signal(&data->tc->full);
-                    }
-                    percentage = 100 * (int)received / (int)data->number;
-                    if (percentage%10 == 0 && percentage != last_percentage) {
-                        print_completition_msg(data->log, data->status, data->user, percentage);
-                        last_percentage = percentage;
-                    }
+                //The 'time_data' can be already deleted from the 'timer_wheel'
+                time_controller_delete_timer(data->tc, pkt->seq);
+                percentage = 100 * (int)data->received / (int)data->number;
+                if (percentage%10 == 0 && percentage != data->last_percentage) {
+                    print_completition_msg(data->log, data->status, data->user, percentage);
+                    data->last_percentage = percentage;
                 }
-                break;
-            case PKT_ACK:
-                received++;
-                print_ack_arrived_msg(data->status, data->user, data->verbose, pkt->seq);
+            }
+            break;
+        case PKT_ACK:
+            print_ack_arrived_msg(data->status, data->user, data->verbose, pkt->seq);
+            //A cumulative and selective ACK can ack many packets at once:
+            //the window and the timers are updated with one lock each
+            if (pkt->flags & PKT_FLAG_SACK) {
+                data->received += window_controller_set_sack(data->wc, pkt);
+                time_controller_delete_timers(data->tc, pkt);
+                //Send again the packets lost, without waiting for their timeout
+                window_controller_fast_retransmit(data->wc, pkt);
+            }
+            else {
+                data->received++;
                 if (window_controller_set_ack(data->wc, pkt->seq) == 0) {
                     //In this case, pkt was not 'acked'
                 }
                 else {
-                    //In this case, pkt was acked
-                    if (time_controller_delete_timer(data->tc, pkt->seq) == 0) {
-                    //In this case, 'time_data' was not found
-                    }
-                    else {
-                        //In this case, 'time_data' was found and deleted
-                    }
-                    //printf("Timer trovato!\n");
-                }
-                percentage = 100 * (int)received / (int)data->number;
-                if (percentage%10 == 0 && percentage != last_percentage) {
-                    print_completition_msg(data->log, data->status, data->user, percentage);
-                    last_percentage = percentage;
+                    //In this case, pkt was acked: delete its timer
+                    time_controller_delete_timer(data->tc, pkt->seq);
                 }
+            }
+            //Print only the percentage in dozens
+            percentage = 100 * (int)data->received / (int)data->number;
+            if (percentage / 10 != data->last_percentage / 10) {
+                print_completition_msg(data->log, data->status, data->user, percentage / 10 * 10);
+                data->last_percentage = percentage;
+            }
+            break;
+    }
+    packet_pool_put(data->wc->pool, pkt);
+    
+    return end;
+}
+
+/*  This function is the work of the thread that owns the sliding window: it is
+ *  the only one that sends the packets, receives the ACKs and checks the timeouts,
+ *  so the window and the timers are never contended. The main thread reads the
+ *  file: this thread lends it empty packets through the 'ring' 'spare', and gets
+ *  them back filled through the 'ring' 'ready' (see 'ring.h').
+ *
+ *  Parameters:
+ *  - arg:      Represent a casting to 'stuct thread_data *'
+ *
+ *  Return:     Nothing
+ */
+void *sender_work(void *arg) {
+    struct thread_data *data = (struct thread_data *) arg;
+    long long int number = (long long int) data->number;
+    //ACKs received with a single 'recv_pkts()', or packets sent together
+    struct packet *batch[IO_BATCH_SIZE];
+    struct packet *pkt;
+    struct pollfd fds[2];
+    struct timespec timeout;
+    /*  next:   sequence number of the next packet to lend
+     *  sent:   number of packets of the file added into the window
+     *  lent:   number of packets lent to the main thread and not yet sent
+     */
+    long long int next = data->first, sent = 0, deadline, delay, now;
+    int end = 0, lent = 0, fin = 0, batched, nfds, n, k;
+    
+    while (end == 0) {
+        //Send the packets read, as many as the window and the 'pacer' allow
+        while ((k = window_controller_can_send(data->wc)) > 0) {
+            if (k > IO_BATCH_SIZE)
+                k = IO_BATCH_SIZE;
+            for (n = 0; n < k && (batch[n] = ring_pop(data->ready)) != NULL; ++n);
+            if (n == 0)
                 break;
+            window_controller_add_packets(data->wc, batch, n);
+            lent -= n;
+            sent += n;
+        }
+        
+        //Lend empty packets, numbered in the order of the file, in place of the ones sent
+        while (lent < SENDER_RING_SIZE && next < data->first + number) {
+            pkt = packet_pool_new_packet(data->wc->pool, PKT_DATA, next++, NULL, MAX_BLOCK_SIZE);
+            ring_push(data->spare, pkt);
+            lent++;
+        }
+        
+        //Finally, when all the packets are acked, send last packet (PKT_FIN)
+        if (fin == 0 && sent == number && window_controller_is_empty(data->wc) == 1 &&
+            window_controller_can_send(data->wc) > 0) {
+            pkt = packet_pool_new_packet(data->wc->pool, PKT_FIN, data->first + sent, NULL, 0);
+            window_controller_add_packet(data->wc, pkt);
+            fin = 1;
+        }
+        
+        //Send again the packets whose timeout has expired
+        if (time_controller_expire(data->tc) == 1) {
+            fprintf(stderr, "Generic error: lost connection or line too busy\n");
+            (*data->stop_err)++;
+            break;
+        }
+        
+        /*  Sleep until an ACK arrives, or until the next timeout. If the window
+         *  has free slots, also until the next packet allowed by the 'pacer', or
+         *  until the main thread passes a packet, if none is ready.
+         */
+        nfds = 1;
+        now = get_monotonic_usec();
+        deadline = time_controller_next_expiry(data->tc);
+        delay = fin == 0 ? window_controller_send_delay(data->wc) : -1;
+        if (delay >= 0 && sent < number && ring_prepare_sleep(data->ready) == 1) {
+            fds[1].fd = data->ready->efd;
+            fds[1].events = POLLIN;
+            fds[1].revents = 0;
+            nfds = 2;
+        }
+        else if (delay >= 0 && (sent < number || window_controller_is_empty(data->wc) == 1))
+            deadline = (deadline < 0 || now + delay < deadline) ? now + delay : deadline;
+        
+        if (deadline >= 0) {
+            deadline = deadline > now ? deadline - now : 0;
+            timeout.tv_sec = deadline / 1000000;
+            timeout.tv_nsec = (deadline % 1000000) * 1000;
+        }
+        fds[0].fd = data->sockfd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        if (ppoll(fds, (nfds_t) nfds, deadline >= 0 ? &timeout : NULL, NULL) == -1 && errno != EINTR) {
+            perror("ppoll() in sender_work()");
+            exit(EXIT_FAILURE);
+        }
+        if (nfds == 2)
+            ring_wake(data->ready);
+        
+        if ((fds[0].revents & POLLIN) == 0)
+            continue;
+        batched = recv_pkts(data->sockfd, data->wc->pool, batch, IO_BATCH_SIZE, NULL, NULL);
+        for (n = 0; n < batched; ++n) {
+            //Discard the datagrams of other transfers on the same socket, and
+            //the ones received after the last one
+            if (end == 1 || batch[n]->conn != data->wc->conn)
+                packet_pool_put(data->wc->pool, batch[n]);
+            else
+                end = sender_handle_pkt(data, batch[n]);
         }
     }
     
-    time_controller_stop(data->tc);
+    //Wake up the main thread, if it is waiting for an empty packet after an error
+    ring_close(data->spare);
     pthread_exit(NULL);
 }
 
 
-void send_file(int port, char *ip, int old_sockfd, int fd, char *filename, int user, struct server_status *status, FILE *log, int verbose) {
+void send_file(int port, char *ip, int sockfd, int fd, char *filename, int user, struct server_status *status, FILE *log, int verbose, int cc, unsigned int conn) {
+    unsigned long long int size = get_dimension(filename);
+    
+    //The whole file is a single range, from the first packet to the last one
+    send_range(port, ip, sockfd, fd, size, 1, (long long int) get_number(size), user, status, log, verbose, cc, conn);
+}
+
+
+void send_range(int port, char *ip, int old_sockfd, int fd, unsigned long long int file_size, long long int first, long long int last,
+                int user, struct server_status *status, FILE *log, int verbose, int cc, unsigned int conn) {
     struct sockaddr_in addr;
     struct time_controller *tc;
     struct window_controller *wc;
+    struct packet_pool *pool;
     struct thread_data data;
-    /*  seq:    is the first sequence number of the pkt to send
-     *  size:   dimension (in byte) of the file to send
-     *  number: number of pkts needed to send entirely the file
+    /*  src:    the blocks of the range, read from the file (see 'file_source.h')
+     *  size:   dimension (in byte) of the range to send
+     *  number: number of pkts needed to send entirely the range
      *  permanent_size: used to calculate upload speed
      */
-    
-    unsigned long long int seq = 1, size = get_dimension(filename);
-    unsigned long long int number = get_number(size);
+    struct file_source *src = new_file_source(fd, file_size);
+    file_source_set_range(src, first, last);
+    unsigned long long int size = src->end - src->offset;
+    unsigned long long int number = last >= first ? (unsigned long long int) (last - first + 1) : 0;
     unsigned long long int permanent_size = size;
     //Marker to exit in an error accurs
     int stop_err = 0;
@@ -135,11 +245,11 @@ void send_file(int port, char *ip, int old_sockfd, int fd, char *filename, int u
     long long int laps = 0;
     /* This variable is used to calculate the average time */
     double average = 0.0;
-    //If user == LS_SERVER, create a new socket
-    if (user == LS_SERVER) {
+    //If user == LS_SERVER, or the stream has not a socket, create a new socket
+    if (user == LS_SERVER || old_sockfd < 0) {
         new_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
         if(new_sockfd < 0) {
-            perror("socket() in send_file()");
+            perror("socket() in send_range()");
             exit(EXIT_FAILURE);
         }
     }
@@ -154,7 +264,7 @@ void send_file(int port, char *ip, int old_sockfd, int fd, char *filename, int u
     else {
         //Convert string in a dot-decimal IP address
         if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
-            perror("inet_pton() in send_file()");
+            perror("inet_pton() in send_range()");
             exit(EXIT_FAILURE);
         }
     }
@@ -162,10 +272,19 @@ void send_file(int port, char *ip, int old_sockfd, int fd, char *filename, int u
      *  To send a file, both data structures are essential.
      *  See 'window_controller.h' and 'time_controller.h' for details.
      */
-    tc = new_time_controller(TIME_CONTROLLER_GRANULARITY, WINDOW_DIMENSION, NULL, user, NULL);
-    wc = new_window_controller(WINDOW_DIMENSION, tc, new_sockfd, addr, -1);
-    //Start the controller thread for timeouts
-    time_controller_start(tc, wc);
+    tc = new_time_controller(WINDOW_DIMENSION, NULL, user, NULL);
+    /*  All the packets sent and received come from 'pool': it contains the packets
+     *  in the window, the ones lent to the main thread, a batch of ACKs and PKT_FIN.
+     *  See 'packet_pool.h' for details.
+     */
+    pool = new_packet_pool(WINDOW_DIMENSION + SENDER_RING_SIZE + IO_BATCH_SIZE + 1);
+    wc = new_window_controller(WINDOW_DIMENSION, tc, new_sockfd, addr, -1, pool, cc);
+    wc->conn = conn;
+    window_controller_start_at(wc, first);
+    /*  The 'time_controller' has no thread: its timers are checked by the thread
+     *  that owns the window with 'time_controller_expire()', so 'wc' is set here.
+     */
+    tc->wc = wc;
     
     //Fill 'thread_data' with all important value for the new receiver thread
     data.addr = addr;
@@ -179,127 +298,117 @@ void send_file(int port, char *ip, int old_sockfd, int fd, char *filename, int u
     data.log = log;
     data.verbose = verbose;
     data.user = user;
+    data.received = 0;
+    data.last_percentage = 0;
+    data.first = first;
+    data.spare = new_ring(SENDER_RING_SIZE);
+    data.ready = new_ring(SENDER_RING_SIZE);
     
     print_operation_started_msg(log, status, user, "PUT");
     
-    /*  Creates a new thread and throw it on the function 'receiver_work()'.
-     *  This new thread is responsible for receiving acks for packets sent
+    /*  Creates a new thread and throw it on the function 'sender_work()'.
+     *  This new thread owns the window: it sends the packets and receives the acks
      */
-    if(pthread_create(&data.thread, NULL, receiver_work, &data) != 0) {
-        perror("pthread_create() in send_file()");
+    if(pthread_create(&data.thread, NULL, sender_work, &data) != 0) {
+        perror("pthread_create() in send_range()");
         exit(EXIT_FAILURE);
     }
     
-    /*  The main thread is responsible to read progressively the file to send and
-     *  send the packets over the network.
+    /*  The main thread is responsible to read progressively the file to send,
+     *  into the packets lent by the thread that owns the window.
      */
-    ssize_t m;
+    struct packet *pkt;
+    size_t dimension;
     //Start the timer
     set_timer(timer, TIMER_START);
-    //The loop terminates when there are less than MAX_BLOCK_SIZE bytes to read in the file
-    while (size >= MAX_BLOCK_SIZE && stop_err == 0) {
-        //Create a new pkt with empy 'data' field
-        struct packet *pkt = new_packet(PKT_DATA, seq, NULL, MAX_BLOCK_SIZE);
-        //Fill 'data' field of the pkt with bytes read from file
-        m = read(fd, pkt->data, MAX_BLOCK_SIZE);
-        if (m < 0 || (size_t) m != MAX_BLOCK_SIZE) {
-            perror("read() in send_file()");
-            exit(EXIT_FAILURE);
-        }
-        //Add the packet into the sliding window
-        window_controller_add_packet(wc, pkt);
-        //Get a lap and update average time and laps
-        set_timer(timer, TIMER_LAP);
-        average += timer->last_time_catched;
-        laps++;
-        
-        print_pkt_sent_msg(status, user, verbose, seq);
-        
-        seq++;
-        sent++;
-        size -= MAX_BLOCK_SIZE;
-    }
-    
-    //Send the last PKT_DATA
-    if (size != 0 && stop_err == 0) {
-        struct packet *pkt = new_packet(PKT_DATA, seq, NULL, (size_t)size);
-        m = read(fd, pkt->data, (size_t)size);
-        if (m < 0 || (size_t) m != size) {
-            perror("last read() in send_file()");
-            exit(EXIT_FAILURE);
+    //The loop terminates when the whole file is read, or after an error
+    while (size > 0) {
+        pkt = ring_pop(data.spare);
+        if (pkt == NULL) {
+            if (ring_is_closed(data.spare) == 1)
+                break;
+            //Wait until an empty packet is lent
+            ring_wait(data.spare);
+            continue;
         }
+        //Give the next block of the file to the pkt (the last packet can be
+        //shorter) and pass it to be sent
+        dimension = file_source_fill(src, pkt);
+        ring_push(data.ready, pkt);
         
-        window_controller_add_packet(wc, pkt);
+        //Get a lap and update average time and laps
         set_timer(timer, TIMER_LAP);
         average += timer->last_time_catched;
         laps++;
         
-        print_pkt_sent_msg(status, user, verbose, seq);
+        print_pkt_sent_msg(status, user, verbose, pkt->seq);
         
-        seq++;
         sent++;
+        size -= dimension;
     }
     
-    //wait the necessary condition to send last packet (PKT_FIN)
-    while (window_controller_is_empty(wc) == 0 && stop_err == 0)
-        //Wait until sliding window is not empty
-        pthread_cond_wait(&wc->zero, &wc->m_zero);
-    
-    //Finally, send last packet (PKT_FIN)
-    if (stop_err == 0) {
-        struct packet *fin = new_packet(PKT_FIN, seq, NULL, 0);
-        window_controller_add_packet(wc, fin);
-    }
-    
-    //Wait until the receiver thread ends its work
+    //Wait until the thread that owns the window ends its work (PKT_FINACK or error)
     if (pthread_join(data.thread, NULL) != 0) {
-        perror ("pthread_join() in send_file()");
+        perror ("pthread_join() in send_range()");
         exit(EXIT_FAILURE);
     }
     
-    //Free memory
+    //Free memory. A worker of the server sends many files, so also the socket
+    //created above is closed
     window_controller_dispose(wc);
+    time_controller_dispose(tc);
+    ring_delete(data.spare);
+    ring_delete(data.ready);
+    packet_pool_delete(pool);
+    file_source_delete(src);
+    if (new_sockfd != old_sockfd)
+        close(new_sockfd);
     
     /*  msg: final report
      *  This message shows the data relating to the operation just ended
      *  1) total time elapsed
      *  2) average time between receipit (average / laps)
      *  3) total pkts received
+     *  It is printed only if the file was completely sent: on error, the thread
+     *  that owns the window has already printed the reason
      */
-    get_sem(status);
-    if (user == LS_SERVER) {
-        printf("%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\n",
-               get_current_time(), _(STRING_CHILD),
-               getpid(), _(STRING_OPERATION_COMPLETED),
-               _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
-               _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
-               _(STRING_TOTAL_PKTS_SEND), sent);
-        if (log)
-            fprintf(log, "%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\n",
-                    get_current_time(), _(STRING_CHILD),
-                    getpid(), _(STRING_OPERATION_COMPLETED),
-                    _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
-                    _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
-                    _(STRING_TOTAL_PKTS_SEND), sent);
-    }
-    else {
-        printf("%s %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\t   %s: %8f MB/s\n\n",
-               get_current_time(), _(STRING_OPERATION_COMPLETED),
-               _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
-               _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
-               _(STRING_TOTAL_PKTS_SEND), sent,
-               _(STRING_UPLOAD_SPEED), (double)permanent_size/1024/1024/get_total_time_catched(timer));
-        if (log)
-            fprintf(log, "%s %s\n\t%s: %8f s.\n\t%s: %8f s. per pkt\n\t%s: %lld\n\t   %s: %8f MB/s\n\n",
-                    get_current_time(), _(STRING_OPERATION_COMPLETED),
-                    _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
-                    _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
-                    _(STRING_TOTAL_PKTS_SEND), sent,
-                    _(STRING_UPLOAD_SPEED), (double)permanent_size/1024/1024/get_total_time_catched(timer));
+    if (stop_err == 0) {
+        get_sem(status);
+        if (user == LS_SERVER) {
+            printf("%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\n",
+                   get_current_time(), _(STRING_CHILD),
+                   getpid(), _(STRING_OPERATION_COMPLETED),
+                   _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
+                   _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
+                   _(STRING_TOTAL_PKTS_SEND), sent);
+            if (log)
+                fprintf(log, "%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\n",
+                        get_current_time(), _(STRING_CHILD),
+                        getpid(), _(STRING_OPERATION_COMPLETED),
+                        _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
+                        _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
+                        _(STRING_TOTAL_PKTS_SEND), sent);
+        }
+        else {
+            printf("%s %s\n\t   %s: %8f s.\n\t   %s: %8f s. per pkt\n\t   %s: %lld\n\t   %s: %8f MB/s\n\n",
+                   get_current_time(), _(STRING_OPERATION_COMPLETED),
+                   _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
+                   _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
+                   _(STRING_TOTAL_PKTS_SEND), sent,
+                   _(STRING_UPLOAD_SPEED), (double)permanent_size/1024/1024/get_total_time_catched(timer));
+            if (log)
+                fprintf(log, "%s %s\n\t%s: %8f s.\n\t%s: %8f s. per pkt\n\t%s: %lld\n\t   %s: %8f MB/s\n\n",
+                        get_current_time(), _(STRING_OPERATION_COMPLETED),
+                        _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(timer),
+                        _(STRING_AVERAGE_TIME_TO_SEND),    average/laps,
+                        _(STRING_TOTAL_PKTS_SEND), sent,
+                        _(STRING_UPLOAD_SPEED), (double)permanent_size/1024/1024/get_total_time_catched(timer));
+        }
+        release_sem(status);
     }
-    release_sem(status);
 
     /* end msg */
+    free(timer);
     fflush(stdout);
     if (log)
         fflush(log);
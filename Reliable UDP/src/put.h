@@ -31,6 +31,13 @@
 //  'send_file' prepares the server or the client to send a file on the
 //  network. it is advisable to view the comments within the code to study the
 //  behavior of this function, because it is very complex.
+//  The sliding window has a single owner: a thread that sends the packets,
+//  receives the ACKs and checks the timeouts, while the main thread only reads
+//  the file. They exchange the packets through two 'ring' (see 'ring.h'), so the
+//  threads do not wait on mutexes and conditions for each packet.
+//  'send_range' sends only a range of blocks of the file: it is used by the
+//  streams of a transfer split into many streams (see 'streams.h'), and by
+//  'send_file', that sends the whole file as a single range.
 
 #ifndef __Reliable_UDP__put__
 #define __Reliable_UDP__put__
@@ -46,6 +53,24 @@
 #include "strings.h"
 #include "print_messages.h"
 #include "timer.h"
+#include "file_source.h"
+
+
+/*  This function handles a packet received by the sender process: an ACK, a
+ *  PKT_FINACK, a PKT_NACK or a PKT_ERR. It updates the window and the timers,
+ *  sends again the packets lost and prints the percentage of completion. At the
+ *  end, the packet is returned to the 'packet_pool' of the window.
+ *  It is used by the thread that owns the window in 'send_file()', and by
+ *  the sessions of the event server (see 'session.h').
+ *
+ *  Params:
+ *  - data:             The 'thread_data' of the transfer
+ *  - pkt:              The packet received
+ *
+ *  Return:             1 if the transfer is over (PKT_FINACK received, or an
+ *                      error: in this case 'stop_err' is set), otherwise 0
+ */
+int sender_handle_pkt(struct thread_data *data, struct packet *pkt);
 
 
 /*  See the ABSTRACT for details
@@ -64,12 +89,38 @@
  *  - log:              Pointer to a log file previously opened. If the log
  *                      service is unavailable, 'log' is NULL.
  *  - verbose:          0 if verbose mode is not activated, otherwise 1
+ *  - cc:               The congestion control algorithm (see 'congestion_control.h')
+ *  - conn:             Connection ID of the transfer, or 0 if the transfer has
+ *                      its own port (see PKT_HEADER_SIZE in 'packet.h')
  *
  *  Return:             Nothing
  *
  *  Effects:
  *  Prepares the server or the client to send a file
  */
-void send_file(int port, char *ip, int sockfd, int fd, char *filename, int user, struct server_status *status, FILE *log, int verbose);
+void send_file(int port, char *ip, int sockfd, int fd, char *filename, int user, struct server_status *status, FILE *log, int verbose, int cc, unsigned int conn);
+
+
+/*  This function is like 'send_file()', but it sends only the blocks of the
+ *  file from 'first' to 'last', with their own sequence numbers: the receiver
+ *  writes them at their offsets (see 'receive_range()' in 'get.h'). PKT_FIN
+ *  has sequence number last + 1.
+ *
+ *  Params:
+ *  - port:             Communication port
+ *  - ip:               The IP of the caller. The server use NULL
+ *  - sockfd:           Socket file descriptor previously opened. If it is
+ *                      negative, a new socket is created (and closed at the end)
+ *  - fd:               File descriptor of the file to send (previously opened)
+ *  - file_size:        Size of the whole file in bytes
+ *  - first:            Sequence number of the first block to send
+ *  - last:             Sequence number of the last block to send (first - 1
+ *                      to send only PKT_FIN)
+ *  - others:           See 'send_file()'
+ *
+ *  Return:             Nothing
+ */
+void send_range(int port, char *ip, int sockfd, int fd, unsigned long long int file_size, long long int first, long long int last,
+                int user, struct server_status *status, FILE *log, int verbose, int cc, unsigned int conn);
 
 #endif /* defined(__Reliable_UDP__put__) */
@@ -0,0 +1,104 @@
+//
+//  reorder_buffer.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "reorder_buffer.h"
+
+
+/*  These macros test, set and clear the bit of the slot 'i' in the bitmap */
+#define IS_PRESENT(rb, i)   ((rb)->present[(i) / 8] & (1 << ((i) % 8)))
+#define SET_PRESENT(rb, i)  ((rb)->present[(i) / 8] |= (unsigned char) (1 << ((i) % 8)))
+#define CLR_PRESENT(rb, i)  ((rb)->present[(i) / 8] &= (unsigned char) ~(1 << ((i) % 8)))
+
+
+struct reorder_buffer *new_reorder_buffer(int dim, long long int base) {
+    struct reorder_buffer *rb;
+    
+    rb = malloc(sizeof(struct reorder_buffer));         //allocate memory for 'reorder_buffer'
+    if (rb == NULL) {
+        fprintf(stderr, "Error in new_reorder_buffer(): cannot allocate memory for reorder_buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    rb->present = calloc((size_t) (dim + 7) / 8, 1);    //allocate memory for the empty bitmap
+    if (rb->present == NULL) {
+        fprintf(stderr, "Error in new_reorder_buffer(): cannot allocate memory for slots\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    rb->base = base;
+    rb->head = 0;
+    rb->dim = dim;
+    rb->num = 0;
+    
+    return rb;
+}
+
+int reorder_buffer_in_range(struct reorder_buffer *rb, long long int seq) {
+    return (seq >= rb->base && seq - rb->base < rb->dim) ? 1 : 0;
+}
+
+int reorder_buffer_contains(struct reorder_buffer *rb, long long int seq) {
+    int slot;
+    
+    if (reorder_buffer_in_range(rb, seq) == 0)
+        return 0;
+    slot = (int) ((rb->head + (seq - rb->base)) % rb->dim);
+    return IS_PRESENT(rb, slot) ? 1 : 0;
+}
+
+int reorder_buffer_mark(struct reorder_buffer *rb, long long int seq) {
+    int slot;
+    
+    if (reorder_buffer_in_range(rb, seq) == 0)
+        return 1;
+    //The slot is calculated directly from the sequence number
+    slot = (int) ((rb->head + (seq - rb->base)) % rb->dim);
+    if (IS_PRESENT(rb, slot))
+        return 2;
+    
+    SET_PRESENT(rb, slot);
+    rb->num++;
+    return 0;
+}
+
+long long int reorder_buffer_advance(struct reorder_buffer *rb) {
+    //Continuously until the packet 'base' is missing
+    while (IS_PRESENT(rb, rb->head)) {
+        CLR_PRESENT(rb, rb->head);
+        rb->head = (rb->head + 1) % rb->dim;    //Move 'head' of one position
+        rb->base++;
+        rb->num--;
+    }
+    return rb->base;
+}
+
+int reorder_buffer_is_empty(struct reorder_buffer *rb) {
+    return rb->num == 0 ? 1 : 0;
+}
+
+void reorder_buffer_delete(struct reorder_buffer *rb) {
+    free(rb->present);
+    free(rb);
+}
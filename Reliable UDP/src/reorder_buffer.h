@@ -0,0 +1,139 @@
+//
+//  reorder_buffer.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'reorder_buffer' data structure, used by the
+//  receiving process in place of the 'window'. The receiving process writes each
+//  packet in the file at its own offset as soon as it arrives (see
+//  'window_controller_add_packet()'), so the 'reorder_buffer' does not keep the
+//  packets: it only keeps track of the ones received. It is a circular bitmap
+//  of 'dim' bits addressed directly by sequence number: the packet with sequence
+//  number 'seq' is marked in the bit at distance 'seq - base' from 'head', where
+//  'base' is the sequence number of the first packet not yet received. So, a
+//  packet received out of order is marked in O(1), and 'base' moves forward
+//  until the first missing one. A slot costs only one bit, so the memory of the
+//  window does not depend on MAX_BLOCK_SIZE. The 'reorder_buffer' is placed in
+//  a layer below 'window_controller'.
+
+
+#ifndef __Reliable_UDP__reorder_buffer__
+#define __Reliable_UDP__reorder_buffer__
+
+#include "packet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+struct reorder_buffer {
+    long long int base;         //Sequence number of the packet expected in slot 'head'
+    int head;                   //Index: slot of the packet with sequence number == base
+    int dim;                    //Number of slots
+    int num;                    //Number of packets received after 'base'
+    unsigned char *present;     //Bitmap: bit 'i' is set if the packet of slot 'i' was received
+};
+
+
+/*  This function creates a new initialized 'reorder_buffer' data structure
+ *
+ *  Parameters:
+ *  - dim:      Number of slots of the circular bitmap
+ *  - base:     Sequence number of the first packet expected
+ *
+ *  Return:     Pointer to a new initializated 'reorder_buffer'
+ */
+struct reorder_buffer *new_reorder_buffer(int dim, long long int base);
+
+
+/*  This function checks if a packet with a given sequence number can be marked
+ *  in the 'reorder_buffer', that is if base <= seq < base + dim.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *  - seq:      Sequence number to check
+ *
+ *  Return:     1 if 'seq' is in the range of the buffer, otherwise 0
+ */
+int reorder_buffer_in_range(struct reorder_buffer *rb, long long int seq);
+
+
+/*  This function checks if the packet with a given sequence number is already
+ *  marked in the 'reorder_buffer'.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *  - seq:      Sequence number to check
+ *
+ *  Return:     1 if the packet is marked, otherwise 0
+ */
+int reorder_buffer_contains(struct reorder_buffer *rb, long long int seq);
+
+
+/*  This function marks the packet with a given sequence number as received.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *  - seq:      Sequence number of the packet received
+ *
+ *  Return:     0 on success, 1 if the sequence number is out of range,
+ *              2 if the packet is already marked
+ */
+int reorder_buffer_mark(struct reorder_buffer *rb, long long int seq);
+
+
+/*  This function moves 'head' and 'base' forward over all the contiguous
+ *  packets received, starting from 'base', until the first missing one.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *
+ *  Return:     The new 'base', that is the first packet not yet received
+ */
+long long int reorder_buffer_advance(struct reorder_buffer *rb);
+
+
+/*  This function checks if the 'reorder_buffer' is empty, that is if no packet
+ *  after 'base' was received.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *
+ *  Return:     1 if 'reorder_buffer' is empty, otherwise 0
+ */
+int reorder_buffer_is_empty(struct reorder_buffer *rb);
+
+
+/*  This function frees all memory occupied by a 'reorder_buffer'.
+ *
+ *  Parameters:
+ *  - rb:       Pointer to 'reorder_buffer' through wich execute the operation
+ *
+ *  Return:     Nothing
+ */
+void reorder_buffer_delete(struct reorder_buffer *rb);
+
+
+#endif /* defined(__Reliable_UDP__reorder_buffer__) */
@@ -0,0 +1,149 @@
+//
+//  ring.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "ring.h"
+
+
+/*  Write on the eventfd to wake up the consumer */
+static void signal_consumer(struct ring *r) {
+    uint64_t one = 1;
+    
+    if (write(r->efd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        perror("write() in ring");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+struct ring *new_ring(int dim) {
+    struct ring *r;
+    
+    r = malloc(sizeof(struct ring));                    //allocate memory for 'ring'
+    if (r == NULL) {
+        fprintf(stderr, "Error in new_ring(): cannot allocate memory for ring\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    r->slots = malloc(sizeof(struct packet *) * dim);   //allocate memory for circular array
+    if (r->slots == NULL) {
+        fprintf(stderr, "Error in new_ring(): cannot allocate memory for slots\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    r->efd = eventfd(0, EFD_NONBLOCK);
+    if (r->efd == -1) {
+        perror("eventfd() in new_ring()");
+        exit(EXIT_FAILURE);
+    }
+    
+    r->dim = (unsigned long) dim;
+    atomic_init(&r->head, 0);       //The 'ring' is empty
+    atomic_init(&r->tail, 0);       //
+    atomic_init(&r->sleeping, 0);
+    atomic_init(&r->closed, 0);
+    
+    return r;
+}
+
+int ring_push(struct ring *r, struct packet *pkt) {
+    unsigned long tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    
+    if (tail - atomic_load(&r->head) == r->dim)
+        return 1;
+    
+    r->slots[tail % r->dim] = pkt;
+    //Publish the packet: the consumer reads the slot only after this store
+    atomic_store(&r->tail, tail + 1);
+    
+    //Wake up the consumer only if it is sleeping
+    if (atomic_exchange(&r->sleeping, 0) == 1)
+        signal_consumer(r);
+    return 0;
+}
+
+struct packet *ring_pop(struct ring *r) {
+    unsigned long head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    struct packet *pkt;
+    
+    if (head == atomic_load(&r->tail))
+        return NULL;
+    
+    pkt = r->slots[head % r->dim];
+    //Free the slot: the producer writes it only after this store
+    atomic_store(&r->head, head + 1);
+    return pkt;
+}
+
+int ring_prepare_sleep(struct ring *r) {
+    atomic_store(&r->sleeping, 1);
+    //Check again after setting the flag: a packet added before would not wake
+    //the consumer up
+    if (atomic_load(&r->head) != atomic_load(&r->tail) || atomic_load(&r->closed) == 1) {
+        atomic_store(&r->sleeping, 0);
+        return 0;
+    }
+    return 1;
+}
+
+void ring_wake(struct ring *r) {
+    uint64_t value;
+    
+    atomic_store(&r->sleeping, 0);
+    //Empty the counter of the eventfd
+    if (read(r->efd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        perror("read() in ring_wake()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void ring_wait(struct ring *r) {
+    struct pollfd pfd;
+    
+    if (ring_prepare_sleep(r) == 0)
+        return;
+    
+    pfd.fd = r->efd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+        perror("poll() in ring_wait()");
+        exit(EXIT_FAILURE);
+    }
+    ring_wake(r);
+}
+
+void ring_close(struct ring *r) {
+    atomic_store(&r->closed, 1);
+    signal_consumer(r);
+}
+
+int ring_is_closed(struct ring *r) {
+    return atomic_load(&r->closed);
+}
+
+void ring_delete(struct ring *r) {
+    close(r->efd);                      //close the eventfd
+    free(r->slots);                     //delete circular array memory
+    free(r);                            //delete struct memory
+}
@@ -0,0 +1,167 @@
+//
+//  ring.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'ring' data structure, used to pass packets
+//  between two threads without mutex. It is a circular array of pointers to
+//  packets, like 'window', with a single producer (the thread that calls
+//  'ring_push()') and a single consumer (the thread that calls 'ring_pop()').
+//  Each index is written only by one of them, and it is read by the other one
+//  with atomic operations (C11 'stdatomic.h'), so a packet is passed with a
+//  couple of atomic operations and no system call.
+//  The consumer sleeps only when the 'ring' is empty: it announces it with
+//  'ring_prepare_sleep()', and the producer wakes it up through an eventfd only
+//  if it was sleeping. So the wakeups are not one for each packet, but one for
+//  each time the consumer finds the 'ring' empty.
+//  The 'ring' is used by the sending process (see 'send_file()' in 'put.c'):
+//  the thread that reads the file receives empty packets from a 'ring' and
+//  passes them back full through another one to the thread that owns the window.
+
+
+#ifndef __Reliable_UDP__ring__
+#define __Reliable_UDP__ring__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "packet.h"
+
+struct ring {
+    struct packet **slots;      //Circular array of pointers to packets
+    unsigned long dim;          //Dimension of the array
+    atomic_ulong head;          //Counter of the packets got (written only by the consumer)
+    atomic_ulong tail;          //Counter of the packets added (written only by the producer)
+    atomic_int sleeping;        //1 if the consumer is sleeping (or going to)
+    atomic_int closed;          //1 if 'ring_close()' was called
+    int efd;                    //eventfd used to wake up the consumer
+};
+
+
+/*  This function creates a new empty 'ring'
+ *
+ *  Parameters:
+ *  - dim:      Max number of packets in the 'ring'
+ *
+ *  Return:     Pointer to a new initialized 'ring'
+ */
+struct ring *new_ring(int dim);
+
+
+/*  This function adds a packet into a 'ring', and wakes up the consumer if it
+ *  is sleeping. Only the producer can call it.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *  - pkt:      The packet to add
+ *
+ *  Return:     1 if the 'ring' is full and the packet was not added, 0 on success
+ */
+int ring_push(struct ring *r, struct packet *pkt);
+
+
+/*  This function gets the first packet of a 'ring'. Only the consumer can call it.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     The first packet, or NULL if the 'ring' is empty
+ */
+struct packet *ring_pop(struct ring *r);
+
+
+/*  The consumer calls this function before sleeping, and it sleeps only if the
+ *  function returns 1. Then, it waits for the eventfd 'efd' (for example, with
+ *  'poll()' together with other file descriptors) and calls 'ring_wake()'.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     1 if the 'ring' is empty and not closed, so the consumer can
+ *              sleep; otherwise 0
+ */
+int ring_prepare_sleep(struct ring *r);
+
+
+/*  The consumer calls this function when it wakes up, after 'ring_prepare_sleep()'
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     Nothing
+ */
+void ring_wake(struct ring *r);
+
+
+/*  This function waits until a packet is added into a 'ring', or the 'ring'
+ *  is closed. Only the consumer can call it.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     Nothing
+ */
+void ring_wait(struct ring *r);
+
+
+/*  This function closes a 'ring': no other packets will be added, and the
+ *  consumer is woken up. It can be called by any thread.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     Nothing
+ */
+void ring_close(struct ring *r);
+
+
+/*  This function checks if a 'ring' is closed.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     1 if the 'ring' is closed, otherwise 0
+ */
+int ring_is_closed(struct ring *r);
+
+
+/*  This function frees all memory occupied by a 'ring'. The packets are
+ *  not deleted.
+ *
+ *  Parameters:
+ *  - r:        Pointer to 'ring' through wich execute the operation
+ *
+ *  Return:     Nothing
+ */
+void ring_delete(struct ring *r);
+
+
+#endif /* defined(__Reliable_UDP__ring__) */
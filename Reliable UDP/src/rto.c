@@ -0,0 +1,98 @@
+//
+//  rto.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "rto.h"
+
+#define RTO_MIN         ((long long int) RTO_MIN_USEC * 1000)
+#define RTO_MAX         ((long long int) RTO_MAX_USEC * 1000)
+#define RTO_GRANULARITY ((long long int) TIMER_WHEEL_RESOLUTION * 1000)
+
+
+/*  Keep a timeout between RTO_MIN and RTO_MAX */
+static long long int clamp(long long int timeout) {
+    if (timeout < RTO_MIN)
+        return RTO_MIN;
+    if (timeout > RTO_MAX)
+        return RTO_MAX;
+    return timeout;
+}
+
+
+struct rto_estimator *new_rto_estimator() {
+    struct rto_estimator *r;
+    
+    r = malloc(sizeof(struct rto_estimator));
+    if (r == NULL) {
+        fprintf(stderr, "Error in new_rto_estimator(): cannot allocate memory for rto_estimator\n");
+        exit(EXIT_FAILURE);
+    }
+    r->srtt = 0;
+    r->rttvar = 0;
+    r->samples = 0;
+    //Initial RTO, used until the first sample
+    r->rto = (long long int) DEFAULT_TIMEOUT_SEC * 1000000000 + (long long int) DEFAULT_TIMEOUT_USEC * 1000;
+    
+    return r;
+}
+
+void rto_sample(struct rto_estimator *r, long long int rtt) {
+    long long int err;
+    
+    if (rtt <= 0)
+        return;
+    
+    if (r->samples == 0) {
+        r->srtt = rtt;
+        r->rttvar = rtt / 2;
+    }
+    else {
+        //RTTVAR uses the SRTT before this sample
+        err = rtt - r->srtt;
+        r->srtt += err / 8;
+        if (err < 0)
+            err = -err;
+        r->rttvar += (err - r->rttvar) / 4;
+    }
+    r->samples++;
+    
+    r->rto = clamp(r->srtt + (4 * r->rttvar > RTO_GRANULARITY ? 4 * r->rttvar : RTO_GRANULARITY));
+}
+
+long long int rto_get(struct rto_estimator *r) {
+    return r->rto;
+}
+
+long long int rto_srtt(struct rto_estimator *r) {
+    return r->srtt;
+}
+
+long long int rto_backoff(long long int timeout) {
+    //Check before doubling, so the value can not overflow
+    return timeout >= RTO_MAX / 2 ? RTO_MAX : clamp(timeout * 2);
+}
+
+void rto_delete(struct rto_estimator *r) {
+    free(r);
+}
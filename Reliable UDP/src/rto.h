@@ -0,0 +1,105 @@
+//
+//  rto.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'rto_estimator' data structure, used by the
+//  sending process to calculate the retransmission timeout (RTO) of the packets
+//  from the RTT samples, as described by RFC 6298:
+//
+//  first sample R:     SRTT = R, RTTVAR = R / 2
+//  next samples R:     RTTVAR = 3/4 x RTTVAR + 1/4 x |SRTT - R|
+//                      SRTT = 7/8 x SRTT + 1/8 x R
+//  RTO:                SRTT + max(G, 4 x RTTVAR), between RTO_MIN_USEC and RTO_MAX_USEC
+//
+//  where G is the granularity of the timers (TIMER_WHEEL_RESOLUTION). Until the
+//  first sample, the RTO is DEFAULT_TIMEOUT_SEC and DEFAULT_TIMEOUT_USEC.
+//  All the times are in nsecs of CLOCK_MONOTONIC, kept in integers: the
+//  estimator does not use floating point math.
+//  The samples must follow Karn's rule: the RTT of a packet sent more than once
+//  is ambiguous, because the ACK can refer to any copy, so it is not sampled
+//  (see 'window_controller_set_sack()'). When a timer expires, the timeout of
+//  the packet is doubled with 'rto_backoff()'.
+
+
+#ifndef __Reliable_UDP__rto__
+#define __Reliable_UDP__rto__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "settings.h"
+
+
+struct rto_estimator {
+    long long int srtt;         //Smoothed RTT (nsecs)
+    long long int rttvar;       //RTT variation (nsecs)
+    long long int rto;          //Current retransmission timeout (nsecs)
+    long long int samples;      //Number of RTT samples
+};
+
+
+/*  This function creates a new 'rto_estimator', without samples.
+ *
+ *  Return:         Pointer to a new initialized 'rto_estimator'
+ */
+struct rto_estimator *new_rto_estimator();
+
+
+/*  This function updates the estimator with a new RTT sample.
+ *
+ *  Parameters:
+ *  - r:            Pointer to the 'rto_estimator'
+ *  - rtt:          The RTT measured (nsecs). Samples <= 0 are ignored
+ *
+ *  Return:         Nothing
+ */
+void rto_sample(struct rto_estimator *r, long long int rtt);
+
+
+/*  This function returns the timeout of a packet sent for the first time (nsecs) */
+long long int rto_get(struct rto_estimator *r);
+
+
+/*  This function returns the smoothed RTT (nsecs), 0 if there are no samples */
+long long int rto_srtt(struct rto_estimator *r);
+
+
+/*  This function doubles the timeout of a packet whose timer expired, up to
+ *  RTO_MAX_USEC.
+ *
+ *  Parameters:
+ *  - timeout:      The timeout of the packet (nsecs)
+ *
+ *  Return:         The new timeout (nsecs)
+ */
+long long int rto_backoff(long long int timeout);
+
+
+/*  This function frees all memory occupied by a 'rto_estimator' */
+void rto_delete(struct rto_estimator *r);
+
+
+#endif /* defined(__Reliable_UDP__rto__) */
@@ -31,13 +31,29 @@
 //  1)  The server is waiting for a new request
 //  2)  A new request is received
 //  3)  The server processes the request and generates a free port number to be
-//      sent to the client. Then, a new child process is created. This process
-//      is responsible to execute the request.
+//      sent to the client. Then, the request is passed to a worker process,
+//      that is responsible to execute it.
 //  4)  The father process return to listening for a new request
-//  5)  When the child process terminates the work, it is killed
+//  5)  When the worker terminates the work, it waits for another request
+//  A GET or a PUT can be split into many streams (see TRANSFER_STREAMS in
+//  'settings.h'): each stream is a request of its own, on its own port, that
+//  transfers a range of blocks of the file.
+//  A GET or a PUT whose last transfer died is resumed from the first packet
+//  missing in the partial copy of the receiver (see 'checkpoint.h'): for a PUT,
+//  the father process looks for the copy and creates its checkpoint.
+//  The workers (WORKER_PROCESSES in 'settings.h') are created at startup, and
+//  take the requests from a queue in the shared memory (see 'server_status.h').
+//  If a worker is killed during a transfer, the father process creates a new
+//  one. With WORKER_PROCESSES == 0, a new child process is created for each
+//  request, and it is killed at the end of the work.
+//  With the option '-e', the server does not create processes and does not use
+//  other ports: all the transfers run on SERV_PORT, served by a few event loops
+//  (see 'event_server.h').
 
 
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/ipc.h>
@@ -52,17 +68,273 @@
 #include "list.h"
 #include "strings.h"
 #include "server_status.h"
+#include "event_server.h"
+#include "checkpoint.h"
 #include <locale.h>
 
 /*  Global variables:
  *
  *  verbose_mode:   if 1, the verbose mode will be activated
  *  log_file:       if 1, the log file will be written
+ *  event_mode:     if 1, the requests are served by event loops instead of processes
  *
  *  These variables are configured via input
  */
 int verbose_mode = 0;
 int log_file = 0;
+int event_mode = 0;
+
+
+/*  This function executes a request accepted by the father process, on the port
+ *  reserved for it. At the end, the port is released.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - job:          The request
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         Nothing
+ */
+void serve_job(struct server_status *status, struct job *job, FILE *log) {
+    struct checkpoint *cp;
+    int fd;
+    
+    //Set itself as unique user of this port
+    use_port(status, job->port, getpid());
+    switch (job->type) {
+        case PKT_PUT:
+            //Prepare to receive the range of the file (already created by the
+            //father process, with its checkpoint), together with the other streams
+            fd = open_file(WRITE, job->filename);
+            allocate_file(fd, job->last);
+            cp = open_checkpoint(job->filename);
+            receive_range(fd, job->first, job->last, job->port, LS_SERVER, NULL, 0, verbose_mode, status, log, 0, "GET", cp);
+            checkpoint_delete(cp);
+            close_file(fd);
+            break;
+        case PKT_GET:
+            //Open the file and send the range of the stream
+            fd = open_file(READ, job->filename);
+            send_range(job->port, NULL, 0, fd, get_dimension(job->filename), job->first, job->last,
+                       LS_SERVER, status, log, verbose_mode, job->cc, 0);
+            close_file(fd);
+            break;
+        case PKT_LS:
+            //Open the list file and send it
+            fd = open_file(READ, job->filename);
+            send_file(job->port, NULL, 0, fd, job->filename, LS_SERVER, status, log, verbose_mode, job->cc, 0);
+            close_file(fd);
+            //At the end, remove the list file from 'temp/' directory
+            remove_list(job->filename);
+            break;
+    }
+    //At the end, decrease number of active processes...
+    decrease_processes(status);
+    //...and free the port
+    close_port(status, job->port);
+}
+
+
+/*  This function creates a new worker process. The worker serves the requests
+ *  in the queue of 'status', one at a time, and it never returns.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         Nothing
+ */
+void start_worker(struct server_status *status, FILE *log) {
+    struct job job;
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork() in start_worker()");
+        exit(EXIT_FAILURE);
+    }
+    //WORKER WORK
+    else if (pid == 0) {
+        //The worker is killed together with the father process
+        if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1) {
+            perror("prctl() in start_worker()");
+            exit(EXIT_FAILURE);
+        }
+        while (1) {
+            pop_job(status, &job);
+            serve_job(status, &job, log);
+        }
+    }
+}
+
+
+/*  This function passes a request accepted to a worker. With WORKER_PROCESSES
+ *  == 0, a new child process is created to execute it.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - job:          The request
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         Nothing
+ */
+void dispatch_job(struct server_status *status, struct job *job, FILE *log) {
+    //Increase the number of active process
+    increase_processes(status);
+    
+    if (WORKER_PROCESSES > 0) {
+        push_job(status, job);
+        return;
+    }
+    
+    //Create new child process
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork() in dispatch_job()");
+        exit(EXIT_FAILURE);
+    }
+    //CHILD PROCESS WORK
+    else if (pid == 0) {
+        serve_job(status, job, log);
+        //exit (kill)
+        _exit(0);
+    }
+}
+
+
+/*  This function reserves the ports of the streams of a GET or a PUT. The client
+ *  asks for a number of streams (see PKT_STREAMS_MASK in 'packet.h'), but at
+ *  most one stream is granted for each packet of the file, and one for each
+ *  process that the server can still run.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - pkt:          The request
+ *  - number:       Number of packets to transfer
+ *  - ports:        Array of PKT_MAX_STREAMS elements, filled with the ports reserved
+ *
+ *  Return:         Number of streams granted (0 if no port is free)
+ */
+int reserve_streams(struct server_status *status, struct packet *pkt, unsigned long long int number, int *ports) {
+    int streams = (pkt->flags & PKT_STREAMS_MASK) >> PKT_STREAMS_SHIFT;
+    int i, free_processes = MAX_PROCESSES_NUMBER - get_processes(status);
+    struct free_p *port;
+    
+    if (streams < 1)
+        streams = 1;
+    if (number > 0 && (unsigned long long int) streams > number)
+        streams = (int) number;
+    if (streams > free_processes)
+        streams = free_processes;
+    for (i = 0; i < streams; ++i) {
+        //A port can be still in use by a worker that has just finished
+        if ((port = first_available_port(status)) == NULL)
+            break;
+        ports[i] = port->port;
+    }
+    return i;
+}
+
+
+/*  This function passes to the workers the streams of a GET or a PUT: each one
+ *  transfers its range of blocks of the file (see 'get_stream_range()' in
+ *  'utils.h') on its own port, and creates the response for the client: the
+ *  port of the first stream in 'dimension', the number of packets, the size
+ *  and the identity of the file, the first packet to transfer (only if the
+ *  transfer is resumed) and the ports of the other streams in 'data', and the
+ *  number of streams in the flags (see PKT_FLAG_RESUME and PKT_STREAMS_MASK in
+ *  'packet.h').
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - job:          The request ('port', 'first' and 'last' are set here)
+ *  - number:       Number of packets of the file
+ *  - size:         Size of the file in bytes
+ *  - identity:     Identity of the file (see 'checkpoint.h')
+ *  - first:        First packet to transfer (1, unless the transfer is resumed)
+ *  - streams:      Number of streams granted
+ *  - ports:        Ports reserved with 'reserve_streams()'
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         The response to send to the client
+ */
+struct packet *dispatch_streams(struct server_status *status, struct job *job, unsigned long long int number, unsigned long long int size,
+                                long long int identity, long long int first, int streams, int *ports, FILE *log) {
+    char data[MAX_BLOCK_SIZE];
+    struct packet *response;
+    size_t length;
+    int i;
+    
+    length = (size_t) snprintf(data, sizeof(data), "%llu %llu %lld", number, size, identity);
+    if (first > 1)
+        length += (size_t) snprintf(data + length, sizeof(data) - length, " %lld", first);
+    for (i = 0; i < streams; ++i) {
+        print_port_msg(log, status, verbose_mode, ports[i]);
+        job->port = ports[i];
+        get_stream_range(first, (long long int) number, streams, i, &job->first, &job->last);
+        dispatch_job(status, job, log);
+        if (i > 0)
+            length += (size_t) snprintf(data + length, sizeof(data) - length, " %d", ports[i]);
+    }
+    response = new_packet(PKT_ACK, 0, data, (size_t) ports[0]);
+    if (streams > 1)
+        response->flags = (unsigned int) (streams << PKT_STREAMS_SHIFT) & PKT_STREAMS_MASK;
+    if (first > 1)
+        response->flags |= PKT_FLAG_RESUME;
+    
+    return response;
+}
+
+
+/*  This function looks for a partial copy of a file received by a PUT that
+ *  died, with a checkpoint (see 'checkpoint.h'). The copy is resumed only if it
+ *  has the same number of packets, size and identity of the file that the
+ *  client sends. The file is then received into the copy with
+ *  'checkpoint_output()'.
+ *
+ *  Parameters:
+ *  - filename:     Name of the file sent by the client
+ *  - number:       Number of packets of the file
+ *  - size:         Size of the file in bytes
+ *  - identity:     Identity of the file
+ *
+ *  Return:         The first packet missing in the copy, or 1 if there is no
+ *                  copy to resume
+ */
+long long int resume_put(char *filename, unsigned long long int number, unsigned long long int size, long long int identity) {
+    unsigned long long int copy_number, copy_size;
+    long long int first, copy_identity;
+    char *copy = checkpoint_search(filename);
+    
+    if (copy == NULL)
+        return 1;
+    first = checkpoint_resume(copy, &copy_number, &copy_size, &copy_identity);
+    if (copy_number != number || copy_size != size || copy_identity != identity || first > (long long int) number)
+        first = 1;
+    free(copy);
+    return first;
+}
+
+
+/*  This function collects the terminated child processes, so they do not remain
+ *  zombies. A worker terminates only if it is killed during a transfer (for
+ *  example, for inactivity of the client): its port is released and a new
+ *  worker is created.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         Nothing
+ */
+void reap_processes(struct server_status *status, FILE *log) {
+    pid_t pid;
+    
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        process_terminated(status, pid);
+        if (WORKER_PROCESSES > 0)
+            start_worker(status, log);
+    }
+}
 
 
 int main(int argc, char *argv[]) {
@@ -70,27 +342,20 @@ int main(int argc, char *argv[]) {
     select_language(LANG_EN);
     
     //Input control begin
-    if (argc >= 2) {
-        if (strcmp(argv[1], "-l") == 0)     //Log service on
+    int i;
+    for (i = 1; i < argc && i < 4; ++i) {
+        if (strcmp(argv[i], "-l") == 0)     //Log service on
             log_file = 1;
-        else if (strcmp(argv[1], "-v") == 0)//Verbose mode on
+        else if (strcmp(argv[i], "-v") == 0)//Verbose mode on
             verbose_mode = 1;
+        else if (strcmp(argv[i], "-e") == 0)//Event-driven mode on
+            event_mode = 1;
         else {
-            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[1]);
+            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[i]);
             exit(EXIT_FAILURE);
         }
     }
-    if (argc == 3) {
-        if (strcmp(argv[2], "-l") == 0)     //Log service on
-            log_file = 1;
-        else if (strcmp(argv[2], "-v") == 0)//Verbose service on
-            verbose_mode = 1;
-        else {
-            fprintf(stderr, "%s: <%s>\n", _(STRING_COMMAND_NOT_FOUND), argv[2]);
-            exit(EXIT_FAILURE);
-        }
-    }
-    if (argc > 3 || argc < 1) {
+    if (argc > 4 || argc < 1) {
         fprintf(stderr, "%s\n", _(STRING_INSTRUCTION_SERVER));
         exit(EXIT_FAILURE);
     }
@@ -137,66 +402,76 @@ int main(int argc, char *argv[]) {
     //INADDR_ANY allows the server to receive packets destined to any of the interfaces
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
     addr.sin_port = htons(SERV_PORT);//Port in network byte order
+    //In event-driven mode, each event loop has a socket bound to SERV_PORT
+    int one = 1;
+    if (event_mode == 1 && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("setsockopt() in main()");
+        exit(EXIT_FAILURE);
+    }
     //Binding
     if(bind(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("bind() in main()");
         exit(EXIT_FAILURE);
     }
+    //Event-driven mode: it never returns
+    if (event_mode == 1)
+        event_server_run(sockfd, status, log, verbose_mode);
+    
+    //Create the workers
+    for (i = 0; i < WORKER_PROCESSES; ++i)
+        start_worker(status, log);
     
     int fd;
+    struct job job;
+    //Ports of the streams of a request, and number of streams granted
+    int ports[PKT_MAX_STREAMS];
+    int streams;
+    long long int first;
+    //Size and identity of the file of a GET or a PUT (see 'checkpoint.h')
+    unsigned long long int size;
+    long long int identity;
     //Infinite loop
     while (1) {
         len = sizeof(addr);
         
         print_waiting_msg(log, status);
         //Receive pkt
-        pkt = recv_pkt(sockfd, &addr, &len);
-
+        pkt = recv_pkt(sockfd, NULL, &addr, &len);
+        //Replace the workers killed in the meantime
+        reap_processes(status, log);
+        //Congestion control chosen by the client, used to send the file
+        job.cc = (pkt->flags & PKT_CC_MASK) >> PKT_CC_SHIFT;
+        job.type = pkt->type;
+        
         switch (pkt->type) {
             //PUT REQUEST RECEIVED
             case PKT_PUT:
+                //If the last PUT of the file died, only the packets missing are received
+                packet_get_file_info(pkt, &size, &identity);
+                first = resume_put(pkt->data, pkt->dimension, size, identity);
                 //If MAX_PROCESSES_NUMBER is reached, then refuse connection
                 if (get_processes(status) == MAX_PROCESSES_NUMBER) {
                     print_max_processes_msg(log, status);
                     response = new_packet(PKT_ERR, 0, _(STRING_SERVER_BUSY_ERR), 0);
                 }
                 //If MAX_PROCESS_NUMBER is not reached, accept connection
-                else {
+                else if ((streams = reserve_streams(status, pkt, pkt->dimension - (unsigned long long int) first + 1, ports)) > 0) {
                     print_request_accepted(log, status);
-                    //Select first free port available
-                    port = first_available_port(status);
-                    
-                    print_port_msg(log, status, verbose_mode, port->port);
-                    //Create new chil process
-                    pid_t pid = fork();
-                    if (pid < 0) {
-                        perror("fork() in main() [case PKT_PUT]");
-                        exit(EXIT_FAILURE);
-                    }
-                    //CHILD PROCESS WORK
-                    else if (pid == 0) {
-                        get_sem(status);
-                        //Set itself as unique user of this port
-                        port->user = getpid();
-                        int my_port = port->port;
-                        release_sem(status);
-                        //Prepare to receive the file
-                        receive_file(pkt->data, my_port, (long int) pkt->dimension,
-                                     LS_SERVER, NULL, 0, verbose_mode, status, log);
-                        //At the end, decrease number of active processes...
-                        decrease_processes(status);
-                        //...and free the port
-                        close_port(status, my_port);
-                        //exit (kill)
-                        _exit(0);
-                    }
-                    //FATHER PROCESS WORK
-                    else {
-                        //Increase the number of active process
-                        increase_processes(status);
-                        //Set response packet to begin operation
-                        response = new_packet(PKT_ACK, 0, NULL, (size_t)port->port);
-                    }
+                    //Choose the file (the partial copy, or a new name if the file
+                    //exists) and create it, so that all the streams write into it
+                    char *output = checkpoint_output(pkt->data, first);
+                    snprintf(job.filename, sizeof(job.filename), "%s", output);
+                    free(output);
+                    close_file(open_file(WRITE, job.filename));
+                    //The checkpoint of the file, where the workers save their progress
+                    checkpoint_delete(new_checkpoint(job.filename, pkt->dimension, size, identity, first, streams));
+                    //Pass the streams to the workers: they will receive the file.
+                    //The response contains the ports to begin operation
+                    response = dispatch_streams(status, &job, pkt->dimension, size, identity, first, streams, ports, log);
+                }
+                else {
+                    print_max_processes_msg(log, status);
+                    response = new_packet(PKT_ERR, 0, _(STRING_SERVER_BUSY_ERR), 0);
                 }
                 //Send response to the client
                 send_pkt(sockfd, response, addr);
@@ -205,6 +480,8 @@ int main(int argc, char *argv[]) {
                 break;
             //GET REQUEST RECEIVED
             case PKT_GET:
+                //The size and the identity of the partial copy of the client, if any
+                packet_get_file_info(pkt, &size, &identity);
                 //If MAX_PROCESSES_NUMBER is reached, then refuse connection
                 if (get_processes(status) == MAX_PROCESSES_NUMBER) {
                     print_max_processes_msg(log, status);
@@ -213,13 +490,12 @@ int main(int argc, char *argv[]) {
                 //If MAX_PROCESS_NUMBER is not reached, accept connection
                 else {
                     //Modify the filename to search inside the right directory
-                    char *filename = malloc((strlen(pkt->data) + strlen(DATA_DIR) + 2) * sizeof(char));
-                    if (snprintf(filename, (strlen(pkt->data) + strlen(DATA_DIR) + 2) * sizeof(char), "%s/%s", DATA_DIR, pkt->data) < 0) {
+                    if (snprintf(job.filename, sizeof(job.filename), "%s/%s", DATA_DIR, pkt->data) < 0) {
                         perror("snprintf() in main() [case PKT_GET]");
                         exit(EXIT_FAILURE);
                     }
                     //Try to open the file
-                    fd = open(filename, O_RDONLY);
+                    fd = open(job.filename, O_RDONLY);
                     //If file doesn't exists, send an error packet
                     if (fd == -1) {
                         print_file_not_found_msg(log, status, pkt->data);
@@ -227,42 +503,26 @@ int main(int argc, char *argv[]) {
                     }
                     //If file exists, prepare to send it
                     else {
-                        print_request_accepted(log, status);
+                        close_file(fd);
                         //Retrieve the number of pkts needed to send entirely the file
-                        long long int pkts = get_number(get_dimension(filename));
-                        //Select first free port available
-                        port = first_available_port(status);
-                        
-                        print_port_msg(log, status, verbose_mode, port->port);
-                        //Create chil process
-                        pid_t pid = fork();
-                        if (pid < 0) {
-                            perror("fork() in main() [case PKT_GET]");
-                            exit(EXIT_FAILURE);
-                        }
-                        //CHILD WORK
-                        else if (pid == 0) {
-                            get_sem(status);
-                            //Set itself as unique user of this port
-                            port->user = getpid();
-                            //Save the port in a local variable
-                            int my_port = port->port;
-                            release_sem(status);
-                            //Prepare to send the file
-                            send_file(my_port, NULL, 0, fd, filename, LS_SERVER, status, log, verbose_mode);
-                            //At the end, decrease the number of active processes
-                            decrease_processes(status);
-                            //Free used port
-                            close_port(status, my_port);
-                            //Exit (kill)
-                            _exit(0);
+                        unsigned long long int file_size = get_dimension(job.filename);
+                        unsigned long long int pkts = get_number(file_size);
+                        long long int file_identity = get_modification_time(job.filename);
+                        //If the client has a partial copy of the same file (same number
+                        //of packets, size and identity), send only the packets that it misses
+                        first = 1;
+                        if (pkt->seq > 1 && pkt->dimension == pkts && size == file_size && identity == file_identity &&
+                            (unsigned long long int) pkt->seq <= pkts)
+                            first = pkt->seq;
+                        if ((streams = reserve_streams(status, pkt, pkts - (unsigned long long int) first + 1, ports)) > 0) {
+                            print_request_accepted(log, status);
+                            //Pass the streams to the workers: they will send the file.
+                            //The response contains the ports to begin operation
+                            response = dispatch_streams(status, &job, pkts, file_size, file_identity, first, streams, ports, log);
                         }
-                        //FATHER WORK
                         else {
-                            //Increase the number of active process
-                            increase_processes(status);
-                            //Set response pkt to send to begin operation
-                            response = new_packet(PKT_ACK, 0, convert_llint(pkts), (size_t)port->port);
+                            print_max_processes_msg(log, status);
+                            response = new_packet(PKT_ERR, 0, _(STRING_SERVER_BUSY_ERR), 0);
                         }
                     }
                 }
@@ -288,40 +548,13 @@ int main(int argc, char *argv[]) {
                     char *list_file = create_list();
                     //Retrieve the number of pkts needed to send entirely the file
                     long long int pkts = get_number(get_dimension(list_file));
-                    //Create child process
-                    pid_t pid = fork();
-                    if (pid < 0) {
-                        perror("fork() in main() [case PKT_LS]");
-                        exit(EXIT_FAILURE);
-                    }
-                    //CHILD WORK
-                    else if (pid == 0) {
-                        get_sem(status);
-                        //Set itself as unique user of this port
-                        port->user = getpid();
-                        //Save the port in a local variable
-                        int my_port = port->port;
-                        release_sem(status);
-                        //Open the list file to send it
-                        int fd = open_file(READ, list_file);
-                        //Prepare to send the file
-                        send_file(my_port, NULL, 0, fd, list_file, LS_SERVER, status, log, verbose_mode);
-                        //At the end, remove the file from 'temp/' directory
-                        remove_list(list_file);
-                        //Decrease number of active process befor exit
-                        decrease_processes(status);
-                        //Close used port
-                        close_port(status, my_port);
-                        //Exit (kill)
-                        _exit(0);
-                    }
-                    //FATHER WORK
-                    else {
-                        //Increase the number of active process
-                        increase_processes(status);
-                        //Set the response packet
-                        response = new_packet(PKT_ACK, 0, convert_llint(pkts), (size_t)port->port);
-                    }
+                    //Pass the request to a worker: it will send the list file
+                    job.port = port->port;
+                    snprintf(job.filename, sizeof(job.filename), "%s", list_file);
+                    free(list_file);
+                    dispatch_job(status, &job, log);
+                    //Set the response packet
+                    response = new_packet(PKT_ACK, 0, convert_llint(pkts), (size_t)port->port);
                 }
                 //Send response to the client
                 send_pkt(sockfd, response, addr);
@@ -150,9 +150,12 @@ int server_status_init(struct server_status *status) {
     
     //At the beginning, there isn't any running process
     status->processes = 0;
+    //...and any request to serve
+    status->head = 0;
+    status->queued = 0;
     
-    //Initialize the unnamed semaphore
-    if (sem_init(&status->MTX, 1, 1) == -1) {
+    //Initialize the unnamed semaphores
+    if (sem_init(&status->MTX, 1, 1) == -1 || sem_init(&status->jobs, 1, 0) == -1) {
         perror("sem_init() in server_status_init()");
         exit(EXIT_FAILURE);
     }
@@ -176,6 +179,12 @@ struct server_status *create_shared_memory(void) {
     
     //Create a new shared memory area with the key 'key'.
     fd = shmget(key, sizeof(struct server_status), IPC_CREAT|0666);
+    //A zone left with the same key by an older release can be too small:
+    //remove it and create a new one
+    if (fd == -1 && errno == EINVAL && (fd = shmget(key, 0, 0)) != -1) {
+        shmctl(fd, IPC_RMID, NULL);
+        fd = shmget(key, sizeof(struct server_status), IPC_CREAT|0666);
+    }
     if(fd == -1) {
         perror("shmget() in create_shared_memory()");
         exit(EXIT_FAILURE);
@@ -183,10 +192,15 @@ struct server_status *create_shared_memory(void) {
     
     //Attach the shared memory zone at the process
     status = shmat(fd, NULL, 0);
-    if(status == NULL) {
+    if(status == (void *) -1) {
         perror("shmat() in create_shared_memory()");
         exit(EXIT_FAILURE);
     }
+    //The zone is removed when the server and all its processes are terminated
+    if (shmctl(fd, IPC_RMID, NULL) == -1) {
+        perror("shmctl() in create_shared_memory()");
+        exit(EXIT_FAILURE);
+    }
     
     //Initialize 'server_status' just created
     if (server_status_init(status) == 0)
@@ -242,3 +256,61 @@ void close_port1(struct server_status *status, pid_t pid) {
     release_sem(status);
 }
 
+
+void use_port(struct server_status *status, int port, pid_t pid) {
+    int i;
+    get_sem(status);
+    for (i=0; i<MAX_PROCESSES_NUMBER; ++i) {
+        if (status->v[i].port == port) {
+            status->v[i].user = pid;
+            break;
+        }
+    }
+    release_sem(status);
+}
+
+
+void process_terminated(struct server_status *status, pid_t pid) {
+    int i;
+    get_sem(status);
+    for (i=0; i<MAX_PROCESSES_NUMBER; ++i) {
+        if (status->v[i].used == 1 && status->v[i].user == pid) {
+            status->v[i].used = 0;
+            status->v[i].user = 0;
+            status->processes--;
+            break;
+        }
+    }
+    release_sem(status);
+}
+
+
+void push_job(struct server_status *status, struct job *job) {
+    get_sem(status);
+    status->queue[(status->head + status->queued) % MAX_PROCESSES_NUMBER] = *job;
+    status->queued++;
+    release_sem(status);
+    
+    //Wake up an idle worker
+    if (sem_post(&status->jobs) == -1) {
+        perror("sem_post() in push_job()");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void pop_job(struct server_status *status, struct job *job) {
+    //Wait for a request (a signal can interrupt the wait)
+    while (sem_wait(&status->jobs) == -1) {
+        if (errno != EINTR) {
+            perror("sem_wait() in pop_job()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    get_sem(status);
+    *job = status->queue[status->head];
+    status->head = (status->head + 1) % MAX_PROCESSES_NUMBER;
+    status->queued--;
+    release_sem(status);
+}
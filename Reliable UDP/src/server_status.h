@@ -36,6 +36,11 @@
 //  'free_p' with values ​​of available ports (see 'settings.h' and FIRST_AVAILABLE_PORT
 //  for details).
 //  All these functions are synchronized.
+//  When the server uses a pool of worker processes (see WORKER_PROCESSES in
+//  'settings.h'), 'server_status' contains also the queue of the requests
+//  accepted and not yet served: the main process pushes a 'job' for each request,
+//  and an idle worker pops it. The semaphore 'jobs' counts the queued requests,
+//  so the idle workers sleep on it.
 //  The client uses a fake 'server_status' structure. In fact, it has a 'server_status'
 //  variable that is setted to NULL.
 
@@ -66,6 +71,19 @@ struct free_p {
 };
 
 
+/*  'job' describes a request accepted by the main process, that a worker has to
+ *  serve (see 'push_job()' and 'pop_job()' below).
+ */
+struct job {
+    int type;                                       //PKT_GET, PKT_PUT or PKT_LS
+    int port;                                       //Port reserved for the transfer
+    int cc;                                         //Congestion control chosen by the client
+    long long int first;                            //GET and PUT: first packet of the range of the stream
+    long long int last;                             //GET and PUT: last packet of the range of the stream
+    char filename[MAX_BLOCK_SIZE + sizeof(DATA_DIR)];   //File to send or receive
+};
+
+
 /*  This data structure identifies the server status. Whit 'server_status', it is
  *  possibile to kwon how many processes are running on the server and how many
  *  ports are involved. In addition, using a zone of shared memory between processes,
@@ -77,6 +95,10 @@ struct server_status {
     struct free_p v[MAX_PROCESSES_NUMBER];  //Array of avaible ports
     int processes;                          //Number of processes currently in running
     sem_t MTX;                              //Semaphore to sync processes (server)
+    struct job queue[MAX_PROCESSES_NUMBER]; //Circular array of the requests to serve
+    int head;                               //Index: first request to serve
+    int queued;                             //Number of requests in 'queue'
+    sem_t jobs;                             //Counts the requests in 'queue'
 };
 
 
@@ -159,6 +181,56 @@ void close_port(struct server_status *status, int port);
 void close_port1(struct server_status *status, pid_t pid);
 
 
+/*  This function sets the process 'pid' as the user of the port 'port'.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - port:         port number to search into array
+ *  - pid:          Process ID of the user
+ *
+ *  Return:         Nothing
+ */
+void use_port(struct server_status *status, int port, pid_t pid);
+
+
+/*  This function is called when a process of the server 'pid' is terminated.
+ *  If it was still the user of a port, it was killed during a transfer: the
+ *  port is set as unused and the number of running processes is decreased.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - pid:          Process ID of the terminated process
+ *
+ *  Return:         Nothing
+ */
+void process_terminated(struct server_status *status, pid_t pid);
+
+
+/*  This function adds a request accepted into the queue of 'status', and wakes
+ *  up an idle worker. The queue cannot be full, because the requests accepted
+ *  and not ended are at most MAX_PROCESSES_NUMBER.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - job:          The request to serve (it is copied)
+ *
+ *  Return:         Nothing
+ */
+void push_job(struct server_status *status, struct job *job);
+
+
+/*  This function waits until there is a request in the queue of 'status', and
+ *  removes it from the queue.
+ *
+ *  Parameters:
+ *  - status:       Pointer to the 'server_status' data structure
+ *  - job:          Where the request is copied
+ *
+ *  Return:         Nothing
+ */
+void pop_job(struct server_status *status, struct job *job);
+
+
 /*  This function locks a semaphore to allow mutual exclusion
  *
  *  Parameters:
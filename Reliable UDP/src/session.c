@@ -0,0 +1,320 @@
+//
+//  session.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "session.h"
+
+
+/*  Allocate a session and initialize the fields common to both types */
+static struct session *alloc_session(int type, int sockfd, struct sockaddr_in addr, unsigned int conn,
+                                     struct server_status *status, FILE *log, int verbose) {
+    struct session *s;
+    
+    s = malloc(sizeof(struct session));
+    if (s == NULL) {
+        fprintf(stderr, "Error in new_session(): cannot allocate memory for session\n");
+        exit(EXIT_FAILURE);
+    }
+    memset((void *)s, 0, sizeof(struct session));
+    
+    s->type = type;
+    s->state = SESSION_DATA;
+    s->conn = conn;
+    s->sockfd = sockfd;
+    s->addr = addr;
+    s->fd = -1;
+    s->status = status;
+    s->log = log;
+    s->verbose = verbose;
+    s->next = NULL;
+    s->hnext = NULL;
+    s->last_activity = get_monotonic_usec();
+    
+    //Fields of 'thread_data' used by 'sender_handle_pkt()' and for the messages
+    s->data.sockfd = s->sockfd;
+    s->data.addr = s->addr;
+    s->data.output = -1;
+    s->data.stop_err = &s->stop_err;
+    s->data.status = status;
+    s->data.log = log;
+    s->data.verbose = verbose;
+    s->data.user = LS_SERVER;
+    s->data.received = 0;
+    s->data.last_percentage = 0;
+    
+    s->timer = new_timer();
+    set_timer(s->timer, TIMER_START);
+    
+    return s;
+}
+
+struct session *new_send_session(int sockfd, struct sockaddr_in addr, unsigned int conn, int fd,
+                                 unsigned long long int size, int cc, const char *type,
+                                 struct server_status *status, FILE *log, int verbose) {
+    struct session *s = alloc_session(SESSION_SEND, sockfd, addr, conn, status, log, verbose);
+    
+    s->fd = fd;
+    s->src = new_file_source(fd, size);
+    s->size = size;
+    s->seq = 1;
+    /*  The 'time_controller' has no thread: its timers are checked by
+     *  'session_run()' with 'time_controller_expire()', so 'wc' is set here.
+     */
+    s->tc = new_time_controller(WINDOW_DIMENSION, log, LS_SERVER, status);
+    s->pool = new_packet_pool(WINDOW_DIMENSION + 2 * IO_BATCH_SIZE);
+    s->wc = new_window_controller(WINDOW_DIMENSION, s->tc, s->sockfd, s->addr, -1, s->pool, cc);
+    s->tc->wc = s->wc;
+    s->wc->conn = conn;
+    
+    s->data.tc = s->tc;
+    s->data.wc = s->wc;
+    s->data.number = get_number(size);
+    
+    print_operation_started_msg(log, status, LS_SERVER, type);
+    
+    return s;
+}
+
+struct session *new_recv_session(int sockfd, struct sockaddr_in addr, unsigned int conn, char *filename,
+                                 long long int number, struct server_status *status, FILE *log, int verbose) {
+    struct session *s = alloc_session(SESSION_RECV, sockfd, addr, conn, status, log, verbose);
+    
+    //Search if the file name already exists
+    char *output = search_file(filename);
+    s->fd = open_file(WRITE, output);
+    free(output);
+    allocate_file(s->fd, number);
+    s->min = 1;
+    s->ack = new_packet(PKT_ACK, 0, NULL, 0);
+    s->ack->conn = conn;
+    s->nack = new_packet(PKT_NACK, 0, NULL, 0);
+    s->nack->conn = conn;
+    s->ack_pending = 0;
+    //The packets are written as soon as they are received: the pool contains
+    //only the one just received
+    s->pool = new_packet_pool(1);
+    s->wc = new_window_controller(WINDOW_DIMENSION, NULL, s->sockfd, s->addr, s->fd, s->pool, CC_NONE);
+    
+    s->data.wc = s->wc;
+    s->data.output = s->fd;
+    s->data.number = number;
+    
+    print_operation_started_msg(log, status, LS_SERVER, "PUT");
+    print_pkt_to_receive(log, status, LS_SERVER, number);
+    
+    return s;
+}
+
+
+/*  Handle a packet received by a session that receives a file */
+static void recv_session_pkt(struct session *s, struct packet *pkt) {
+    int percentage;
+    
+    print_pkt_arrived_msg(s->status, LS_SERVER, s->verbose, pkt->seq);
+    
+    if (pkt->type == PKT_FIN) {
+        print_fin_arrived_msg(s->status, LS_SERVER, s->verbose);
+        s->ack->type = PKT_FINACK;
+        s->ack->flags = 0;
+        s->ack->seq = pkt->seq;
+        send_pkt(s->sockfd, s->ack, s->addr);
+        s->state = SESSION_DONE;
+    }
+    else if (pkt->type == PKT_ERR) {
+        print_err_arrived_msg(s->log, s->status, LS_SERVER, pkt->data);
+        s->state = SESSION_FAILED;
+    }
+    else if (pkt->type == PKT_DATA) {
+        s->ack_pending = 1;
+        s->ack->seq = pkt->seq;
+        //A packet beyond the window is discarded: the sender will send it again
+        if (window_controller_is_received(s->wc, pkt->seq) == 0 &&
+            window_controller_in_window(s->wc, pkt->seq) == 1) {
+            //From now on, the window owns the packet
+            window_controller_add_packet(s->wc, pkt);
+            pkt = NULL;
+            s->min = window_controller_advance(s->wc);
+            
+            s->data.received++;
+            percentage = 100 * (int)s->data.received / (int)s->data.number;
+            if (percentage / 10 != s->data.last_percentage / 10) {
+                print_completition_msg(s->log, s->status, LS_SERVER, percentage / 10 * 10);
+                s->data.last_percentage = percentage;
+            }
+        }
+        //Request again the holes opened by a packet out of order at once
+        if (window_controller_fill_nack(s->wc, s->nack) > 0)
+            send_pkt(s->sockfd, s->nack, s->addr);
+    }
+    packet_pool_put(s->pool, pkt);
+}
+
+void session_recv_pkt(struct session *s, struct packet *pkt) {
+    struct packet *copy;
+    
+    //The packets received after the end of the transfer are discarded.
+    //The receiver simulates the loss probability
+    if (session_is_over(s) == 1 || (s->type == SESSION_RECV && is_accepted() == 0))
+        return;
+    s->last_activity = get_monotonic_usec();
+    
+    //The window keeps the packet, so it must belong to the pool of the session
+    copy = packet_pool_get(s->pool);
+    packet_copy(copy, pkt);
+    
+    if (s->type == SESSION_RECV)
+        recv_session_pkt(s, copy);
+    else if (sender_handle_pkt(&s->data, copy) == 1)
+        s->state = s->stop_err == 0 ? SESSION_DONE : SESSION_FAILED;
+}
+
+
+/*  Read from the file and send the packets allowed by the window and the 'pacer' */
+static void send_session_data(struct session *s) {
+    struct packet *batch[IO_BATCH_SIZE];
+    struct packet *pkt;
+    size_t dimension;
+    int k, n;
+    
+    while (s->size > 0 && (k = window_controller_can_send(s->wc)) > 0) {
+        if (k > IO_BATCH_SIZE)
+            k = IO_BATCH_SIZE;
+        for (n = 0; n < k && s->size > 0; ++n) {
+            pkt = packet_pool_new_packet(s->pool, PKT_DATA, s->seq, NULL, 0);
+            dimension = file_source_fill(s->src, pkt);
+            print_pkt_sent_msg(s->status, LS_SERVER, s->verbose, s->seq);
+            batch[n] = pkt;
+            s->seq++;
+            s->size -= dimension;
+        }
+        //'k' packets can be sent without waiting
+        window_controller_add_packets(s->wc, batch, n);
+    }
+    
+    if (s->size == 0)
+        s->state = SESSION_DRAIN;
+}
+
+void session_run(struct session *s) {
+    struct packet *fin;
+    
+    if (session_is_over(s) == 1)
+        return;
+    
+    //A cumulative and selective ACK for all the packets of the last batch
+    if (s->type == SESSION_RECV && s->ack_pending == 1) {
+        s->ack->type = PKT_ACK;
+        window_controller_fill_sack(s->wc, s->ack, s->min);
+        send_pkt(s->sockfd, s->ack, s->addr);
+        s->ack_pending = 0;
+    }
+    
+    if (s->type == SESSION_SEND) {
+        //Resend the packets whose timeout has expired
+        if (time_controller_expire(s->tc) == 1) {
+            fprintf(stderr, "Generic error: lost connection or line too busy\n");
+            s->state = SESSION_FAILED;
+            return;
+        }
+        if (s->state == SESSION_DATA)
+            send_session_data(s);
+        //Send PKT_FIN when all the packets are acked
+        if (s->state == SESSION_DRAIN && window_controller_is_empty(s->wc) == 1 &&
+            window_controller_can_send(s->wc) > 0) {
+            fin = packet_pool_new_packet(s->pool, PKT_FIN, s->seq, NULL, 0);
+            window_controller_add_packet(s->wc, fin);
+            s->state = SESSION_FIN;
+        }
+    }
+    
+    //Inactivity of the other process
+    if (get_monotonic_usec() - s->last_activity >= (long long int) MAX_INACTIVITY_TIME * 1000000) {
+        print_interrupted_operation_msg(s->log, s->status, LS_SERVER);
+        s->state = SESSION_FAILED;
+    }
+}
+
+long long int session_next_deadline(struct session *s) {
+    long long int deadline, t;
+    
+    deadline = s->last_activity + (long long int) MAX_INACTIVITY_TIME * 1000000;
+    if (s->type == SESSION_RECV)
+        return deadline;
+    
+    //Next timeout of a packet
+    t = time_controller_next_expiry(s->tc);
+    if (t >= 0 && t < deadline)
+        deadline = t;
+    //Next packet allowed by the 'pacer'
+    if (s->state == SESSION_DATA || (s->state == SESSION_DRAIN && window_controller_is_empty(s->wc) == 1)) {
+        t = window_controller_send_delay(s->wc);
+        if (t >= 0 && get_monotonic_usec() + t < deadline)
+            deadline = get_monotonic_usec() + t;
+    }
+    
+    return deadline;
+}
+
+int session_is_over(struct session *s) {
+    if (s->state == SESSION_DONE || s->state == SESSION_FAILED)
+        return 1;
+    else
+        return 0;
+}
+
+void session_delete(struct session *s) {
+    set_timer(s->timer, TIMER_LAP);
+    
+    //Final report
+    if (s->state == SESSION_DONE) {
+        get_sem(s->status);
+        printf("%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %lld\n\n",
+               get_current_time(), _(STRING_CHILD), getpid(), _(STRING_OPERATION_COMPLETED),
+               _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(s->timer),
+               s->type == SESSION_SEND ? _(STRING_TOTAL_PKTS_SEND) : _(STRING_TOTAL_PKTS_RECEIVED),
+               s->type == SESSION_SEND ? s->seq - 1 : s->data.received);
+        if (s->log)
+            fprintf(s->log, "%s %s (%4d): %s\n\t   %s: %8f s.\n\t   %s: %lld\n\n",
+                    get_current_time(), _(STRING_CHILD), getpid(), _(STRING_OPERATION_COMPLETED),
+                    _(STRING_TOTAL_TIME_ELAPSED), get_total_time_catched(s->timer),
+                    s->type == SESSION_SEND ? _(STRING_TOTAL_PKTS_SEND) : _(STRING_TOTAL_PKTS_RECEIVED),
+                    s->type == SESSION_SEND ? s->seq - 1 : s->data.received);
+        fflush(stdout);
+        if (s->log)
+            fflush(s->log);
+        release_sem(s->status);
+    }
+    
+    close_file(s->fd);              //close the file sent or written
+    window_controller_dispose(s->wc);
+    //The file is unmapped only when no packet of the window refers to it
+    if (s->src != NULL)
+        file_source_delete(s->src);
+    if (s->tc != NULL)
+        time_controller_dispose(s->tc);
+    packet_pool_delete(s->pool);
+    free(s->ack);
+    free(s->nack);
+    free(s->timer);
+    free(s);
+}
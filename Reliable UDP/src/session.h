@@ -0,0 +1,190 @@
+//
+//  session.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the 'session' data structure, used by the event
+//  server (see 'event_server.h') to manage a transfer without processes or threads.
+//  'send_file()' and 'receive_file()' are blocking loops, with a thread for the
+//  ACKs and a thread for the timeouts. A 'session' contains the same data (the
+//  'window_controller', the 'time_controller', the 'packet_pool'), but it is a
+//  state machine moved forward by an event loop:
+//  - 'session_recv_pkt()' for each packet with the connection ID of the session
+//  - 'session_run()' after a batch of packets, and when its deadline
+//    ('session_next_deadline()') is reached
+//  Both functions never block: the socket of the loop is non-blocking, the
+//  packets are sent only when the window and the 'pacer' allow it
+//  ('window_controller_can_send()'), and the timeouts are checked with
+//  'time_controller_expire()'. The socket is shared by all the sessions of the
+//  loop, so it is never closed by a session.
+//
+//  A session that sends a file (GET and LS requests) goes through the states:
+//
+//  SESSION_DATA:   the packets of the file are read and sent
+//  SESSION_DRAIN:  the whole file was sent: wait until all the packets are acked
+//  SESSION_FIN:    PKT_FIN was sent: wait for PKT_FINACK
+//  SESSION_DONE:   the transfer is over
+//
+//  A session that receives a file (PUT requests) stays in SESSION_DATA until
+//  PKT_FIN arrives. A session that fails (lost connection, PKT_ERR, inactivity
+//  for more than MAX_INACTIVITY_TIME) goes in SESSION_FAILED.
+//  The wire protocol is the same of 'send_file()' and 'receive_file()', with
+//  the connection ID of the session in every packet.
+
+
+#ifndef __Reliable_UDP__session__
+#define __Reliable_UDP__session__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+
+#include "settings.h"
+#include "utils.h"
+#include "window_controller.h"
+#include "time_controller.h"
+#include "packet_pool.h"
+#include "put.h"
+#include "print_messages.h"
+#include "timer.h"
+
+
+enum session_type {SESSION_SEND, SESSION_RECV};
+enum session_state {SESSION_DATA, SESSION_DRAIN, SESSION_FIN, SESSION_DONE, SESSION_FAILED};
+
+
+struct session {
+    int type;                       //SESSION_SEND or SESSION_RECV
+    int state;                      //Current state (see 'session_state')
+    unsigned int conn;              //Connection ID of the transfer
+    int sockfd;                     //Non-blocking socket of the event loop
+    int fd;                         //File sent or written
+    struct file_source *src;        //Sender: blocks of the file to send (see 'file_source.h')
+    struct sockaddr_in addr;        //Address of the other process
+    struct packet_pool *pool;       //Packets of the session
+    struct window_controller *wc;   //Sliding window
+    struct time_controller *tc;     //Timers of the packets sent (without thread, NULL to receive)
+    struct thread_data data;        //Packets acked or received, for the messages (see 'sender_handle_pkt()')
+    int stop_err;                   //Set by 'sender_handle_pkt()' in case of error
+    unsigned long long int size;    //Bytes of the file not yet sent
+    long long int seq;              //Sender: next sequence number to send
+    long long int min;              //Receiver: next sequence number to write
+    struct packet *ack;             //Receiver: ACK prepared to be sent
+    struct packet *nack;            //Receiver: PKT_NACK prepared to be sent
+    int ack_pending;                //Receiver: 1 if the ACK has to be sent by 'session_run()'
+    long long int last_activity;    //Last packet received (usecs of CLOCK_MONOTONIC)
+    struct timer *timer;            //To calculate the completion time
+    struct server_status *status;   //To print messages
+    FILE *log;                      //Log file (can be NULL)
+    int verbose;                    //1 if verbose mode is on
+    struct session *next;           //Next session of the same event loop
+    struct session *hnext;          //Next session in the same bucket of the hash table of the loop
+};
+
+
+/*  This function creates a session that sends a file (GET and LS requests).
+ *
+ *  Parameters:
+ *  - sockfd:       The socket of the event loop
+ *  - addr:         Address of the client
+ *  - conn:         Connection ID of the transfer
+ *  - fd:           The file to send, already opened (it is closed by 'session_delete()')
+ *  - size:         Size of the file in bytes
+ *  - cc:           The congestion control algorithm (see 'congestion_control.h')
+ *  - type:         Name of the operation, for the messages ("GET" or "LIST")
+ *  - status:       Pointer to 'server_status', to print messages
+ *  - log:          Log file (can be NULL)
+ *  - verbose:      1 if verbose mode is on
+ *
+ *  Return:         Pointer to the new session
+ */
+struct session *new_send_session(int sockfd, struct sockaddr_in addr, unsigned int conn, int fd, unsigned long long int size, int cc, const char *type,
+                                 struct server_status *status, FILE *log, int verbose);
+
+
+/*  This function creates a session that receives a file (PUT requests).
+ *
+ *  Parameters:
+ *  - sockfd:       The socket of the event loop
+ *  - addr:         Address of the client
+ *  - conn:         Connection ID of the transfer
+ *  - filename:     Name of the file (if it exists, a new name is chosen with 'search_file()')
+ *  - number:       Number of packets of the file
+ *  - status:       Pointer to 'server_status', to print messages
+ *  - log:          Log file (can be NULL)
+ *  - verbose:      1 if verbose mode is on
+ *
+ *  Return:         Pointer to the new session
+ */
+struct session *new_recv_session(int sockfd, struct sockaddr_in addr, unsigned int conn, char *filename, long long int number,
+                                 struct server_status *status, FILE *log, int verbose);
+
+
+/*  This function handles a packet received with the connection ID of a session.
+ *  The packet is copied into the 'packet_pool' of the session, so it remains
+ *  to the caller. The ACK of the packets received is sent by 'session_run()',
+ *  once for each batch.
+ *
+ *  Parameters:
+ *  - s:            Pointer to the session
+ *  - pkt:          The packet received
+ *
+ *  Return:         Nothing
+ */
+void session_recv_pkt(struct session *s, struct packet *pkt);
+
+
+/*  This function moves a session forward: it resends the packets whose timeout
+ *  has expired, sends the new packets allowed by the window and the 'pacer',
+ *  sends the ACK of the packets received, and checks the inactivity time.
+ *
+ *  Parameters:
+ *  - s:            Pointer to the session
+ *
+ *  Return:         Nothing
+ */
+void session_run(struct session *s);
+
+
+/*  This function returns when 'session_run()' has to be called again, if no
+ *  datagram arrives before.
+ *
+ *  Parameters:
+ *  - s:            Pointer to the session
+ *
+ *  Return:         The deadline in usecs of CLOCK_MONOTONIC (see 'get_monotonic_usec()')
+ */
+long long int session_next_deadline(struct session *s);
+
+
+/*  This function checks if a session is over (SESSION_DONE or SESSION_FAILED) */
+int session_is_over(struct session *s);
+
+
+/*  This function closes the file of a session and frees all its memory */
+void session_delete(struct session *s);
+
+
+#endif /* defined(__Reliable_UDP__session__) */
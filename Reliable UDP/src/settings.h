@@ -36,19 +36,40 @@
 //  MAX_BLOCK_SIZE                  1024
 //  DEFAULT_TIMEOUT_USEC            3000
 //  DEFAULT_TIMEOUT_SEC             0
+//  RTO_MIN_USEC                    200
+//  RTO_MAX_USEC                    60000000
 //  MAX_RETRIES_SENDING_PKT         15
 //  WINDOW_DIMENSION                31
-//  TIME_CONTROLLER_GRANULARITY     500
+//  TIMER_WHEEL_RESOLUTION          100
+//  DELAYED_ACK_PKTS                2
+//  DELAYED_ACK_USEC                500
+//  DUPACK_THRESHOLD                3
+//  NACK_INTERVAL_USEC              1000
+//  NACK_MAX_REPEATS                3
+//  IO_BATCH_SIZE                   16
+//  SENDER_RING_SIZE                64
+//  FILE_SOURCE_MMAP                1
+//  IO_URING                        0
+//  CONGESTION_CONTROL              CC_CUBIC
+//  PACING_MAX_BURST                8
+//  PACING_MAX_RATE                 0
+//  TRANSFER_STREAMS                1
 //  SERV_PORT                       5593
 //  MAX_OP_STRING_SIZE              256
 //  LOSS_PROBABILITY                0
 //  MAX_PROCESSES_NUMBER            10
+//  WORKER_PROCESSES                MAX_PROCESSES_NUMBER
+//  EVENT_LOOPS                     0
+//  EVENT_MAX_SESSIONS              1024
+//  EVENT_SOCKET_BUFFER             4194304
 //  DEFAULT_MSG_DETAIL              DETAIL_MEDIUM
 //  SERVER_LOG_FILE_PATH            "LOG.txt"
 //  DATA_DIR                        "data"
 //  LIST_FILE                       "server_list.txt"
 //  FIRST_AVAILABLE_PORT            5594
 //  MAX_INACTIVITY_TIME             60
+//  CHECKPOINT_INTERVAL             1024
+//  CHECKPOINT_SUFFIX               ".part"
 
 
 
@@ -78,6 +99,18 @@
 #define DEFAULT_TIMEOUT_USEC            3000
 #define DEFAULT_TIMEOUT_SEC             0
 
+/*  RTO_MIN_USEC and RTO_MAX_USEC are the limits of the timeout of a packet
+ *  (in usecs), calculated from the RTT (see 'rto.h') or doubled when its timer
+ *  expires.
+ *
+ *  WARNING:
+ *  RFC 6298 suggests a minimum of 1 sec for the Internet: in a local network it
+ *  would stop the transfer for a long time at each loss. A too low value can
+ *  cause useless retransmissions when the RTT changes quickly.
+ */
+#define RTO_MIN_USEC                    200
+#define RTO_MAX_USEC                    60000000
+
 /*  MAX_RETRIES_SENDING_PKT identifies the maximum number of attempts to send a 
  *  single packet. When attempts reaches this value, the connection between client 
  *  and server is interrupted because it is believed that the line may be too busy 
@@ -100,25 +133,183 @@
  *  If the value of this macro is set to 2, you will have a stop-and-wait protocol.
  *  A too high value can lead to an incorrect use of the bandwidth, while a value 
  *  too small can slow down the operations of sending and receiving a file.
- *  Do not set the value to below 1.
+ *  Do not set the value to below 1. Each ACK carries a bitmap of one bit for
+ *  each slot of the window, so the value can not be greater than
+ *  8 * (MAX_BLOCK_SIZE - 8).
  */
 #define WINDOW_DIMENSION                31
 
-/*  TIME_CONTROLLER_GRANULARITY defines the time interval (in msecs) in which the 
- *  thread sleeps before checking all timers in the 'timer_wheel'.
+/*  TIMER_WHEEL_RESOLUTION defines the duration (in usecs) of a tick of the
+ *  'timer_wheel'. Each timeout is rounded up to a whole number of ticks.
+ *
+ *  WARNING:
+ *  A larger value makes the timeouts less accurate. The 'timer_wheel' can
+ *  contain timeouts up to 2^32 ticks: do not set the value below 1.
+ */
+#define TIMER_WHEEL_RESOLUTION          100
+
+/*  DELAYED_ACK_PKTS and DELAYED_ACK_USEC define the delayed ACKs of the
+ *  receiving process: a packet received in order is acked together with the
+ *  following ones, when DELAYED_ACK_PKTS packets are waiting for the ACK or
+ *  DELAYED_ACK_USEC usecs have elapsed since the first of them, whichever
+ *  comes first. Duplicates, packets out of order and packets that fill a gap
+ *  are always acked immediately.
+ *
+ *  WARNING:
+ *  Set DELAYED_ACK_PKTS to 1 to ack each packet as soon as it arrives. A too
+ *  high value of DELAYED_ACK_USEC can delay the ACK beyond the timeout of the
+ *  sender, causing useless retransmissions.
+ */
+#define DELAYED_ACK_PKTS                2
+#define DELAYED_ACK_USEC                500
+
+/*  DUPACK_THRESHOLD defines when the sending process considers a packet lost
+ *  before its timeout (fast retransmit): when DUPACK_THRESHOLD ACKs in a row
+ *  do not move the cumulative ACK, or when DUPACK_THRESHOLD packets sent after
+ *  it were selectively acked.
+ *
+ *  WARNING:
+ *  A too low value causes useless retransmissions when the packets are only
+ *  reordered by the network. Do not set the value below 1.
+ */
+#define DUPACK_THRESHOLD                3
+
+/*  NACK_INTERVAL_USEC and NACK_MAX_REPEATS are used by the receiving process to
+ *  request the packets missing with a PKT_NACK (see 'window_controller_fill_nack()'
+ *  in 'window_controller.h'). A hole is requested as soon as a packet received
+ *  out of order opens it. While the holes remain, the PKT_NACK is repeated with
+ *  the next packets received, at most every NACK_INTERVAL_USEC usecs and at
+ *  most NACK_MAX_REPEATS times for the same first packet missing.
+ *
+ *  WARNING:
+ *  The sender sends a packet again at most once for each smoothed RTT, so a
+ *  PKT_NACK repeated too early is useless. Set NACK_MAX_REPEATS to 0 to
+ *  request each hole only once.
+ */
+#define NACK_INTERVAL_USEC              1000
+#define NACK_MAX_REPEATS                3
+
+/*  IO_BATCH_SIZE defines the maximum number of datagrams sent with a single
+ *  'sendmmsg()' or received with a single 'recvmmsg()' (see 'send_pkts()' and
+ *  'recv_pkts()' in 'utils.h').
+ *
+ *  WARNING:
+ *  Each batch received uses IO_BATCH_SIZE * (PKT_HEADER_SIZE + MAX_BLOCK_SIZE)
+ *  bytes of stack (see PKT_MAX_WIRE_SIZE in 'packet.h').
+ *  Do not set the value below 1.
+ */
+#define IO_BATCH_SIZE                   16
+
+/*  SENDER_RING_SIZE defines how many packets the thread of the sending process
+ *  that reads the file can prepare in advance, before they are added into the
+ *  sliding window (see 'send_file()' in 'put.c').
+ */
+#define SENDER_RING_SIZE                64
+
+/*  FILE_SOURCE_MMAP defines how the sending process reads the file to send (see
+ *  'file_source.h'): if 1, the file is mapped in memory, and the packets are
+ *  sent directly from its pages; if 0, or if the file can not be mapped, each
+ *  block is read with 'read()' into the 'data' field of a packet.
+ *
+ *  WARNING:
+ *  If a file mapped in memory is truncated while it is sent, the sending process
+ *  is killed by SIGBUS.
+ */
+#define FILE_SOURCE_MMAP                1
+
+/*  IO_URING defines how the receiving process writes the blocks of the file
+ *  (see 'io_engine.h'). If it is 1, the writes of a batch of packets are
+ *  submitted together to an io_uring and completed by the kernel while the
+ *  next batch is received; if it is 0, each block is written with 'pwrite()'.
+ *  If the kernel does not allow io_uring, 'pwrite()' is used anyway.
+ *
+ *  WARNING:
+ *  When the file system can not complete a buffered write without blocking,
+ *  the kernel hands it to a worker thread. This pays off only if the worker
+ *  can run on another CPU: on a single CPU, it is slower than 'pwrite()'.
+ */
+#define IO_URING                        0
+
+/*  CONGESTION_CONTROL defines the congestion control algorithm used by the
+ *  sending process when the client does not choose one (see 'congestion_control.h'):
+ *  CC_NONE, CC_RENO or CC_CUBIC. The client sends its choice to the server with
+ *  each request, so the server uses the same algorithm to send a file.
  *
  *  WARNING:
- *  A smaller value will lead to increased use of the CPU , but also at a more 
- *  accurate control of timeouts. A larger value will decrease the use of the CPU, 
- *  but the control of timeouts will be less accurate
+ *  With CC_NONE the whole window is sent at once, as fast as possible, even if
+ *  the network is losing packets.
  */
-#define TIME_CONTROLLER_GRANULARITY     500
+#define CONGESTION_CONTROL              CC_CUBIC
+
+/*  PACING_MAX_BURST and PACING_MAX_RATE define the pacing of the sending process
+ *  (see 'pacer.h'). The packets are sent at a rate that spreads the congestion
+ *  window over a RTT, with at most PACING_MAX_BURST packets sent together.
+ *  PACING_MAX_RATE is the maximum rate (in packets per second): 0 means that
+ *  the rate is limited only by the congestion window.
+ *
+ *  WARNING:
+ *  A small value of PACING_MAX_BURST avoids the losses in the queues of the
+ *  network, but the sender wakes up more often. Do not set it below 1.
+ */
+#define PACING_MAX_BURST                8
+#define PACING_MAX_RATE                 0
+
+/*  TRANSFER_STREAMS defines in how many streams the client asks to split each
+ *  GET and PUT. Each stream transfers a contiguous range of blocks of the file
+ *  on its own port, with its own socket, sliding window and threads, and the
+ *  receiver writes the blocks of all the streams into the same file (see
+ *  'streams.h'). The server can grant less streams than requested: at most
+ *  one for each packet of the file, and one for each free process. The event
+ *  server (option '-e') always grants a single stream.
+ *
+ *  WARNING:
+ *  Parallel streams help only when a single sliding window can not fill the
+ *  link (high bandwidth-delay product). Each stream takes a process of the
+ *  server (see MAX_PROCESSES_NUMBER below). The value must be between 1 and 15.
+ */
+#define TRANSFER_STREAMS                1
+
+#if TRANSFER_STREAMS < 1 || TRANSFER_STREAMS > 15
+#error "TRANSFER_STREAMS must be between 1 and 15"
+#endif
 
 /*  MAX_PROCESSES_NUMBER identifies the max number of connection that the server
  *  can manage.
  */
 #define MAX_PROCESSES_NUMBER            10
 
+/*  WORKER_PROCESSES defines the number of worker processes created by the server
+ *  at startup. The workers take the accepted requests from a queue in the shared
+ *  memory (see 'server_status.h'), and each worker serves a transfer at a time,
+ *  so no process is created on the arrival of a request. 0 means that a new
+ *  process is created for each request.
+ *
+ *  WARNING:
+ *  At most MAX_PROCESSES_NUMBER requests are served at the same time, so more
+ *  workers are useless.
+ */
+#define WORKER_PROCESSES                MAX_PROCESSES_NUMBER
+
+#if WORKER_PROCESSES > MAX_PROCESSES_NUMBER
+#error "WORKER_PROCESSES cannot be greater than MAX_PROCESSES_NUMBER"
+#endif
+
+/*  EVENT_LOOPS and EVENT_MAX_SESSIONS are used only by the event-driven mode of
+ *  the server (option '-e', see 'event_server.h'). EVENT_LOOPS is the number of
+ *  threads with an event loop: 0 means one for each core. EVENT_MAX_SESSIONS is
+ *  the max number of transfers at the same time. All the transfers of a loop
+ *  share its socket, so EVENT_SOCKET_BUFFER (in bytes) sets the size of its
+ *  receive and send buffers.
+ *
+ *  WARNING:
+ *  The kernel limits EVENT_SOCKET_BUFFER to 'net.core.rmem_max' and
+ *  'net.core.wmem_max'. With small buffers, the requests can be lost when
+ *  many transfers are running.
+ */
+#define EVENT_LOOPS                     0
+#define EVENT_MAX_SESSIONS              1024
+#define EVENT_SOCKET_BUFFER             4194304
+
 /*  SERV_PORT identifies the server communication port.
  *
  *  WARNING:
@@ -179,4 +370,23 @@
  */
 #define MAX_INACTIVITY_TIME             60 //in secs
 
+/*  CHECKPOINT_INTERVAL defines every how many packets written the receiving
+ *  process saves its progress in the checkpoint of the file (see
+ *  'checkpoint.h'). If a transfer dies, the next GET or PUT of the same file
+ *  resumes it from the first block missing, instead of starting again from
+ *  the beginning. With a single stream (see TRANSFER_STREAMS), at most
+ *  CHECKPOINT_INTERVAL packets are received again; with more streams, the
+ *  transfer resumes from the first block missing in the first range not
+ *  complete, so the blocks already written in the following ranges are
+ *  received again too.
+ *  0 disables the checkpoints, and every transfer starts from the beginning.
+ */
+#define CHECKPOINT_INTERVAL             1024
+
+/*  CHECKPOINT_SUFFIX is appended to the name of a file being received to get
+ *  the name of its checkpoint. The checkpoint is a hidden file (its name starts
+ *  with '.') in the same directory, so it is not shown by LIST.
+ */
+#define CHECKPOINT_SUFFIX               ".part"
+
 #endif
@@ -0,0 +1,134 @@
+//
+//  streams.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+
+
+#include "streams.h"
+
+
+/*  This function is the work of the thread of a stream that receives a range */
+static void *receive_stream(void *arg) {
+    struct stream *st = (struct stream *) arg;
+    
+    //The stream has its own port, so it creates its own socket
+    receive_range(st->fd, st->first, st->last, st->port, LS_CLIENT, st->ip, -1, st->verbose, NULL, st->log, 0, "GET", st->cp);
+    return NULL;
+}
+
+/*  This function is the work of the thread of a stream that sends a range */
+static void *send_stream(void *arg) {
+    struct stream *st = (struct stream *) arg;
+    int fd;
+    
+    //Each stream reads the file on its own, from the first block of its range
+    fd = open_file(READ, st->filename);
+    send_range(st->port, st->ip, -1, fd, st->size, st->first, st->last, LS_CLIENT, NULL, st->log, st->verbose, st->cc, 0);
+    close_file(fd);
+    return NULL;
+}
+
+/*  Start a thread for each stream, and wait until all of them are over */
+static void run_streams(struct stream *st, int streams, void *(*work)(void *)) {
+    int i;
+    
+    for (i = 0; i < streams; ++i) {
+        if (pthread_create(&st[i].thread, NULL, work, &st[i]) != 0) {
+            perror("pthread_create() in run_streams()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < streams; ++i) {
+        if (pthread_join(st[i].thread, NULL) != 0) {
+            perror("pthread_join() in run_streams()");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/*  Fill the fields of the streams common to GET and PUT */
+static struct stream *new_streams(long long int first, unsigned long long int number, int streams, long int *ports, char *ip, int verbose, FILE *log) {
+    struct stream *st;
+    int i;
+    
+    st = malloc(sizeof(struct stream) * (size_t) streams);
+    if (st == NULL) {
+        fprintf(stderr, "Error in new_streams(): cannot allocate memory for streams\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < streams; ++i) {
+        //The same ranges calculated by the server
+        get_stream_range(first, (long long int) number, streams, i, &st[i].first, &st[i].last);
+        st[i].port = (int) ports[i];
+        st[i].fd = -1;
+        st[i].filename = NULL;
+        st[i].size = 0;
+        st[i].ip = ip;
+        st[i].verbose = verbose;
+        st[i].log = log;
+        st[i].cc = CONGESTION_CONTROL;
+        st[i].cp = NULL;
+    }
+    return st;
+}
+
+void receive_streams(char *filename, long int number, unsigned long long int size, long long int identity,
+                     long long int first, int streams, long int *ports, char *ip, int verbose, FILE *log) {
+    struct stream *st = new_streams(first, (unsigned long long int) number, streams, ports, ip, verbose, log);
+    struct checkpoint *cp;
+    char *output;
+    int i, fd;
+    
+    //Resume the partial copy of the file, or search if the file name already
+    //exists, and reserve the space of the file
+    output = checkpoint_output(filename, first);
+    fd = open_file(WRITE, output);
+    cp = new_checkpoint(output, (unsigned long long int) number, size, identity, first, streams);
+    free(output);
+    allocate_file(fd, number);
+    
+    for (i = 0; i < streams; ++i) {
+        st[i].fd = fd;
+        st[i].cp = cp;
+    }
+    run_streams(st, streams, receive_stream);
+    
+    checkpoint_delete(cp);
+    close_file(fd);
+    free(st);
+}
+
+void send_streams(char *filename, long long int first, int streams, long int *ports, char *ip, int verbose, FILE *log, int cc) {
+    unsigned long long int size = get_dimension(filename);
+    struct stream *st = new_streams(first, get_number(size), streams, ports, ip, verbose, log);
+    int i;
+    
+    for (i = 0; i < streams; ++i) {
+        st[i].filename = filename;
+        st[i].size = size;
+        st[i].cc = cc;
+    }
+    run_streams(st, streams, send_stream);
+    
+    free(st);
+}
@@ -0,0 +1,114 @@
+//
+//  streams.h
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+//  ABSTRACT
+//
+//  This header file contains the functions used by the client to transfer a
+//  file split into many streams (see TRANSFER_STREAMS in 'settings.h'). With a
+//  single stream, a transfer is limited by a single sliding window and by the
+//  threads of a single 'send_file()' or 'receive_file()'. With many streams, the
+//  file is split into contiguous ranges of blocks (see 'get_stream_range()' in
+//  'utils.h'), and each range is transferred by its own thread with
+//  'send_range()' or 'receive_range()', on its own port and socket, with its own
+//  sliding window. The server serves each stream with a worker of its own.
+//  Each block keeps the sequence number that it has in the whole file, so the
+//  receiver writes the blocks of all the streams at their offsets into the same
+//  file, and no reassembly is needed. A transfer resumed (see 'checkpoint.h')
+//  splits into streams only the packets from the first one missing onwards.
+
+
+#ifndef __Reliable_UDP__streams__
+#define __Reliable_UDP__streams__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "settings.h"
+#include "utils.h"
+#include "put.h"
+#include "get.h"
+#include "checkpoint.h"
+
+
+/*  This data structure contains the parameters of the thread of a stream */
+struct stream {
+    pthread_t thread;               //Where the thread ID is saved
+    int port;                       //Communication port of the stream
+    long long int first;            //First packet of the range of the stream
+    long long int last;             //Last packet of the range of the stream
+    int fd;                         //GET: file where the range is written (shared by the streams)
+    char *filename;                 //PUT: file to send (each stream opens it)
+    unsigned long long int size;    //PUT: size of the file in bytes
+    char *ip;                       //IP of the server
+    int verbose;                    //1 -> verbose mode on, 0 -> verbose off
+    FILE *log;                      //File pointer to the log file (if exists)
+    int cc;                         //PUT: congestion control of the stream (see 'congestion_control.h')
+    struct checkpoint *cp;          //GET: checkpoint of the file (shared by the streams)
+};
+
+
+/*  This function receives a file split into many streams, and waits until all
+ *  of them are over. The file is chosen with 'checkpoint_output()', like in
+ *  'receive_file()' (the partial copy of the file, if any, otherwise a new
+ *  file), and all the streams write into it.
+ *
+ *  Parameters:
+ *  - filename:     Name of the file to receive
+ *  - number:       Number of packets of the file
+ *  - size:         Size of the file in bytes (see 'receive_file()')
+ *  - identity:     Identity of the file (see 'receive_file()')
+ *  - first:        First packet to receive (1, unless the transfer is resumed)
+ *  - streams:      Number of streams granted by the server
+ *  - ports:        Communication port of each stream
+ *  - ip:           IP of the server
+ *  - verbose:      1 if verbose mode is on
+ *  - log:          Pointer to the log file (it can be NULL)
+ *
+ *  Return:         Nothing
+ */
+void receive_streams(char *filename, long int number, unsigned long long int size, long long int identity,
+                     long long int first, int streams, long int *ports, char *ip, int verbose, FILE *log);
+
+
+/*  This function sends a file split into many streams, and waits until all of
+ *  them are over.
+ *
+ *  Parameters:
+ *  - filename:     Path of the file to send
+ *  - first:        First packet to send (1, unless the transfer is resumed)
+ *  - streams:      Number of streams granted by the server
+ *  - ports:        Communication port of each stream
+ *  - ip:           IP of the server
+ *  - verbose:      1 if verbose mode is on
+ *  - log:          Pointer to the log file (it can be NULL)
+ *  - cc:           Congestion control of each stream (see 'congestion_control.h')
+ *
+ *  Return:         Nothing
+ */
+void send_streams(char *filename, long long int first, int streams, long int *ports, char *ip, int verbose, FILE *log, int cc);
+
+
+#endif /* defined(__Reliable_UDP__streams__) */
@@ -31,7 +31,7 @@ int LANG_TYPE = 0;              //Language ID
 
 /* This function loads the english language */
 void load_en_lang() {
-    char *en_lang[1024] = {
+    static char *en_lang[1024] = {
         "  Welcome to Reliable UDP Server",
         "  Welcome to Reliable UDP Client",
         "Log service",
@@ -52,7 +52,7 @@ void load_en_lang() {
         "packets to receive",
         "Received pkt with seq",
         "The resource text does not exists",
-        "Launch the program with: '-l' and/or '-v'",
+        "Launch the program with: '-l', '-v' and/or '-e'",
         "Main process",
         "Date",
         "Time",
@@ -76,7 +76,7 @@ void load_en_lang() {
         "Sent packet with seq",
         "Total packets send",
         "Average time to send",
-        "Launch the program with: 'IP addr.' and '-l' and/or '-v'",
+        "Launch the program with: 'IP addr.' and '-l', '-v' and/or '-cc none|reno|cubic'",
         "IP address not valid",
         "Select a language:\nITA (italian)\nENG (english)",
         "English language selected",
@@ -102,7 +102,7 @@ void load_en_lang() {
 
 /* This function loads the italian language */
 void load_it_lang() {
-    char *it_lang[1024] = {
+    static char *it_lang[1024] = {
         "Benvenuto in Reliable UDP Server",
         "Benvenuto in Reliable UDP Client",
         "Ser. di log",
@@ -123,7 +123,7 @@ void load_it_lang() {
         "pacchetti da ricevere",
         "Ricevuto pkt con seq",
         "La risorsa testuale non esiste",
-        "Lanciare con le seguenti opzioni : '-l' e/o '-v'",
+        "Lanciare con le seguenti opzioni : '-l', '-v' e/o '-e'",
         "Processo principale",
         "Data",
         "Ora ",
@@ -147,7 +147,7 @@ void load_it_lang() {
         "Spedito pacchetto con seq",
         "Totale pacchetti spediti",
         "Tempo medio per l'invio",
-        "Lanciare con le seguenti opzioni : 'IP' e '-l' e/o '-v'",
+        "Lanciare con le seguenti opzioni : 'IP' e '-l', '-v' e/o '-cc none|reno|cubic'",
         "Indirizzo IP non valido",
         "Seleziona una lingua:\nITA (italiano)\nENG (inglese)",
         "Lingua italiana impostata",
@@ -25,75 +25,53 @@
 
 #include "time_controller.h"
 
-/*  This function represent the main work of the thread that is responsible for 
- *  controlling timeouts.
- *
- *  Parameters:
- *  - arg:      Represent a casting to 'stuct time_controller *'
+/*  This function converts a timeout in the number of ticks of the 'timer_wheel'
+ *  (rounded up, at least one tick).
+ */
+static unsigned long long int timeout_to_ticks(long long int timeout) {
+    unsigned long long int tick = (unsigned long long int) TIMER_WHEEL_RESOLUTION * 1000;
+    unsigned long long int ticks = ((unsigned long long int) timeout + tick - 1) / tick;
+    
+    return ticks > 0 ? ticks : 1;
+}
+
+
+/*  This function resends the packets whose timeout has expired, and adds their
+ *  timers again with a timeout increased twice (see 'rto.h'). It must be called
+ *  with the mutex.
  *
- *  Return:     Nothing
+ *  Return:     0 on success, 1 if a packet was sent MAX_RETRIES_SENDING_PKT times
  */
-void *threadWork(void *arg) {
-    struct time_controller *tc = (struct time_controller *) arg;
-    
-    //Running until 'tc->running' == 1
-    while (tc->running == 1) {
-        struct timeval tv;
-        struct time_data *td;
-        
-        get_mutex(&tc->MTX);
-        
-        //If 'timer_wheel' is empty, wait on condition 'empty'
-        while (timer_wheel_is_empty(tc->tw) == 1)
-            pthread_cond_wait(&tc->empty, &tc->MTX);
-        
-        int deleted = 0;        //If deleted != 0, at least one 'time_data' was deleted
-        int nE = tc->tw->E;     //Save the indexes to restore them at the end
-        int nS = tc->tw->S;     //
-        
-        //Continue until 'timer_wheel' is empty
-        while (timer_wheel_is_empty(tc->tw) == 0) {
-            
-            gettimeofday(&tv, NULL);                    //Reference time to control the others
-            
-            td = timer_wheel_get_timer(tc->tw);         //Get first 'time_data' avaible
-            
-            //Control if timeout has expired, comparing this with the reference time.
-            //If timeout has expired, seach for packet with sequence number == seq
-            if ((tv.tv_sec - td->time_send.tv_sec) * 1000000 + (tv.tv_usec - td->time_send.tv_usec) > td->timeout.tv_sec * 1000000 + td->timeout.tv_usec) {
-                //If the packet exists, resend it and update its 'time_send'
-                if(window_controller_resend_packet(tc->wc, td->seq) == 0) {
-                    gettimeofday(&td->time_send, NULL);
-                }
-                //If the packet doesn't exists, delete the timer. In fact, if packet doesn't
-                //exists, it means that it was acked and deleted before
-                else {
-                    timer_wheel_delete_timer(tc->tw);   //Delete the timer
-                    nE = (nE - 1) % tc->tw->dim;        //Set the index
-                    deleted++;                          //Increase 'deleted' to send signal
-                }
-            }
+static int expire_timers(struct time_controller *tc) {
+    struct time_data *td;
+    unsigned long long int now;
+    int i, n, res;
+    
+    //Move the wheel to the current tick: only the expired timers are visited
+    now = timer_wheel_get_tick();
+    n = timer_wheel_expire(tc->tw, now, tc->expired);
+    
+    for (i = 0; i < n; ++i) {
+        td = tc->expired[i];
+        //If the packet exists, resend it, update its 'time_send' and add
+        //the timer again
+        res = window_controller_resend_packet(tc->wc, td->seq);
+        if (res == 0) {
+            td->time_send = get_monotonic_nsec();
+            td->timeout = rto_backoff(td->timeout);
+            timer_wheel_add(tc->tw, td, now + timeout_to_ticks(td->timeout));
         }
-        
-        tc->tw->E = nE;             //Restore the indexes
-        tc->tw->S = nS;             //
-        
-        //If at least one 'time_data' was deleted, send a signal to all processes
-        //pending on condition 'full'
-        if (deleted > 0)
-            pthread_cond_signal(&tc->full);
-        
-        release_mutex(&tc->MTX);    //release mutex
-        
-        msleep(tc->granularity);    //sleeps
-        
+        else if (res == 2)
+            return 1;
+        //If the packet doesn't exists, the timer is not added again. In fact,
+        //if packet doesn't exists, it means that it was acked and deleted before
     }
     
-    //When 'running' is setted to 0 by 'time_controller_stop', the thread die
-    pthread_exit(0);
+    return 0;
 }
 
-struct time_controller *new_time_controller(unsigned int granularity, int dim, FILE *log, int user, struct server_status *status) {
+
+struct time_controller *new_time_controller(int dim, FILE *log, int user, struct server_status *status) {
     struct time_controller *tc;
     
     tc = malloc(sizeof(struct time_controller));   //Allocate memory for data structure
@@ -103,19 +81,20 @@ struct time_controller *new_time_controller(unsigned int granularity, int dim, F
     }
     
     tc->tw = new_timer_wheel(dim);  //Create a new 'timer_wheel'
+    //Where the expired timers are saved for each check
+    tc->expired = malloc(sizeof(struct time_data *) * dim);
+    if (tc->expired == NULL) {
+        fprintf(stderr, "Error in newtime_controller(): cannot allocate memory for expired timers\n");
+        exit(EXIT_FAILURE);
+    }
     //Initialize mutex
     if(pthread_mutex_init(&tc->MTX, NULL) != 0) {
         fprintf(stderr, "Error in newtime_controller(): cannot initialize mutex\n");
         exit(EXIT_FAILURE);
     }
-    //Initialize conditions
-    if (pthread_cond_init((&tc->empty), NULL) != 0 || pthread_cond_init(&tc->full, NULL) != 0) {
-        fprintf(stderr, "Error in newtime_controller(): cannot create conditions\n");
-        exit(EXIT_FAILURE);
-    }
     
-    tc->granularity = granularity;  //set granularity
-    tc->running = 0;                //at the beginning, the thread does not work
+    tc->acked = 0;                  //no packet is acked yet
+    tc->wc = NULL;                  //set by the owner of the window
     tc->log = log;
     tc->user = user;
     tc->status = status;
@@ -123,47 +102,66 @@ struct time_controller *new_time_controller(unsigned int granularity, int dim, F
     return tc;
 }
 
-void time_controller_start(struct time_controller *tc, struct window_controller *wc) {
-    tc->wc = wc;
-    tc->running = 1;    //set 'running' = 1 to start the thread
+int time_controller_expire(struct time_controller *tc) {
+    int res;
     
-    //Create a new thread to execute the function 'thread_work'
-    if(pthread_create(&tc->t, NULL, threadWork, tc) != 0) {
-        fprintf(stderr, "Error in time_ontroller_tart(): cannot create new thread\n");
-        exit(EXIT_FAILURE);
-    }
+    get_mutex(&tc->MTX);
+    res = timer_wheel_is_empty(tc->tw) == 1 ? 0 : expire_timers(tc);
+    release_mutex(&tc->MTX);
+    
+    return res;
+}
+
+long long int time_controller_next_expiry(struct time_controller *tc) {
+    long long int res = -1;
+    
+    get_mutex(&tc->MTX);
+    if (timer_wheel_is_empty(tc->tw) == 0)
+        res = (long long int) timer_wheel_next_expiry(tc->tw) * TIMER_WHEEL_RESOLUTION;
+    release_mutex(&tc->MTX);
+    
+    return res;
 }
 
 int time_controller_delete_timer(struct time_controller *tc, long long int seq) {
-    struct time_data *td = NULL;
     int res;
     
     get_mutex(&tc->MTX);
+    //Search and delete the timer by sequence number, in constant time
+    res = timer_wheel_delete_timer(tc->tw, seq);
+    release_mutex(&tc->MTX);
     
-    int nE = tc->tw->E;     //Save the indexes to restore them at the end
-    int nS = tc->tw->S;     //
-    
-    //Search a specified 'time_data' without restore the indexes
-    td = timer_wheel_search_by_seq1(tc->tw, seq);
-    //If the specified 'time_data' doesn't exists, return 0...
-    if (td == NULL)
-        res = 0;
-    //...otherwise
-    else {
-        timer_wheel_delete_timer(tc->tw);   //delete the 'time_data' just found
-        //nE--;                               //decrease index;
-        nE = (nE - 1) % tc->tw->dim;
-        res = 1;
-        //pthread_cond_signal(&tc->full);     //send a signal for condition 'full'
-    }
+    return res;
+}
+
+int time_controller_delete_timers(struct time_controller *tc, struct packet *ack) {
+    long long int cumulative = packet_get_cumulative(ack);
+    unsigned char *sack = packet_get_sack(ack);
+    long long int seq;
+    int i, bit, res = 0;
     
-    tc->tw->E = nE;                         //restore the indexes
-    tc->tw->S = nS;                         //
+    get_mutex(&tc->MTX);
     
-    release_mutex(&tc->MTX);
+    //Delete the timers covered by the cumulative ACK. The timers before 'tc->acked'
+    //were already deleted, and the timers before 'cumulative - dim' can not be armed
+    seq = tc->acked + 1;
+    if (seq < cumulative - tc->tw->dim + 1)
+        seq = cumulative - tc->tw->dim + 1;
+    for (; seq <= cumulative; ++seq)
+        res += timer_wheel_delete_timer(tc->tw, seq);
+    if (cumulative > tc->acked)
+        tc->acked = cumulative;
+    
+    //Delete the timers marked in the SACK bitmap
+    for (i = 0; i < SACK_BITMAP_SIZE; ++i) {
+        if (sack[i] == 0)
+            continue;
+        for (bit = 0; bit < 8; ++bit)
+            if (sack[i] & (1 << bit))
+                res += timer_wheel_delete_timer(tc->tw, cumulative + 2 + i * 8 + bit);
+    }
     
-    if (res == 1)
-        pthread_cond_signal(&tc->full);
+    release_mutex(&tc->MTX);
     
     return res;
 }
@@ -179,34 +177,23 @@ int time_controller_is_empty(struct time_controller *tc) {
 void time_controller_add_new_timer(struct time_data *td, struct time_controller *tc) {
     get_mutex(&tc->MTX);
 
-    //If 'timer_wheel' is full, wait on condition 'full'
-    while (timer_wheel_is_full(tc->tw) == 1)
-        pthread_cond_wait(&tc->full, &tc->MTX);
-    
-    //If 'timer_wheel' is not full...
-    gettimeofday(&td->time_send, NULL);    //enter the current time
-    timer_wheel_add(tc->tw, td);            //insert td into 'timer_wheel'
+    //A timer is armed only for a packet added into the sliding window, that has
+    //a free slot for it: no other thread can free a slot, so it is not waited
+    if (timer_wheel_is_full(tc->tw) == 1) {
+        fprintf(stderr, "Error in time_controller_add_new_timer(): the timer wheel is full\n");
+        exit(EXIT_FAILURE);
+    }
     
-    //send a signal for condition 'empty'
-    pthread_cond_signal(&tc->empty);
+    //Insert td into 'timer_wheel', in the bucket of its expiry tick ('time_send'
+    //was set when the packet was sent)
+    unsigned long long int expires = timer_wheel_get_tick() + timeout_to_ticks(td->timeout);
+    timer_wheel_add(tc->tw, td, expires);
     
     release_mutex(&tc->MTX);
 }
 
-void time_controller_stop(struct time_controller *tc) {
-    get_mutex(&tc->MTX);
-    tc->running = 0;
-    release_mutex(&tc->MTX);
-}
-
 void time_controller_dispose(struct time_controller *tc) {
-    struct time_data *td = NULL;
-    while (timer_wheel_is_empty(tc->tw) == 0) {
-        td = timer_wheel_get_timer(tc->tw);
-        free(td);
-    }
-    
-    free(tc->tw->buffer);
-    free(tc->tw);
+    timer_wheel_delete(tc->tw);
+    free(tc->expired);
     free(tc);
 }
\ No newline at end of file
@@ -28,15 +28,16 @@
 //  This header file contains the 'time_controller' data structure and its functions,
 //  that allow to interact whit it. This data structure allows to control a number
 //  of 'time_data' data structures, and controls if the timeouts are expired.
-//  A thread checks every TIME_CONTROLLER_GRANULARITY msecs all 'time_data' structures
-//  into the 'timer_wheel' to verify which timeout has expired. For best results,
-//  TIME_CONTROLLER_GRANULARITY in 'settings.h' should be set neither too small
-//  (in order to prevent high cpu usage) nor too large (so as not to allow a expired
-//  packet remain too long in the window).
+//  The 'time_controller' has no thread of its own: the thread that owns the
+//  sliding window (see 'send_range()' in 'put.c', and 'session.h') sleeps until
+//  the earliest deadline armed in the 'timer_wheel' ('time_controller_next_expiry()'),
+//  then moves the 'timer_wheel' forward to the current tick with
+//  'time_controller_expire()': only the 'time_data' structures whose timeout has
+//  expired are visited.
 //  The major operations that 'time_controller' can execute are:
 //  - add a new timeout, putting a new 'time_data' into the 'timer_wheel'
 //  - remove a specified 'time_data' from the 'timer_wheel'
-//  - start and stop the thread responsible for monitoring all timeouts
+//  - resend the packets whose timeout has expired
 //
 //  The most important fact is that the sequence number in 'time_data' is closely related
 //  to the sequence number in 'packet': every packet has a unique 'time_data' structure,
@@ -65,14 +66,11 @@
 #include <stdio.h>
 
 struct time_controller {
-    unsigned int granularity;       //TIME_CONTROLLER_GRANULARITY in msecs
-    pthread_t t;                    //Thread identifier
     pthread_mutex_t MTX;            //Mutex to ensuring mutual exclusion
-    pthread_cond_t full;            //Used to wait until it is free at least one slot in the window
-    pthread_cond_t empty;           //Used to wait until it is full at least one slot in the window
+    long long int acked;            //All the timers with sequence number <= acked are deleted
     struct timer_wheel *tw;         //Pointer to a initializated 'timer_wheel'
+    struct time_data **expired;     //Where the expired timers are saved for each check
     struct window_controller *wc;   //Pointer to a initializated 'window_controller'
-    int running;                    //1 if thread is running, 0 otherwise
     FILE *log;                      //Pointer to the log file (it can be NULL)
     int user;                       //ID of the user: LS_SERVER or LS_CLIENT
     struct server_status *status;   //Pointer to 'server_status' struct (it can be NULL)
@@ -82,33 +80,40 @@ struct time_controller {
 /*  This function creates a new valid 'time_controller' data structure already
  *  initializated.
  *
+ *  The 'window_controller' through wich the packets are resent must be set in
+ *  the field 'wc' before calling 'time_controller_expire()'.
+ *
  *  Parameters:
- *  - granularity:      This value represents the time during which the thread 
- *                      sleeps in msecs. When he awoke, the thread will check all 
- *                      the timeout into 'timer_wheel' before going back to sleep.
- *                      In this program, the value passed at this function is
- *                      TIME_CONTROLLER_GRANULARITY, a macro in 'settings.h'
  *  - dim:              The dimension of the sliding window. In this program, the value passed
  *                      in this function is WINDOW_DIMENSION, a macro in 'settings.h'
  *
  *  Return:             A pointer to a valid 'time_controller' data structure
  */
-struct time_controller *new_time_controller(unsigned int granularity, int dim, FILE *log, int user,
+struct time_controller *new_time_controller(int dim, FILE *log, int user,
                                             struct server_status *status);
 
 
-/*  This function starts a new thread that is responsible for controlling timeouts.
- *  This thread execute throughout its life time the function 'thread_work'
- *  (see 'time_controller.c' for detail).
+/*  This function resends the packets whose timeout has expired, with
+ *  'window_controller_resend_packet()', and arms their timers again.
  *
  *  Parameters:
  *  - tc:               Pointer to 'time_controller' through wich execute the operation
- *  - wc:               Pointer to 'window_controller' through wich resend a packet
- *                      if a timeout has expired with 'window_controller_resend_packet'
  *
- *  Return:             Nothing
+ *  Return:             0 on success, 1 if a packet was sent MAX_RETRIES_SENDING_PKT
+ *                      times (the connection is lost)
+ */
+int time_controller_expire(struct time_controller *tc);
+
+
+/*  This function returns the time of the earliest deadline armed, in usecs of
+ *  CLOCK_MONOTONIC (see 'get_monotonic_usec()' in 'utils.h').
+ *
+ *  Parameters:
+ *  - tc:               Pointer to 'time_controller' through wich execute the operation
+ *
+ *  Return:             The time of the deadline, -1 if there are no timers
  */
-void time_controller_start(struct time_controller *tc, struct window_controller *wc);
+long long int time_controller_next_expiry(struct time_controller *tc);
 
 
 /*  This function eliminates a specific 'time_data' structure, identified by its
@@ -124,9 +129,25 @@ void time_controller_start(struct time_controller *tc, struct window_controller
 int time_controller_delete_timer(struct time_controller *tc, long long int seq);
 
 
+/*  This function deletes, with a single lock of the mutex, all the timers of
+ *  the packets acked by a cumulative and selective ACK (a packet with
+ *  PKT_FLAG_SACK, see 'packet.h'): the timers with sequence number <= cumulative
+ *  ACK and the timers marked in the SACK bitmap.
+ *
+ *  Parameters:
+ *  - tc:               Pointer to 'time_controller' through wich execute the operation
+ *  - ack:              The ACK received
+ *
+ *  Return:             The number of deleted timers
+ */
+int time_controller_delete_timers(struct time_controller *tc, struct packet *ack);
+
+
 /*  This function adds a new 'time_data' into the 'timer_wheel' data structure.
- *  The 'time_data' is added only if 'timer_wheel' is not full, otherwise
- *  the process/thread waits on condition 'full' until a signal is sent.
+ *  A timer is added only for a packet added into the sliding window, so the
+ *  'timer_wheel' is never full: if it is, the process exits with EXIT_FAILURE.
+ *  No thread waits here, since the timers are checked by the owner of the window
+ *  with 'time_controller_expire()'.
  *
  *  Parameters:
  *  - td:               The 'time_data' structure to be added
@@ -148,16 +169,6 @@ void time_controller_add_new_timer(struct time_data *td, struct time_controller
 int time_controller_is_empty(struct time_controller *tc);
 
 
-/*  This function stops the thread safely, and kills it
- *
- *  Parameters:
- *  - tc:               Pointer to 'time_controller' through wich execute the operation
- *
- *  Return:             Nothing
- */
-void time_controller_stop(struct time_controller *tc);
-
-
 /*  This function frees all the memory occupied by the data structure and its parameters
  *
  *  Parameters:
@@ -35,8 +35,18 @@ struct time_data *new_time_data(long long int seq) {
     
     td->seq = seq;
     //Set the time of sending
-    gettimeofday(&td->time_send, NULL);
+    td->time_send = get_monotonic_nsec();
     
     return td;
 }
 
+long long int get_monotonic_nsec() {
+    struct timespec now;
+    
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        perror("clock_gettime() in get_monotonic_nsec()");
+        exit(EXIT_FAILURE);
+    }
+    return (long long int) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
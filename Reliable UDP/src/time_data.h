@@ -32,6 +32,8 @@
 //  In fact, 'packet' and 'time_data' are closely linked: each packet has a pointer
 //  to a structure 'time_data', even if they are handled in a completely different
 //  way. Both data structures share the sequence number.
+//  All the times are in nsecs of CLOCK_MONOTONIC (see 'get_monotonic_nsec()'),
+//  so they are not affected by changes of the system clock.
 
 
 #ifndef __Reliable_UDP__time_data__
@@ -45,9 +47,9 @@
 
 
 struct time_data {
-    struct timeval time_send;   //Send time
-    struct timeval time_recv;   //Time of receipt
-    struct timeval timeout;     //Timeout
+    long long int time_send;    //Send time (nsecs)
+    long long int time_recv;    //Time of receipt (nsecs)
+    long long int timeout;      //Timeout (nsecs)
     struct timeval time_stamp;  //Not used in this release
     long long int seq;          //Sequence number
     
@@ -64,4 +66,8 @@ struct time_data {
 struct time_data *new_time_data(long long int seq);
 
 
+/*  This function returns the current time of CLOCK_MONOTONIC in nsecs */
+long long int get_monotonic_nsec();
+
+
 #endif /* defined(__Reliable_UDP__time_data__) */
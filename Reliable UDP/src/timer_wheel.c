@@ -24,128 +24,237 @@
 
 #include "timer_wheel.h"
 
+
+/*  These functions allow to calculate the bucket of a level, and to add or
+ *  remove a slot from the list of its bucket
+ */
+static int bucket_of(int level, int index) {
+    return level * TIMER_WHEEL_SLOTS + index;
+}
+
+static void bucket_insert(struct timer_wheel *tw, int b, int slot) {
+    tw->prev[slot] = -1;                //Insert in head
+    tw->next[slot] = tw->heads[b];      //
+    if (tw->heads[b] != -1)
+        tw->prev[tw->heads[b]] = slot;
+    tw->heads[b] = slot;
+    tw->bucket[slot] = b;
+}
+
+static void bucket_remove(struct timer_wheel *tw, int slot) {
+    int b = tw->bucket[slot];
+    
+    if (tw->prev[slot] != -1)
+        tw->next[tw->prev[slot]] = tw->next[slot];
+    else
+        tw->heads[b] = tw->next[slot];
+    if (tw->next[slot] != -1)
+        tw->prev[tw->next[slot]] = tw->prev[slot];
+    
+    tw->bucket[slot] = -1;
+}
+
+
+/*  This function puts an armed slot in the right bucket, according to the
+ *  distance between its expiry tick and the current tick of the wheel.
+ */
+static void link_timer(struct timer_wheel *tw, int slot) {
+    unsigned long long int expires = tw->expires[slot];
+    unsigned long long int delta;
+    int level;
+    
+    //A timer already expired will expire at the next tick processed
+    if (expires < tw->now)
+        expires = tw->now;
+    delta = expires - tw->now;
+    //A timer too far in the future is put at the end of the wheel
+    if (delta > TIMER_WHEEL_MAX_DELTA) {
+        delta = TIMER_WHEEL_MAX_DELTA;
+        expires = tw->now + delta;
+    }
+    tw->expires[slot] = expires;
+    
+    //Level 'l' contains the timers that expire in less than SLOTS^(l+1) ticks
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; ++level)
+        if (delta < (1ULL << ((level + 1) * TIMER_WHEEL_BITS)))
+            break;
+    
+    bucket_insert(tw, bucket_of(level, (int) ((expires >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK)), slot);
+}
+
+
+/*  When level 0 completes a turn, this function moves the timers of the
+ *  current bucket of the upper levels into the lower levels.
+ */
+static void cascade(struct timer_wheel *tw) {
+    int level, index, slot, next;
+    
+    for (level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+        index = (int) ((tw->now >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+        slot = tw->heads[bucket_of(level, index)];
+        tw->heads[bucket_of(level, index)] = -1;
+        
+        while (slot != -1) {
+            next = tw->next[slot];
+            link_timer(tw, slot);   //The timer expires in this turn: it goes down
+            slot = next;
+        }
+        //If this level has not completed a turn, the upper levels don't move
+        if (index != 0)
+            break;
+    }
+}
+
+
+unsigned long long int timer_wheel_get_tick(void) {
+    struct timespec ts;
+    
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
+        perror("clock_gettime() in timer_wheel_get_tick()");
+        exit(EXIT_FAILURE);
+    }
+    
+    return ((unsigned long long int) ts.tv_sec * 1000000 + ts.tv_nsec / 1000) / TIMER_WHEEL_RESOLUTION;
+}
+
 struct timer_wheel *new_timer_wheel(int dim) {
     struct timer_wheel *tw;
+    int i;
     //Allocate memory for data structure
     tw = malloc(sizeof(struct timer_wheel));
     if (tw == NULL) {
         fprintf(stderr, "Error in new_timer_wheel(): cannot allocate memory for timer_wheel\n");
         exit(EXIT_FAILURE);
     }
-    //Allocate memory for array of 'dim' 'time_data' data structures
+    //Allocate memory for array of 'dim' 'time_data' data structures and their links
     tw->buffer = malloc(sizeof(struct time_data) * dim);
-    if (tw->buffer == NULL) {
+    tw->expires = malloc(sizeof(unsigned long long int) * dim);
+    tw->next = malloc(sizeof(int) * dim);
+    tw->prev = malloc(sizeof(int) * dim);
+    tw->bucket = malloc(sizeof(int) * dim);
+    if (tw->buffer == NULL || tw->expires == NULL || tw->next == NULL ||
+        tw->prev == NULL || tw->bucket == NULL) {
         fprintf(stderr, "Error in new_timer_wheel(): cannot allocate memory for buffer\n");
         exit(EXIT_FAILURE);
     }
     
-    tw->E = 0;      //initialize the indexes
-    tw->S = 0;      //
+    for (i = 0; i < dim; ++i)           //At the beginning, no timer is armed
+        tw->bucket[i] = -1;             //
+    for (i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; ++i)
+        tw->heads[i] = -1;              //All buckets are empty
+    
     tw->dim = dim;
+    tw->num = 0;
+    tw->now = timer_wheel_get_tick();
     
     return tw;
 }
 
 int timer_wheel_is_empty(struct timer_wheel *tw) {
-    //Circular array is empty if 'E' and 'S' has the same value
-    if (tw->S == tw->E)
+    if (tw->num == 0)
         return 1;
     else
         return 0;
 }
 
 int timer_wheel_is_full(struct timer_wheel *tw) {
-    //Circular array is full if between 'E' and 'S' there is only one free slot
-    int nE = (tw->E + 1) % tw->dim;
-    if (nE == tw->S)
+    if (tw->num >= tw->dim - 1)
         return 1;
     else
         return 0;
 }
 
-int timer_wheel_add(struct timer_wheel *tw, struct time_data *td) {
-    if (timer_wheel_is_full(tw) == 1)
-        return 1;
-    else {
-        tw->buffer[tw->E] = *td;        //Add 'time_data' into position 'E'
-        tw->E = (tw->E + 1) % tw->dim;  //Move 'E' of one position
-
-        return 0;
+int timer_wheel_add(struct timer_wheel *tw, struct time_data *td, unsigned long long int expires) {
+    int slot = (int) (td->seq % tw->dim);
+    
+    //If the slot is used by an old timer, replace it
+    if (tw->bucket[slot] != -1) {
+        bucket_remove(tw, slot);
+        tw->num--;
     }
+    else if (timer_wheel_is_full(tw) == 1)
+        return 1;
+    
+    if (&tw->buffer[slot] != td)
+        tw->buffer[slot] = *td;         //Copy 'time_data' into its slot
+    tw->expires[slot] = expires;
+    link_timer(tw, slot);               //Put the timer in its bucket
+    tw->num++;
+    
+    return 0;
 }
 
-struct time_data *timer_wheel_get_timer(struct timer_wheel *tw) {
-    struct time_data *td;
+struct time_data *timer_wheel_search_by_seq(struct timer_wheel *tw, long long int seq) {
+    int slot = (int) (seq % tw->dim);
     
-    if (timer_wheel_is_empty(tw) == 1)
+    //The slot must contain an armed timer with the same sequence number
+    if (tw->bucket[slot] == -1 || tw->buffer[slot].seq != seq)
         return NULL;
-    else {
-        td = &tw->buffer[tw->S];        //Read 'time_data' in position 'S'
-        tw->S = (tw->S + 1) % tw->dim;  //Move 'S' of one position
-        return td;
-    }
+    
+    return &tw->buffer[slot];
 }
 
-struct time_data *timer_wheel_search_by_seq(struct timer_wheel *tw, long long int seq) {
-    struct time_data *td = NULL;
-    int nE;
-    int nS;
+int timer_wheel_delete_timer(struct timer_wheel *tw, long long int seq) {
+    struct time_data *td = timer_wheel_search_by_seq(tw, seq);
     
-    if (timer_wheel_is_empty(tw) == 1)
-        return NULL;
-    else {
-        nE = tw->E;         //Save the indexes value to restore it at the end
-        nS = tw->S;         //
-        
-        //Slide all the circular array, because the values ​​can not be ordered
-        while (timer_wheel_is_empty(tw) == 0) {
-            td = timer_wheel_get_timer(tw);
-            if (td->seq == seq)     //If this is the value i'm looking for...
-                break;              //...stop (sequence number are unique)
-        }
-        
-        tw->E = nE;                 //Restore the prevoius values
-        tw->S = nS;                 //
-        
-        //Last control before 'return'
-        if (td != NULL && td->seq != seq)
-            return NULL;
-        
-        return td;
-    }
+    if (td == NULL)
+        return 0;
+    
+    bucket_remove(tw, (int) (seq % tw->dim));
+    tw->num--;
+    
+    return 1;
 }
 
-struct time_data *timer_wheel_search_by_seq1(struct timer_wheel *tw, long long int seq) {
-    struct time_data *td = NULL;
+int timer_wheel_expire(struct timer_wheel *tw, unsigned long long int now, struct time_data **expired) {
+    int n = 0, slot, next, b;
     
-    if (timer_wheel_is_empty(tw) == 1)
-        return NULL;
-    else {
-        //Slide all the circular array, because the values ​​can not be ordered
-        while (timer_wheel_is_empty(tw) == 0) {
-            td = timer_wheel_get_timer(tw);
-            if (td->seq == seq)     //If this is the value i'm looking for...
-                break;              //...stop (sequence number are unique)
+    while (tw->now <= now) {
+        //Without armed timers, the wheel can jump directly to 'now'
+        if (tw->num == 0) {
+            tw->now = now + 1;
+            break;
         }
-        //Last control before 'return'
-        if (td != NULL && td->seq != seq)
-            return NULL;
         
-        return td;
+        //When level 0 starts a new turn, move down the timers of the upper levels
+        if ((tw->now & TIMER_WHEEL_MASK) == 0)
+            cascade(tw);
+        
+        //All the timers in the current bucket of level 0 are expired
+        b = bucket_of(0, (int) (tw->now & TIMER_WHEEL_MASK));
+        slot = tw->heads[b];
+        while (slot != -1) {
+            next = tw->next[slot];
+            bucket_remove(tw, slot);
+            tw->num--;
+            expired[n++] = &tw->buffer[slot];
+            slot = next;
+        }
+        
+        tw->now++;
     }
+    
+    return n;
 }
 
-void timer_wheel_delete_timer(struct timer_wheel *tw) {
-    struct time_data *temp = &tw->buffer[(tw->S-1) % tw->dim];
+unsigned long long int timer_wheel_next_expiry(struct timer_wheel *tw) {
+    int index;
     
-    tw->buffer[tw->S-1] = tw->buffer[(tw->E-1)];    //Switch pointers
-    tw->buffer[(tw->E-1)] = *temp;                  //
-    tw->E = (tw->E - 1) % tw->dim;    //Update the indexes
-    tw->S = (tw->S - 1) % tw->dim;    //
+    //The buckets of level 0 from the current one to the end of the turn
+    //contain only timers that expire in this turn
+    for (index = (int) (tw->now & TIMER_WHEEL_MASK); index < TIMER_WHEEL_SLOTS; ++index)
+        if (tw->heads[bucket_of(0, index)] != -1)
+            return (tw->now & ~((unsigned long long int) TIMER_WHEEL_MASK)) + index;
     
+    //Otherwise, wake up at the beginning of the next turn
+    return (tw->now | TIMER_WHEEL_MASK) + 1;
 }
 
 void timer_wheel_delete(struct timer_wheel *tw) {
     free(tw->buffer);   //Delete buffer memory
+    free(tw->expires);  //
+    free(tw->next);     //
+    free(tw->prev);     //
+    free(tw->bucket);   //
     free(tw);           //Delete struct memory
-}
\ No newline at end of file
+}
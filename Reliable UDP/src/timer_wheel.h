@@ -26,184 +26,179 @@
 //  ABSTRACT
 //
 //  This header file contains the 'timer_wheel' data structure and the functions
-//  that allows to manage it. The 'timer_wheel' is basically a circular array,
-//  like 'window' data structure. Indexes 'E' and 'S' are respectively
-//  the first position free, ready to be write, and the first position full,
-//  ready to be read. In the architecture of the program (N-layer), 'timer_wheel'
-//  and its functions are placed in a layer below 'time_controller' data
-//  structure. In fact, all this functions are used into functions of
-//  'time_controller'. The data structure 'time_data' is the basic unit with
-//  which 'timer_wheel' interacts. In fact 'time_data' is in the lower layer of
-//  the architecture as 'packet'.
+//  that allows to manage it. The 'timer_wheel' is a hierarchical hashed timing
+//  wheel: the time is divided in 'ticks' of TIMER_WHEEL_RESOLUTION usecs
+//  (see 'settings.h'), and each armed timer is put in a bucket selected by its
+//  expiry tick. The wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS
+//  buckets: level 0 contains the timers that expire in the next TIMER_WHEEL_SLOTS
+//  ticks, level 1 the timers that expire in the next TIMER_WHEEL_SLOTS^2 ticks,
+//  and so on. When level 0 completes a turn, the next bucket of the upper level
+//  is moved (cascaded) into the lower levels.
+//  The 'time_data' structures are stored into an array of 'dim' slots, and the
+//  slot of each timer is 'seq % dim'. Since the packets 'on the fly' have
+//  contiguous sequence numbers, two armed timers never share the same slot.
+//  In this way:
+//  - a new timer is added in O(1)
+//  - a timer is searched and deleted by sequence number in O(1)
+//  - for each tick, only the timers that really expire are visited
+//  In the architecture of the program (N-layer), 'timer_wheel' and its functions
+//  are placed in a layer below 'time_controller' data structure. In fact, all
+//  this functions are used into functions of 'time_controller'. The data structure
+//  'time_data' is the basic unit with which 'timer_wheel' interacts. In fact
+//  'time_data' is in the lower layer of the architecture as 'packet'.
 
 
 #ifndef __Reliable_UDP__timer_wheel__
 #define __Reliable_UDP__timer_wheel__
 
 #include "time_data.h"
+#include "settings.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
+#define TIMER_WHEEL_LEVELS      4                               //Number of levels
+#define TIMER_WHEEL_BITS        8                               //Bits of the tick for each level
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_BITS)         //Buckets for each level
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SLOTS - 1)         //
+#define TIMER_WHEEL_MAX_DELTA   ((1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1)
+
 struct timer_wheel {
-    int E;                      //Index: first position free
-    int S;                      //Index: first position full
-    int dim;                    //Dimension of the array
-    struct time_data *buffer;   //Array of 'time_data' structures
+    int dim;                                            //Dimension of the array of timers
+    int num;                                            //Number of armed timers
+    unsigned long long int now;                         //Next tick to be processed
+    struct time_data *buffer;                           //Array of 'time_data' (slot = seq % dim)
+    unsigned long long int *expires;                    //Expiry tick of each slot
+    int *next;                                          //Next slot in the same bucket (-1 = none)
+    int *prev;                                          //Previous slot in the same bucket (-1 = none)
+    int *bucket;                                        //Bucket of each slot (-1 = timer not armed)
+    int heads[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];  //First slot of each bucket (-1 = empty)
 };
 
 
+/*  This function returns the current tick, calculated on the monotonic clock
+ *  of the system. A tick lasts TIMER_WHEEL_RESOLUTION usecs.
+ *
+ *  Parameters:     Nothing
+ *
+ *  Return:         The current tick
+ */
+unsigned long long int timer_wheel_get_tick(void);
+
+
 /*  This function creates a new and initializated 'timer_wheel' with 'dim' 
  *  slots avaible.
  *
  *  Parameters:
- *  - dim:      dimension of the circular array
+ *  - dim:      dimension of the array of timers
  *
  *  Return:     Pointer to an initializated 'timer_wheel' data structure
  */
 struct timer_wheel *new_timer_wheel(int dim);
 
 
-/*  This function adds a new 'time_data' into 'timer_wheel'.
- *  This operation involves moving the index 'E' of one position.
+/*  This function adds a new timer into 'timer_wheel'. The 'time_data' is copied
+ *  into the slot 'td->seq % dim'. If the slot already contains an armed timer
+ *  (for example, a timer of a packet already acked that was not deleted yet),
+ *  the old timer is replaced.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
  *  - td:       'time_data' structure to add into 'timer_wheel'
+ *  - expires:  The tick in which the timer expires. If it is already passed,
+ *              the timer expires at the next tick processed
  *
  *  Return:     1 if the 'timer_wheel' is full and it is impossible to add
  *              another 'time_data', 0 on success
  */
-int timer_wheel_add(struct timer_wheel *tw, struct time_data *td);
+int timer_wheel_add(struct timer_wheel *tw, struct time_data *td, unsigned long long int expires);
 
 
-/*  This function gets the first 'time_data' avaible into circular array.
- *  This operation involves moving the index 'S' of one position.
+/*  This function allows to search a specific armed timer, identified by its
+ *  sequence number, in constant time.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
+ *  - seq:      Sequence number to search
  *
- *  Return:     NULL if the 'timer_wheel' is empty and it is impossible to get
- *              a 'time_data', otherwise the pointer to first avaible 'time_data'
+ *  Return:     Pointer to 'time_data' with sequence number == seq. If there isn't
+ *              an armed timer with sequence number == seq, return NULL
  */
-struct time_data *timer_wheel_get_timer(struct timer_wheel *tw);
+struct time_data *timer_wheel_search_by_seq(struct timer_wheel *tw, long long int seq);
 
 
-/*  This function allows to search a specific 'time_data', identified by its
- *  sequence number, into the circular array. At the end of this operation, 
- *  the indexes are reset to their previous values.
+/*  This function deletes (disarms) the timer with sequence number == seq,
+ *  in constant time.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
- *  - seq:      Sequence number to search
+ *  - seq:      Sequence number of the timer to delete
  *
- *  Return:     Pointer to 'time_data' with sequence number == seq. If there isn't
- *              a 'time_data' with sequence number == seq, return NULL
+ *  Return:     1 if the timer was found and deleted, otherwise 0
  */
-struct time_data *timer_wheel_search_by_seq(struct timer_wheel *tw, long long int seq);
+int timer_wheel_delete_timer(struct timer_wheel *tw, long long int seq);
 
 
-/*  This function has the same behavior of 'timer_wheel_search_by_seq', but
- *  the indexes 'E' and 'S' are NOT restored to their previous values.
+/*  This function moves the wheel forward until the tick 'now' (included), and
+ *  removes all the timers that are expired. The expired 'time_data' structures
+ *  remain in their slots (not armed), so they can be added again with
+ *  'timer_wheel_add()'.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
- *  - seq:      Sequence number to search
+ *  - now:      The current tick (see 'timer_wheel_get_tick()')
+ *  - expired:  Array of at least 'dim' elements, where the pointers to the
+ *              expired 'time_data' are written
  *
- *  Return:     Pointer to 'time_data' with sequence number == seq. If there isn't
- *              a 'time_data' with sequence number == seq, return NULL
+ *  Return:     The number of expired timers
  */
-struct time_data *timer_wheel_search_by_seq1(struct timer_wheel *tw, long long int seq);
+int timer_wheel_expire(struct timer_wheel *tw, unsigned long long int now, struct time_data **expired);
 
 
-/*  This funcrion frees all memory occupied by a 'timer_wheel'
+/*  This function returns the tick in which the wheel must be moved forward
+ *  with 'timer_wheel_expire()'. If a timer expires in the current turn of
+ *  level 0, it is its exact expiry tick. Otherwise it is the beginning of the
+ *  next turn, when the timers of the upper levels are cascaded: at that tick,
+ *  the function must be called again.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
  *
- *  Return:     Nothing
+ *  Return:     The next tick to process. Without armed timers, the return
+ *              value is not meaningful
  */
-void timer_wheel_delete(struct timer_wheel *tw);
+unsigned long long int timer_wheel_next_expiry(struct timer_wheel *tw);
 
 
-/*  This function checks if the circular array is empty.
+/*  This funcrion frees all memory occupied by a 'timer_wheel'
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
  *
- *  Return:     1 if 'timer_wheel' is empty, otherwise 0
+ *  Return:     Nothing
  */
-int timer_wheel_is_empty(struct timer_wheel *tw);
+void timer_wheel_delete(struct timer_wheel *tw);
 
 
-/*  This function checks if the circular array is full.
+/*  This function checks if there are armed timers.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
  *
- *  Return:     1 if 'timer_wheel' is full, otherwise 0
+ *  Return:     1 if 'timer_wheel' is empty, otherwise 0
  */
-int timer_wheel_is_full(struct timer_wheel *tw);
+int timer_wheel_is_empty(struct timer_wheel *tw);
 
 
-/*  This function deletes the first position ready to be read in the
- *  circular array. To exeute this operation, the function switches the first
- *  position ready to be write with the first position ready to be read.
- *  Then, the indexes are update, so the 'time_data' can be excluded.
- *  This function must be called only after a 'timer_wheel_get_timer'. In this way,
- *  the indexes are positioned in the correct manner.
- *  In example:
- *
- *------------------------------------------------------------------------------
- *  At the beginning:
- *   -----------------------
- *  |   | 4 | 5 | 6 |   |   |
- *   -----------------------
- *        S           E
- *
- *------------------------------------------------------------------------------
- *
- *  Call 'timer_wheel_get_timer':
- *
- *  struct time_data *td = timer_wheel_get_timer(tw)
- *  td = 4
- *
- *   -----------------------
- *  |   | 4 | 5 | 6 |   |   |
- *   -----------------------
- *            S       E
- *
- *------------------------------------------------------------------------------
- *
- *  Call 'timer_wheel_delete_timer' to delete '4'
- *
- *   -----------------------
- *  |   | 6 | 5 | 4 |   |   |
- *   -----------------------
- *        S       E
- *
- *------------------------------------------------------------------------------
- *
- *  From now, the next call to 'timer_wheel_add' will write a new 'time_data' in E,
- *  and the next call to 'timer_wheel_get_timer' will read from S.
- *
- *  td = 7
- *  Call timer_wheel_add(tw, td)
- *
- *   -----------------------
- *  |   | 6 | 5 | 7 |   |   |
- *   -----------------------
- *        S           E
- *
- *------------------------------------------------------------------------------
+/*  This function checks if all the slots are used. As for 'window', one slot
+ *  is always left free, so the 'timer_wheel' can contain 'dim - 1' timers.
  *
  *  Parameters:
  *  - tw:       Pointer to 'timer_wheel' through wich execute the operation
  *
- *  Return:     Nothing
+ *  Return:     1 if 'timer_wheel' is full, otherwise 0
  */
-void timer_wheel_delete_timer(struct timer_wheel *tw);
-
+int timer_wheel_is_full(struct timer_wheel *tw);
 
 
 #endif /* defined(__Reliable_UDP__timer_wheel__) */
@@ -23,6 +23,9 @@
 //  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
 
 
+//Needed for 'sendmmsg()' and 'recvmmsg()'
+#define _GNU_SOURCE
+
 #include "utils.h"
 
 
@@ -52,6 +55,20 @@ void close_file(int fd) {
 
 
 
+void allocate_file(int fd, long long int number) {
+    int err;
+    
+    if (number <= 1)
+        return;
+    err = posix_fallocate(fd, 0, (off_t) (number - 1) * MAX_BLOCK_SIZE);
+    if (err != 0 && err != EINVAL && err != EOPNOTSUPP) {
+        fprintf(stderr, "posix_fallocate() in allocate_file(): %s\n", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+
 FILE *fopen_file(const char *path) {
     FILE *f;
     
@@ -75,10 +92,16 @@ void fclose_file(FILE *fp) {
 
 char *search_file(char *filename) {
     
-    int fd, i = 0, retries = 0;
+    int fd, retries = 0;
+    size_t size;
     //Adjust filename with fullpath ('data/')
-    char *copy = malloc((strlen(filename) + strlen(DATA_DIR)) * sizeof(char));
-    if (snprintf(copy, (strlen(filename) + strlen(DATA_DIR) + 2) * sizeof(char), "%s/%s", DATA_DIR, filename) < 0) {
+    size = strlen(DATA_DIR) + strlen(filename) + 2;
+    char *copy = malloc(size * sizeof(char));
+    if (copy == NULL) {
+        perror("malloc() in search_file()");
+        exit(EXIT_FAILURE);
+    }
+    if (snprintf(copy, size, "%s/%s", DATA_DIR, filename) < 0) {
         perror("first snprintf() in search_file()");
         exit(EXIT_FAILURE);
     }
@@ -86,21 +109,15 @@ char *search_file(char *filename) {
     while ((fd = open(copy, O_RDONLY)) != -1) {
         //Attempts to search a unique file
         retries++;
-        
-        if (retries == 1 || retries == 10 || retries == 100 || retries == 1000 || retries == 10000)
-            i++;
         //  every time I find a name already used, realloc memory and updates the file name
-        if (retries == 1)
-            copy = realloc(copy, (strlen(filename) + 1) * sizeof(char) + 2 * sizeof(char) + i * sizeof(char));
-        else
-            copy = realloc(copy, (strlen(filename) + 1) * sizeof(char) + i * sizeof(char));
-        
+        size = (size_t) snprintf(NULL, 0, "%s/(%d)%s", DATA_DIR, retries, filename) + 1;
+        copy = realloc(copy, size * sizeof(char));
         if (copy == NULL) {
             perror("realloc() in search_file()");
             exit(EXIT_FAILURE);
         }
         //Write new filename (example: '(3)my_program.exe')
-        if (snprintf(copy, ((strlen(filename) + strlen(DATA_DIR)) + 2) * sizeof(char) + i * sizeof(char) + 2 * sizeof(char), "%s/(%d)%s", DATA_DIR, retries, filename) < 0) {
+        if (snprintf(copy, size, "%s/(%d)%s", DATA_DIR, retries, filename) < 0) {
             perror("second snprintf() in search_file()");
             exit(EXIT_FAILURE);
         }
@@ -110,86 +127,6 @@ char *search_file(char *filename) {
 }
 
 
-/*  This function compare two packet and returns -1 if
- *  pkt1 has the sequence number less than pkt2, otherwise it returns 1.
- *  If sequence numbers are the same, it returns 0.
- *  (used by 'qsort()' function)
- */
-int compare(const void *a, const void *b) {
-    struct packet *pkt1 = (struct packet *) a;
-    struct packet *pkt2 = (struct packet *) b;
-    
-    if (pkt1->seq < pkt2->seq)
-        return -1;
-    else if (pkt1->seq > pkt2->seq)
-        return 1;
-    else
-        return 0;
-}
-
-
-
-void sort_window(struct window *w) {
-    //Save the indexes
-    int nE = w->E;
-    int nS = w->S;
-    
-    int i = 0;
-    int N;
-    struct packet *v;  //Linear temporary buffer
-    
-    /*  Calculate how many packets need to be ordered
-     *
-     *  Example:
-     *
-     *  1)  N = 6 - 4 + 1 = 3
-     *
-     *    0   1   2   3   4   5
-     *   -----------------------
-     *  | x |   |   |   | x | x |   dim = 6
-     *   -----------------------
-     *        E           S
-     *
-     *
-     *  2)  N = 4 - 1 = 3
-     *
-     *    0   1   2   3   4   5
-     *   -----------------------
-     *  |   | x | x | x |   |   |   dim = 6
-     *   -----------------------
-     *        S           E
-     */
-    if (nE < nS)
-        N = (w->dim - nS + nE);
-    else
-        N = nE - nS;
-    //Allocate memory
-    v = malloc(sizeof(struct packet) * N);
-    if (v == NULL) {
-        perror("malloc() in sort_window()");
-        exit(EXIT_FAILURE);
-    }
-    
-    struct packet *temp;
-    //Empty the window and fill the buffer
-    while (window_is_empty(w) == 0) {
-        temp = window_get_pkt(w);
-        v[i] = *temp;
-        ++i;
-    }
-    //Sort the buffer
-    qsort(v, N, sizeof(struct packet), compare);
-    //Reset indexes
-    w->E = 0;
-    w->S = 0;
-    //Insert ordered packets into window again
-    for (i = 0; i<N; ++i)
-        window_add_pkt(w, &v[i]);
-    
-    free(v);
-}
-
-
 unsigned long long get_dimension(const char *f) {
     struct stat sstr;
     //Retrieve information about 'f'
@@ -201,6 +138,16 @@ unsigned long long get_dimension(const char *f) {
     return (unsigned long long) sstr.st_size;
 }
 
+long long int get_modification_time(const char *f) {
+    struct stat sstr;
+    
+    if (stat(f, &sstr) == -1) {
+        perror("stat() in get_modification_time()");
+        exit(EXIT_FAILURE);
+    }
+    return (long long int) sstr.st_mtim.tv_sec * 1000000000LL + sstr.st_mtim.tv_nsec;
+}
+
 unsigned long long int get_number(unsigned long long size) {
     unsigned long long n;
     
@@ -212,6 +159,16 @@ unsigned long long int get_number(unsigned long long size) {
     return n;
 }
 
+void get_stream_range(long long int first, long long int last, int streams, int index, long long int *range_first, long long int *range_last) {
+    long long int number = last >= first ? last - first + 1 : 0;
+    long long int size = number / streams;
+    long long int rest = number % streams;
+    
+    //The first 'rest' streams have a packet more than the others
+    *range_first = first + index * size + (index < rest ? index : rest);
+    *range_last = *range_first + size - 1 + (index < rest ? 1 : 0);
+}
+
 void get_mutex(pthread_mutex_t *MTX) {
     if(pthread_mutex_lock(MTX) == -1){
         perror("get_mutex()");
@@ -269,30 +226,185 @@ int read_operation(char *line) {
     return op;
 }
 
+/*  Prepare the message of a packet: the header is written in 'hdr', and the
+ *  payload is sent from where it is, without copying it (see 'packet_payload()')
+ */
+static void prepare_msg(struct msghdr *msg, struct iovec *iov, unsigned char *hdr, struct packet *pkt, struct sockaddr_in *addr) {
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = PKT_HEADER_SIZE;
+    //Only the header and the bytes really used are sent
+    iov[1].iov_len = packet_serialize_header(pkt, hdr);
+    iov[1].iov_base = (void *) packet_payload(pkt);
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_iov = iov;
+    msg->msg_iovlen = iov[1].iov_len > 0 ? 2 : 1;
+    msg->msg_name = addr;
+    msg->msg_namelen = sizeof(*addr);
+}
+
 void send_pkt(int sockfd, struct packet *pkt, struct sockaddr_in addr) {
-    if(sendto(sockfd, pkt, sizeof(struct packet), 0, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        perror("sendto() in send_pkt()");
+    unsigned char hdr[PKT_HEADER_SIZE];
+    struct iovec iov[2];
+    struct msghdr msg;
+    
+    prepare_msg(&msg, iov, hdr, pkt, &addr);
+    if(sendmsg(sockfd, &msg, 0) < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        perror("sendmsg() in send_pkt()");
         exit(EXIT_FAILURE);
     }
 }
 
-struct packet *recv_pkt(int sockfd, struct sockaddr_in *addr, socklen_t *len) {
-    struct packet *pkt = malloc(sizeof(struct packet));
+struct packet *recv_pkt(int sockfd, struct packet_pool *pool, struct sockaddr_in *addr, socklen_t *len) {
+    unsigned char buf[PKT_MAX_WIRE_SIZE];
+    struct packet *pkt = packet_pool_get(pool);
     
-    if (pkt == NULL) {
-        perror("malloc() in recv_pkt()");
-        exit(EXIT_FAILURE);
+    ssize_t n;
+    do {
+        //Receive the datagram from network...
+        n = recvfrom(sockfd, buf, sizeof(buf), 0, (struct sockaddr*)addr, len);
+        if(n < 0) {
+            perror("recvfrom() in recv_pkt()");
+            exit(EXIT_FAILURE);
+        }
+    //...and put it into the new packet. A malformed datagram is discarded
+    } while (packet_deserialize(pkt, buf, (size_t) n) == -1);
+    
+    return pkt;
+}
+
+void send_pkts(int sockfd, struct packet **pkts, int n, struct sockaddr_in addr) {
+    unsigned char hdrs[IO_BATCH_SIZE][PKT_HEADER_SIZE];
+    struct mmsghdr msgs[IO_BATCH_SIZE];
+    struct iovec iov[IO_BATCH_SIZE][2];
+    int i, k, sent, r;
+    
+    while (n > 0) {
+        k = (n > IO_BATCH_SIZE) ? IO_BATCH_SIZE : n;
+        //Prepare a message for each packet of the batch
+        for (i = 0; i < k; ++i) {
+            prepare_msg(&msgs[i].msg_hdr, iov[i], hdrs[i], pkts[i], &addr);
+            msgs[i].msg_len = 0;
+        }
+        //'sendmmsg()' can send only a part of the batch: send the rest
+        for (sent = 0; sent < k; sent += r) {
+            r = sendmmsg(sockfd, msgs + sent, (unsigned int) (k - sent), 0);
+            if (r < 0) {
+                //Non-blocking socket with a full buffer: the datagrams are
+                //dropped, as if lost by the network
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                if (errno != ENOSYS) {
+                    perror("sendmmsg() in send_pkts()");
+                    exit(EXIT_FAILURE);
+                }
+                //'sendmmsg()' is not supported: send the packets one by one
+                for (i = sent; i < k; ++i)
+                    send_pkt(sockfd, pkts[i], addr);
+                break;
+            }
+        }
+        pkts += k;
+        n -= k;
     }
+}
+
+int recv_pkts_from(int sockfd, struct packet_pool *pool, struct packet **pkts, struct sockaddr_in *addrs, int max) {
+    unsigned char bufs[IO_BATCH_SIZE][PKT_MAX_WIRE_SIZE];
+    struct mmsghdr msgs[IO_BATCH_SIZE];
+    struct iovec iov[IO_BATCH_SIZE];
+    struct sockaddr_in from[IO_BATCH_SIZE];
+    struct packet *pkt;
+    socklen_t len;
+    int i, n, received = 0;
     
-    ssize_t n;
-    //Receive the data from network and put it into the new packet
-    n = recvfrom(sockfd, pkt, sizeof(struct packet), 0, (struct sockaddr*)addr, len);
-    if(n < 0) {
-        perror("recvfrom() in recv_pkt()");
+    if (max > IO_BATCH_SIZE)
+        max = IO_BATCH_SIZE;
+    
+    do {
+        memset(msgs, 0, sizeof(msgs));
+        for (i = 0; i < max; ++i) {
+            iov[i].iov_base = bufs[i];
+            iov[i].iov_len = sizeof(bufs[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+        //Wait for the first datagram, then get all the others already arrived
+        n = recvmmsg(sockfd, msgs, (unsigned int) max, MSG_WAITFORONE, NULL);
+        if (n < 0) {
+            //Non-blocking socket without datagrams
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno != ENOSYS) {
+                perror("recvmmsg() in recv_pkts()");
+                exit(EXIT_FAILURE);
+            }
+            //'recvmmsg()' is not supported: receive only one packet
+            len = sizeof(from[0]);
+            pkts[0] = recv_pkt(sockfd, pool, &from[0], &len);
+            addrs[0] = from[0];
+            return 1;
+        }
+        //Put each datagram into a new packet. A malformed datagram is discarded
+        for (i = 0; i < n; ++i) {
+            pkt = packet_pool_get(pool);
+            if (packet_deserialize(pkt, bufs[i], msgs[i].msg_len) == -1)
+                packet_pool_put(pool, pkt);
+            else {
+                addrs[received] = from[i];
+                pkts[received++] = pkt;
+            }
+        }
+    } while (received == 0);
+    
+    return received;
+}
+
+int recv_pkts(int sockfd, struct packet_pool *pool, struct packet **pkts, int max, struct sockaddr_in *addr, socklen_t *len) {
+    struct sockaddr_in from[IO_BATCH_SIZE];
+    int received;
+    
+    received = recv_pkts_from(sockfd, pool, pkts, from, max);
+    if (received > 0 && addr != NULL) {
+        *addr = from[received - 1];
+        if (len != NULL)
+            *len = sizeof(struct sockaddr_in);
+    }
+    return received;
+}
+
+int wait_pkt(int sockfd, long long int usec) {
+    fd_set set;
+    struct timeval tv;
+    int ret;
+    
+    if (usec < 0)
+        usec = 0;
+    FD_ZERO(&set);
+    FD_SET(sockfd, &set);
+    tv.tv_sec = (time_t) (usec / 1000000);
+    tv.tv_usec = (suseconds_t) (usec % 1000000);
+    
+    ret = select(sockfd + 1, &set, NULL, NULL, &tv);
+    if (ret < 0) {
+        //An interrupted wait is treated as expired: the caller checks again
+        if (errno == EINTR)
+            return 0;
+        perror("select() in wait_pkt()");
         exit(EXIT_FAILURE);
     }
+    return ret > 0 ? 1 : 0;
+}
+
+long long int get_monotonic_usec() {
+    struct timespec now;
     
-    return pkt;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        perror("clock_gettime() in get_monotonic_usec()");
+        exit(EXIT_FAILURE);
+    }
+    return (long long int) now.tv_sec * 1000000 + now.tv_nsec / 1000;
 }
 
 int is_accepted() {
@@ -40,7 +40,9 @@
 #define READ 0
 
 #include "packet.h"
+#include "packet_pool.h"
 #include "window.h"
+#include "ring.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,12 +56,14 @@
 #include <arpa/inet.h>
 #include <stdarg.h>
 #include <semaphore.h>
+#include <sys/select.h>
+#include <time.h>
 
 
 enum user_type { LS_SERVER, LS_CLIENT };
 
 /*  This data structure contains all the necessary parameters to be passed to the 
- *  thread that is responsible for receiving ACKs during PUT operation.
+ *  thread that owns the sliding window during PUT operation.
  *  This data structure is used in 'put.h'
  */
 struct thread_data {
@@ -77,6 +81,11 @@ struct thread_data {
     FILE *log;                      //File pointer to the log file (if exists)
     int verbose;                    //1 -> verbose mode on, 0 -> verbose off
     int user;                       //LS_CLIENT or LS_SERVER
+    long long int received;         //Number of pkts acked
+    int last_percentage;            //Last percentage of completion printed
+    long long int first;            //Sequence number of the first packet to send
+    struct ring *spare;             //Empty packets for the thread that reads the file
+    struct ring *ready;             //Packets read from the file and not yet sent
 };
 
 
@@ -102,6 +111,23 @@ int open_file(unsigned int ctrl, const char *path);
 void close_file(int fd);
 
 
+/*  This function reserves on the disk the space of a file that will be received
+ *  with 'number' packets, with 'posix_fallocate()'. The packets are written at
+ *  their own offsets as soon as they arrive, so the space reserved in advance
+ *  avoids to fragment the file and to find the disk full in the middle of the
+ *  transfer. The size of the last packet is not known, so only the blocks before
+ *  it are reserved: the file is never longer than the file sent. If the file
+ *  system does not support the operation, nothing is done.
+ *
+ *  Parameters:
+ *  - fd:       File descriptor of the file opened to write
+ *  - number:   Number of packets of the file
+ *
+ *  Return:     Nothing
+ */
+void allocate_file(int fd, long long int number);
+
+
 /*  This function open a file in 'a' mode.
  *
  *  Parameters:
@@ -127,6 +153,19 @@ void fclose_file(FILE *fp);
 unsigned long long get_dimension(const char *f);
 
 
+/*  This function returns the time of the last modification of a file. It is
+ *  the identity of a file sent by a GET or a PUT: a partial copy of the file
+ *  is resumed only if the file was not modified in the meantime (see
+ *  'checkpoint.h').
+ *
+ *  Parameters:
+ *  - f:        The path of the file
+ *
+ *  Return:     The time of the last modification, in nanoseconds since the Epoch
+ */
+long long int get_modification_time(const char *f);
+
+
 /*  This function allows to calculate the number of packets needed to
  *  send a file, knowing its dimension in bytes. This function used the macro
  *  MAX_BLOCK_SIZE in 'settings.h' to calculate the number of pkts.
@@ -139,6 +178,29 @@ unsigned long long get_dimension(const char *f);
 unsigned long long int get_number(unsigned long long size);
 
 
+/*  This function calculates the range of blocks transferred by a stream, when
+ *  the packets from 'first' to 'last' are split into 'streams' streams (see
+ *  TRANSFER_STREAMS in 'settings.h'). The ranges are contiguous, and their
+ *  sizes differ at most by one packet. The client and the server use this
+ *  function to agree on the ranges without sending them.
+ *
+ *  Parameters:
+ *  - first:        Sequence number of the first packet to transfer (1, unless
+ *                  a transfer is resumed, see 'checkpoint.h')
+ *  - last:         Sequence number of the last packet to transfer (the number
+ *                  of packets of the file, see 'get_number()')
+ *  - streams:      Number of streams (not greater than the packets to transfer,
+ *                  if there are any)
+ *  - index:        Index of the stream, from 0 to streams - 1
+ *  - range_first:  Where the sequence number of the first packet of the range is saved
+ *  - range_last:   Where the sequence number of the last packet of the range is saved
+ *                  (range_first - 1 if the range is empty)
+ *
+ *  Return:         Nothing
+ */
+void get_stream_range(long long int first, long long int last, int streams, int index, long long int *range_first, long long int *range_last);
+
+
 /*  This function search if a file already exists, and if it exists return an
  *  alternative name for save new file.
  *
@@ -190,7 +252,13 @@ void msleep(int msec);
 int read_operation(char *line);
 
 
-/*  This function sends a packet on the network through 'sendto()' function
+/*  This function sends a packet on the network through 'sendmsg()' function.
+ *  The header is written with 'packet_serialize_header()' (see 'packet.h'), and
+ *  it is sent together with the bytes really used of the payload, without
+ *  copying them: the payload can be in the 'data' field or in a file mapped in
+ *  memory.
+ *  On a non-blocking socket, a datagram that can not be queued is dropped, as
+ *  if it was lost by the network.
  *
  *  Parameters:
  *  - sockfd:       Socket file descriptor
@@ -203,27 +271,94 @@ void send_pkt(int sockfd, struct packet *pkt, struct sockaddr_in addr);
 
 
 /*  This function allow to receive a packet from the network through 'recvfrom()'
- *  function.
+ *  function. The datagram is read with 'packet_deserialize()' (see 'packet.h');
+ *  malformed datagrams are discarded, and the function waits for the next one.
  *
  *  Parameters:
  *  - sockfd:       Socket file descriptor
+ *  - pool:         'packet_pool' from which the packet is taken (if NULL, the
+ *                  packet is allocated with 'malloc()')
  +  - addr:         Addres for receiving packet
  *  - len:          SIZE OF ADDRESS
  *
  *  Return:         A 'packet' data structure filled with the data received
  *                  from the network
  */
-struct packet *recv_pkt(int sockfd, struct sockaddr_in *addr, socklen_t *len);
+struct packet *recv_pkt(int sockfd, struct packet_pool *pool, struct sockaddr_in *addr, socklen_t *len);
 
 
-/*  this function sorts all the elements in a 'window' data structure
+/*  This function sends many packets with as few 'sendmmsg()' calls as possible,
+ *  up to IO_BATCH_SIZE (see 'settings.h') datagrams for each call. Like in
+ *  'send_pkt()', the payloads are not copied. If only a
+ *  part of a batch is sent, the rest is sent with the next call. If the kernel
+ *  does not support 'sendmmsg()', the packets are sent one by one. On a
+ *  non-blocking socket, the datagrams that can not be queued are dropped.
  *
  *  Parameters:
- *  - w:            'window' data structure to be sorted
+ *  - sockfd:       Socket file descriptor
+ *  - pkts:         Array of the packets to be send
+ *  - n:            Number of packets in 'pkts'
+ *  - addr:         Addres for sending packets
  *
  *  Return:         Nothing
  */
-void sort_window(struct window *w);
+void send_pkts(int sockfd, struct packet **pkts, int n, struct sockaddr_in addr);
+
+
+/*  This function receives with a single 'recvmmsg()' call all the datagrams
+ *  ready on the socket, up to 'max' (and up to IO_BATCH_SIZE). It waits until
+ *  at least one valid datagram is received; malformed datagrams are discarded.
+ *  If the kernel does not support 'recvmmsg()', only one packet is received
+ *  with 'recv_pkt()'.
+ *
+ *  Parameters:
+ *  - sockfd:       Socket file descriptor
+ *  - pool:         'packet_pool' from which the packets are taken (can be NULL)
+ *  - pkts:         Array filled with the packets received
+ *  - max:          Number of slots in 'pkts'
+ *  - addr:         Address of the sender of the last packet (can be NULL)
+ *  - len:          SIZE OF ADDRESS (can be NULL)
+ *
+ *  Return:         Number of packets written in 'pkts' (at least 1). On a
+ *                  non-blocking socket, 0 if there are no datagrams ready
+ */
+int recv_pkts(int sockfd, struct packet_pool *pool, struct packet **pkts, int max, struct sockaddr_in *addr, socklen_t *len);
+
+
+/*  This function is like 'recv_pkts()', but it returns the address of the sender
+ *  of each packet: it is used by the event-driven server (see 'event_server.h'),
+ *  that receives the packets of many clients on the same socket.
+ *
+ *  Parameters:
+ *  - sockfd:       Socket file descriptor
+ *  - pool:         'packet_pool' from which the packets are taken (can be NULL)
+ *  - pkts:         Array filled with the packets received
+ *  - addrs:        Array filled with the address of the sender of each packet
+ *  - max:          Number of slots in 'pkts' and 'addrs'
+ *
+ *  Return:         Number of packets written in 'pkts' (0 on a non-blocking
+ *                  socket without datagrams ready)
+ */
+int recv_pkts_from(int sockfd, struct packet_pool *pool, struct packet **pkts, struct sockaddr_in *addrs, int max);
+
+
+/*  This function waits, at most 'usec' microseconds, until a datagram can be
+ *  read from a socket. It is used to receive packets with a deadline (see the
+ *  delayed ACKs in 'receive_file()' in 'get.c').
+ *
+ *  Parameters:
+ *  - sockfd:       Socket file descriptor
+ *  - usec:         Maximum waiting time in usecs
+ *
+ *  Return:         1 if a datagram is ready, 0 if the time has expired
+ */
+int wait_pkt(int sockfd, long long int usec);
+
+
+/*  This function returns the current time of CLOCK_MONOTONIC in usecs. Unlike
+ *  'gettimeofday()', it is not affected by changes of the system clock.
+ */
+long long int get_monotonic_usec();
 
 
 /*  This function simulates packet loss. This function is related to
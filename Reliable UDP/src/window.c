@@ -34,7 +34,7 @@ struct window *new_window(int dim) {
         exit(EXIT_FAILURE);
     }
     
-    w->buffer = malloc(sizeof(struct packet) * dim);    //allocate memory for circular array
+    w->buffer = malloc(sizeof(struct packet *) * dim);  //allocate memory for circular array
     if (w->buffer == NULL) {
         fprintf(stderr, "Error in new_window(): cannot allocate memory for buffer\n");
         exit(EXIT_FAILURE);
@@ -69,7 +69,7 @@ int window_add_pkt(struct window *w, struct packet *pkt) {
     if (window_is_full(w) == 1)
         return 1;
     else {
-        w->buffer[w->E] = *pkt;         //Add a packet in position 'E'
+        w->buffer[w->E] = pkt;          //Add a packet in position 'E'
         w->E = (w->E + 1) % w->dim;     //Move 'E' of one position
         w->num++;                       //Update numbers of pkts in 'window'
         return 0;
@@ -82,7 +82,7 @@ struct packet *window_get_pkt(struct window *w) {
     if (window_is_empty(w) == 1)
         return NULL;
     else {
-        pkt = &w->buffer[w->S];         //Get packet from position 'S'
+        pkt = w->buffer[w->S];          //Get packet from position 'S'
         w->S = (w->S + 1) % w->dim;     //Move 'S' of one position
         w->num--;                       //Update numbers of pkts in 'window'
         return pkt;
@@ -90,30 +90,27 @@ struct packet *window_get_pkt(struct window *w) {
 }
 
 struct packet *window_search_by_seq(struct window *w, long long int seq) {
-    struct packet *pkt = NULL;
-    int nE;
-    int nS;
+    struct packet *pkt;
+    long long int offset;
+    int slot;
     
     if (window_is_empty(w) == 1)
         return NULL;
-    else {
-        nE = w->E;                       //Save the indexes value to restore it at the end
-        nS = w->S;                       //
-        
-        while (window_is_empty(w) == 0) {//Search in the circular buffer
-            pkt = window_get_pkt(w);     //the pkt with sequence number == seq
-            if (pkt->seq == seq)         //
-                break;
-        }
-        
-        w->E = nE;                       //Restore old values
-        w->S = nS;                       //
-
-        if (pkt != NULL && pkt->seq != seq)
-            return NULL;
-        
-        return pkt;
-    }
+    
+    //The packets in the window have contiguous sequence numbers, starting from
+    //the one in position 'S'. So, the slot of 'seq' is at 'offset' positions from 'S'
+    offset = seq - w->buffer[w->S]->seq;
+    if (offset < 0 || offset >= (w->E - w->S + w->dim) % w->dim)
+        return NULL;                     //'seq' is out of the window
+    
+    slot = (int) ((w->S + offset) % w->dim);
+    pkt = w->buffer[slot];
+    
+    //Validity check: the slot must contain the packet with sequence number == seq
+    if (pkt->seq != seq)
+        return NULL;
+    
+    return pkt;
 }
 
 void window_delete(struct window *w) {
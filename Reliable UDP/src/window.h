@@ -35,6 +35,9 @@
 //  'window_controller'. The data structure 'packet' is the basic unit with
 //  which 'window' interacts. In fact 'packet' is in the lower layer of
 //  the architecture as 'time_data'.
+//  The 'window' does not copy the packets: each slot contains only a pointer
+//  to a packet taken from a 'packet_pool' (see 'packet_pool.h'), so adding,
+//  getting and reordering packets never moves their data.
 
 
 #ifndef __Reliable_UDP__window__
@@ -49,7 +52,7 @@ struct window {
     int E;                  //Index: first position free
     int S;                  //Index: first position full
     int dim;                //Dimension of the array
-    struct packet *buffer;  //Array of 'packet' structures
+    struct packet **buffer; //Array of pointers to 'packet' structures
     int num;                //Number of 'packet' currently in the buffer
 };
 
@@ -64,7 +67,8 @@ struct window {
 struct window *new_window(int dim);
 
 
-/*  This function adds a new 'packet' into a 'window'.
+/*  This function adds a new 'packet' into a 'window'. Only the pointer is
+ *  saved, so 'pkt' must remain valid until it is removed from the 'window'.
  *  This operation involves moving the index 'E' of one position.
  *
  *  Parameters:
@@ -90,8 +94,10 @@ struct packet *window_get_pkt(struct window *w);
 
 
 /*  This function allows to search a specific 'packet', identified by its
- *  sequence number, into the circular array. At the end of this operation,
- *  the indexes are reset to their previous values.
+ *  sequence number, into the circular array. The packets are added in the
+ *  'window' with contiguous sequence numbers, so the slot of 'seq' is
+ *  calculated directly from the sequence number of the packet in position 'S',
+ *  in constant time. The indexes are not modified.
  *
  *  Parameters:
  *  - w:        Pointer to 'window' through wich execute the operation
@@ -103,7 +109,8 @@ struct packet *window_get_pkt(struct window *w);
 struct packet *window_search_by_seq(struct window *w, long long int seq);
 
 
-/*  This function frees all memory occupied by a 'window'
+/*  This function frees all memory occupied by a 'window'. The packets are
+ *  not deleted.
  *
  *  Parameters:
  *  - w:        Pointer to 'window' through wich execute the operation
@@ -25,7 +25,7 @@
 
 #include "window_controller.h"
 
-struct window_controller *new_window_controller(int dim, struct time_controller *tc, int sockfd, struct sockaddr_in addr, int output) {
+struct window_controller *new_window_controller(int dim, struct time_controller *tc, int sockfd, struct sockaddr_in addr, int output, struct packet_pool *pool, int cc) {
     struct window_controller *wc;
     
     wc = malloc(sizeof(struct window_controller));
@@ -33,152 +33,280 @@ struct window_controller *new_window_controller(int dim, struct time_controller
         fprintf(stderr, "Error in new_window_controller(): cannot allocate memory for window_controller\n");
         exit(EXIT_FAILURE);
     }
-    //Allocate memory for sliding window
-    wc->w = new_window(dim);
+    //Allocate memory for sliding window: the sender needs a 'window' of contiguous
+    //packets, the receiver a 'reorder_buffer' of the packets received, starting
+    //from the first packet
+    if (tc != NULL) {
+        wc->w = new_window(dim);
+        wc->rb = NULL;
+        wc->cc = new_congestion_control(cc, dim - 1);
+        wc->pacer = new_pacer(PACING_MAX_BURST);
+        wc->rto = new_rto_estimator();
+    }
+    else {
+        wc->w = NULL;
+        wc->rb = new_reorder_buffer(dim, 1);
+        wc->cc = NULL;
+        wc->pacer = NULL;
+        wc->rto = NULL;
+    }
     //Initialize mutex
-    if(pthread_mutex_init(&wc->MTX, NULL) != 0 || pthread_mutex_init(&wc->m_zero, NULL) != 0) {
+    if(pthread_mutex_init(&wc->MTX, NULL) != 0) {
         fprintf(stderr, "Error in newwindow_controller(): cannot initialize mutex\n");
         exit(EXIT_FAILURE);
     }
-    //Initialize conditions
-    if (pthread_cond_init((&wc->empty), NULL) != 0 || pthread_cond_init(&wc->full, NULL) != 0 ||
-        pthread_cond_init((&wc->zero), NULL)) {
-        fprintf(stderr, "Error in new_window_controller(): cannot create conditions\n");
-        exit(EXIT_FAILURE);
-    }
 
     wc->tc = tc;
-    wc->dynamicTimeout.tv_sec = 0;  //Timeout is 0 because it is setted in...
-    wc->dynamicTimeout.tv_usec = 0; //...window_controller_add_packet()
+    wc->pool = pool;
     wc->addr = addr;
     wc->sockfd = sockfd;
     wc->output = output;
+    wc->io = NULL;
+    wc->last_cumulative = 0;
+    wc->dupacks = 0;
+    wc->high_rxt = 0;
+    wc->highest = 0;
+    wc->high_nack = 0;
+    wc->nack_base = 0;
+    wc->nack_time = 0;
+    wc->nacks = 0;
+    wc->conn = 0;
     
     return wc;
 }
 
+void window_controller_start_at(struct window_controller *wc, long long int first) {
+    int dim;
+    
+    get_mutex(&wc->MTX);
+    //The receiver marks the packets received starting from 'first'
+    if (wc->rb != NULL) {
+        dim = wc->rb->dim;
+        reorder_buffer_delete(wc->rb);
+        wc->rb = new_reorder_buffer(dim, first);
+    }
+    //For the sender, all the packets before 'first' are already acked
+    wc->last_cumulative = first - 1;
+    wc->high_rxt = first - 1;
+    //For the receiver, there are no holes before 'first'
+    wc->highest = first - 1;
+    wc->high_nack = first - 1;
+    release_mutex(&wc->MTX);
+}
+
 
-int window_controller_is_full(struct window_controller *wc) {
+int window_controller_in_window(struct window_controller *wc, long long int seq) {
     get_mutex(&wc->MTX);
-    int res = window_is_full(wc->w);    //res = 1 if window is full, otherwise 0
+    int res = reorder_buffer_in_range(wc->rb, seq);
+    release_mutex(&wc->MTX);
+    return res;
+}
+
+int window_controller_is_received(struct window_controller *wc, long long int seq) {
+    get_mutex(&wc->MTX);
+    //Written packets are before 'base', the others are marked in the bitmap
+    int res = (seq < wc->rb->base || reorder_buffer_contains(wc->rb, seq) == 1) ? 1 : 0;
     release_mutex(&wc->MTX);
     return res;
 }
 
 int window_controller_is_empty(struct window_controller *wc) {
+    int res;
     get_mutex(&wc->MTX);
-    int res = window_is_empty(wc->w);   //res = 1 if window is empty, otherwise 0
+    if (wc->rb != NULL)
+        res = reorder_buffer_is_empty(wc->rb);
+    else
+        res = window_is_empty(wc->w);   //res = 1 if window is empty, otherwise 0
     release_mutex(&wc->MTX);
     return res;
 }
 
+/*  Number of packets that the sender can still send: the free slots of the
+ *  'window', limited by the congestion window. It must be called with the mutex.
+ */
+static int free_slots(struct window_controller *wc) {
+    int k = congestion_control_window(wc->cc) - wc->w->num;
+    int free = wc->w->dim - 1 - wc->w->num;
+    return k < free ? k : free;
+}
+
+/*  Update the rate of the 'pacer': a congestion window for each RTT, faster in
+ *  slow start to let the window grow. Without any RTT sample, only PACING_MAX_RATE
+ *  limits the rate. It must be called with the mutex.
+ */
+static void update_pacing_rate(struct window_controller *wc) {
+    double rate = 0;
+    
+    if (rto_srtt(wc->rto) > 0) {
+        rate = congestion_control_window(wc->cc) * 1000000000.0 / rto_srtt(wc->rto);
+        rate *= (wc->cc->cwnd < wc->cc->ssthresh) ? 2 : 1.25;
+    }
+    if (PACING_MAX_RATE > 0 && (rate == 0 || rate > PACING_MAX_RATE))
+        rate = PACING_MAX_RATE;
+    pacer_set_rate(wc->pacer, rate);
+}
+
+int window_controller_can_send(struct window_controller *wc) {
+    int k, tokens;
+    
+    get_mutex(&wc->MTX);
+    k = free_slots(wc);
+    //The tokens grow with time: read them once, or 'k' could exceed the free slots
+    tokens = pacer_available(wc->pacer);
+    if (k > tokens)
+        k = tokens;
+    release_mutex(&wc->MTX);
+    
+    return k > 0 ? k : 0;
+}
+
+long long int window_controller_send_delay(struct window_controller *wc) {
+    long long int res;
+    
+    get_mutex(&wc->MTX);
+    res = free_slots(wc) > 0 ? pacer_delay(wc->pacer) : -1;
+    release_mutex(&wc->MTX);
+    
+    return res;
+}
+
+/*  Set the timeout of a packet just sent and add its timer into the 'timer_wheel'.
+ *  It receives the 'time_data' of the packet, because the packet can be acked
+ *  and returned to the pool as soon as the mutex is released.
+ */
+static void start_packet_timer(struct window_controller *wc, struct time_data *td) {
+    //Add the 'time_data' data structure included in the pkt just added into
+    //the 'timer_wheel' using this function from 'time_controller'
+    time_controller_add_new_timer(td, wc->tc);
+}
+
 void window_controller_add_packet(struct window_controller *wc, struct packet *pkt) {
     
+    if (wc->pacer != NULL)
+        pacer_wait(wc->pacer);
+    
     get_mutex(&wc->MTX);    //get mutex
 
-    //Wait until at least one slot is free into sliding window
-    while (window_is_full(wc->w) == 1)
-        pthread_cond_wait(&wc->full, &wc->MTX);
-    
+    //The caller checks 'window_controller_can_send()' first, and only its own
+    //thread frees the slots: a full window is never waited (the slot of each
+    //packet of the 'reorder_buffer' is always free)
+    if (wc->w != NULL && free_slots(wc) <= 0) {
+        fprintf(stderr, "Error in window_controller_add_packet(): no free slot in the window\n");
+        exit(EXIT_FAILURE);
+    }
     
     //If this function is used by sender process, then tc != NULL
     //The sender process needs a 'time_controller' data structure
     if (wc->tc != NULL) {
+        pkt->conn = wc->conn;
         send_pkt(wc->sockfd, pkt, wc->addr); //send the pkt
+        pkt->td->time_send = get_monotonic_nsec();
+        pkt->td->timeout = rto_get(wc->rto); //the timeout calculated from the RTT
         window_add_pkt(wc->w, pkt);          //add the pkt into sliding window
-        pthread_cond_signal(&wc->empty);     //send a signal to all pending processes
-                                             //suspended on condition 'empty'
+        pacer_consume(wc->pacer, 1);
+        update_pacing_rate(wc);
+        struct time_data *td = pkt->td;
         release_mutex(&wc->MTX);             //release mutex
-    
-        //If it did not receive any ACK, the timeout is configured with its
-        //default value: DEFAULT_TIMEOUT_SEC and DEFAULT_TIMEOUT_USEC in 'settings.h'
-        if (wc->dynamicTimeout.tv_sec == 0 && wc->dynamicTimeout.tv_usec == 0) {
-            pkt->td->timeout.tv_sec = DEFAULT_TIMEOUT_SEC;
-            pkt->td->timeout.tv_usec = DEFAULT_TIMEOUT_USEC;
-        }
-        //If it did receive at least one ACK, use the dynamic timeout value
-        else {
-            pkt->td->timeout.tv_sec = wc->dynamicTimeout.tv_sec;
-            pkt->td->timeout.tv_usec = wc->dynamicTimeout.tv_usec;
-        }
-        //Add the 'time_data' data structure included in the pkt just added into
-        //the 'timer_wheel' using this function from 'time_controller'
-        time_controller_add_new_timer(pkt->td, wc->tc);
+        
+        start_packet_timer(wc, td);
     }
     
     //If tc == NULL, then this function is used by the receiver process.
     //The receiver process doesn't need a 'time_controller' data structure
+    //The packet is written at its own offset, even if the previous ones are
+    //missing, and only marked as received: nothing is sorted or buffered
     else {
-        window_add_pkt(wc->w, pkt);         //add the pkt into sliding window
-        if (wc->sockfd != -5)               //for debug only!
-            sort_window(wc->w);             //sort the sliding window
+        if (reorder_buffer_mark(wc->rb, pkt->seq) != 0) {
+            fprintf(stderr, "Error in window_controller_add_packet(): packet %lld out of the window\n", pkt->seq);
+            exit(EXIT_FAILURE);
+        }
+        //The packets missing before the highest one received are holes
+        if (pkt->seq > wc->highest)
+            wc->highest = pkt->seq;
         release_mutex(&wc->MTX);            //release mutex
+        
+        off_t offset = (off_t) (pkt->seq - 1) * MAX_BLOCK_SIZE;
+        //With an io_uring the write is only queued: the 'io_engine' returns
+        //the packet to the pool when the write is completed
+        if (wc->io != NULL) {
+            io_engine_write(wc->io, wc->output, pkt, offset);
+            return;
+        }
+        size_t length = packet_payload_length(pkt);
+        ssize_t m = pwrite(wc->output, packet_payload(pkt), length, offset);
+        if (m == -1 || (size_t) m != length) {
+            perror("pwrite() in window_controller_add_packet()");
+            exit(EXIT_FAILURE);
+        }
+        packet_pool_put(wc->pool, pkt);
     }
 }
 
 
-long long int write_contiguous(struct window_controller *wc, long long int min) {
-    long long int last = min;
-    int deleted = 0;                    //This variables identifies if a pkt was written. It is used
-                                        //to send signals to the condition 'full'
-    get_mutex(&wc->MTX);
-    
-    struct packet *pkt;
-    ssize_t m;
-    int nE = wc->w->E;                  //Save the indexes to restore them at the end
-    int nS = wc->w->S;                  //
+void window_controller_add_packets(struct window_controller *wc, struct packet **pkts, int n) {
+    struct time_data *tds[IO_BATCH_SIZE];
+    long long int now;
+    int i, k, tokens;
     
-    //Continuously until the window is empty
-    while (window_is_empty(wc->w) == 0) {
-        pkt = window_get_pkt(wc->w);    //get first pkt avaible
+    while (n > 0) {
+        //Wait for the 'pacer' without the mutex, so the ACKs are not delayed
+        pacer_wait(wc->pacer);
         
-        //If seq number is equal to seq that i need...
-        if (pkt->seq == last) {
-            nE = wc->w->E;              //update the indexes...
-            nS = wc->w->S;              //...and write data
-            
-            m = write(wc->output, (void *) pkt->data, pkt->dimension);
-            if (m == -1 || (size_t) m != pkt->dimension) {
-                fprintf(stderr, "Error in writeContiguous(): cannot write on output file\n");
-                exit(EXIT_FAILURE);
-            }
-            last++;                     //update 'last'
-            deleted = 1;                //set 'deleted' = 1
-            //free(pkt);
+        get_mutex(&wc->MTX);
+        
+        //The caller checks 'window_controller_can_send()' first: a full window
+        //is never waited, because only the caller frees the slots
+        if ((k = free_slots(wc)) <= 0) {
+            fprintf(stderr, "Error in window_controller_add_packets(): no free slot in the window\n");
+            exit(EXIT_FAILURE);
         }
-        //If seq number is not equal to seq that i need...
-        else {
-            wc->w->E = nE;              //restore indexes...
-            wc->w->S = nS;              //
-            break;                      //...and break
+        
+        //Send and add as many packets as allowed
+        update_pacing_rate(wc);
+        tokens = pacer_available(wc->pacer);
+        if (k > tokens)
+            k = tokens;
+        if (k > n)
+            k = n;
+        if (k > IO_BATCH_SIZE)
+            k = IO_BATCH_SIZE;
+        for (i = 0; i < k; ++i)
+            pkts[i]->conn = wc->conn;
+        send_pkts(wc->sockfd, pkts, k, wc->addr);
+        now = get_monotonic_nsec();
+        for (i = 0; i < k; ++i) {
+            pkts[i]->td->time_send = now;
+            pkts[i]->td->timeout = rto_get(wc->rto);
+            window_add_pkt(wc->w, pkts[i]);
+            tds[i] = pkts[i]->td;
         }
+        pacer_consume(wc->pacer, k);
+        release_mutex(&wc->MTX);
         
-        //If at least 1 pkt was written, send a signal to all processes pending
-        //in condition 'full'
-        if (deleted == 1)
-            pthread_cond_signal(&wc->full);
+        for (i = 0; i < k; ++i)
+            start_packet_timer(wc, tds[i]);
+        pkts += k;
+        n -= k;
     }
-    wc->w->E = nE;
-    wc->w->S = nS;
+}
+
+
+long long int window_controller_advance(struct window_controller *wc) {
+    get_mutex(&wc->MTX);
     
-    release_mutex(&wc->MTX);            //release mutex
+    //The packets are already written: only move the window forward
+    long long int next = reorder_buffer_advance(wc->rb);
     
-    //At the end, if the sliding window is empty, send a signal to all processes
-    //pending on condition 'full'
-    if (window_controller_is_empty(wc) == 1)
-        pthread_cond_signal(&wc->zero);
+    release_mutex(&wc->MTX);            //release mutex
     
-    return last;                        //return last seq. number
+    return next;
 }
 
 
-void delete_contiguous(struct window_controller *wc) {
-    get_mutex(&wc->MTX);                //get mutex
-    
-    //If window is empty, wait for condition 'empty'
-    while (window_is_empty(wc->w) == 1)
-        pthread_cond_wait(&wc->empty, &wc->MTX);
-    
+/*  Delete all the contiguous acked packets at the beginning of the window.
+ *  It must be called with the mutex.
+ */
+static void delete_acked(struct window_controller *wc) {
     struct packet *pkt = NULL;
     int nE = wc->w->E;                  //Save the indexes to restore them at the end
     int nS = wc->w->S;                  //
@@ -196,75 +324,282 @@ void delete_contiguous(struct window_controller *wc) {
             else {                      //if pkt was acked...
                 nE = wc->w->E;          //...update indexes
                 nS = wc->w->S;          //
-                //free(pkt);            //send a signal
-                pthread_cond_signal(&wc->full);
+                packet_pool_put(wc->pool, pkt);
             }
-            //pthread_cond_signal(&wc->full);
         }
         //free(pkt);
     }
     wc->w->E = nE;
     wc->w->S = nS;
+}
+
+int window_controller_set_ack(struct window_controller *wc, long long int seq) {
+    get_mutex(&wc->MTX);
+    //Search the pkt with sequence number == seq
+    struct packet *pkt = window_search_by_seq(wc->w, seq);
+    
+    if (pkt == NULL) {                                      //If the pkt doesn't exists...
+        release_mutex(&wc->MTX);                            //...release mutex.
+        return 0;                                           //...return 0
+    }
+    
+    //If pkt != NULL, the the packet with sequence number == seq was found
+    else {
+        if (pkt->acked == 0) {
+            pkt->td->time_recv = get_monotonic_nsec();
+            //Karn's rule: the RTT of a packet sent again is not sampled
+            if (pkt->retransmitted == 0)
+                rto_sample(wc->rto, pkt->td->time_recv - pkt->td->time_send);
+            congestion_control_on_ack(wc->cc, 1, rto_srtt(wc->rto) / 1000);
+        }
+        pkt->acked = 1;                                     //set this packet as acked
+        
+        //If this function is used by sender process, then wc->output must be -1
+        if (wc->output == -1)
+            delete_acked(wc);                               //delete all contiguous pkt
+    }
     
     release_mutex(&wc->MTX);
     
-    //At the end, if the sliding window is empty, send a signal to all processes
-    //pending on condition 'full'
-    if (window_controller_is_empty(wc) == 1)
-        pthread_cond_signal(&wc->zero);
+    return 1;
 }
 
-void calculate_dynamic_timeout(struct window_controller *wc) {
-    //estimatedRTT = (1 - alpha) x estimatedRTT + alpha x sampleRTT
-    wc->estimatedRTT = 0.875 * wc->estimatedRTT + 0.125 * wc->sampleRTT;
+
+int window_controller_set_sack(struct window_controller *wc, struct packet *ack) {
+    long long int cumulative = packet_get_cumulative(ack);
+    unsigned char *sack = packet_get_sack(ack);
+    struct packet *pkt;
+    int i, bit, acked = 0;
+    
+    get_mutex(&wc->MTX);
+    
+    //Sample the RTT on the packet that generated the ACK, if it was not acked
+    //before and it was sent only once (Karn's rule)
+    pkt = window_search_by_seq(wc->w, ack->seq);
+    if (pkt != NULL && pkt->acked == 0 && pkt->retransmitted == 0) {
+        pkt->td->time_recv = get_monotonic_nsec();
+        rto_sample(wc->rto, pkt->td->time_recv - pkt->td->time_send);
+    }
     
-    //devRTT = (1 - beta) x devRTT + beta x |sampleRTT - estimatedRTT|
-    wc->devRTT = 0.75 * wc->devRTT + 0.25 * fabsl(wc->sampleRTT - wc->estimatedRTT);
+    //Set as acked all the packets marked in the SACK bitmap
+    for (i = 0; i < SACK_BITMAP_SIZE; ++i) {
+        if (sack[i] == 0)                               //Skip empty bytes
+            continue;
+        for (bit = 0; bit < 8; ++bit) {
+            if ((sack[i] & (1 << bit)) == 0)
+                continue;
+            pkt = window_search_by_seq(wc->w, cumulative + 2 + i * 8 + bit);
+            if (pkt != NULL && pkt->acked == 0) {
+                pkt->acked = 1;
+                acked++;
+            }
+        }
+    }
     
-    //timeout interval = estimatedRTT + 4 x devRTT
-    double timeout = wc->estimatedRTT + 4 * wc->devRTT;
+    //Delete all packets covered by the cumulative ACK and all contiguous acked packets
+    while (window_is_empty(wc->w) == 0) {
+        pkt = wc->w->buffer[wc->w->S];
+        if (pkt->seq <= cumulative) {
+            if (pkt->acked == 0)
+                acked++;
+        }
+        else if (pkt->acked == 0)
+            break;
+        window_get_pkt(wc->w);
+        packet_pool_put(wc->pool, pkt);                 //The packet goes back to the pool
+    }
     
-    long int sec = timeout / 1000000;
+    //Grow the congestion window
+    if (acked > 0)
+        congestion_control_on_ack(wc->cc, acked, rto_srtt(wc->rto) / 1000);
     
-    wc->dynamicTimeout.tv_sec = sec;
-    wc->dynamicTimeout.tv_usec = timeout - sec * 1000000;
+    release_mutex(&wc->MTX);
+    
+    return acked;
 }
 
 
-int window_controller_set_ack(struct window_controller *wc, long long int seq) {
+int window_controller_fast_retransmit(struct window_controller *wc, struct packet *ack) {
+    struct packet *batch[IO_BATCH_SIZE];
+    struct packet *pkt;
+    long long int cumulative = packet_get_cumulative(ack);
+    long long int limit = 0;
+    int i, n = 0, sent = 0, sacked = 0, num;
+    
     get_mutex(&wc->MTX);
-    //Search the pkt with sequence number == seq
-    struct packet *pkt = window_search_by_seq(wc->w, seq);
     
-    if (pkt == NULL) {                                      //If the pkt doesn't exists...
-        release_mutex(&wc->MTX);                            //...release mutex.
-        return 0;                                           //...return 0
+    if (window_is_empty(wc->w) == 1) {
+        wc->dupacks = 0;
+        release_mutex(&wc->MTX);
+        return 0;
     }
     
-    //If pkt != NULL, the the packet with sequence number == seq was found
+    //Count the duplicate ACKs
+    if (cumulative == wc->last_cumulative)
+        wc->dupacks++;
     else {
-        pkt->acked = 1;                                     //set this packet as acked
-        gettimeofday(&pkt->td->time_recv, NULL);
+        wc->last_cumulative = cumulative;
+        wc->dupacks = 0;
+    }
+    
+    //Find the packet with DUPACK_THRESHOLD packets selectively acked after it:
+    //all the packets before it that were not acked are lost
+    num = wc->w->num;
+    for (i = num - 1; i >= 0 && sacked < DUPACK_THRESHOLD; --i) {
+        pkt = wc->w->buffer[(wc->w->S + i) % wc->w->dim];
+        if (pkt->acked == 1 && ++sacked == DUPACK_THRESHOLD)
+            limit = pkt->seq;
+    }
+    //With the duplicate ACKs, the first packet of the window is lost
+    pkt = wc->w->buffer[wc->w->S];
+    if (wc->dupacks >= DUPACK_THRESHOLD && limit <= pkt->seq)
+        limit = pkt->seq + 1;
+    
+    //Send again the lost packets, in order, only once
+    for (i = 0; i < num; ++i) {
+        pkt = wc->w->buffer[(wc->w->S + i) % wc->w->dim];
+        if (pkt->seq >= limit)
+            break;
+        if (pkt->acked == 1 || pkt->seq <= wc->high_rxt)
+            continue;
+        if (sent + n == 0)      //Only one reduction of the congestion window
+            congestion_control_on_loss(wc->cc, pkt->seq, wc->w->buffer[(wc->w->E - 1 + wc->w->dim) % wc->w->dim]->seq);
+        pkt->retransmitted = 1;         //Its RTT is no longer sampled
+        pkt->td->time_send = get_monotonic_nsec();
+        wc->high_rxt = pkt->seq;
+        batch[n++] = pkt;
+        if (n == IO_BATCH_SIZE) {
+            send_pkts(wc->sockfd, batch, n, wc->addr);
+            sent += n;
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        send_pkts(wc->sockfd, batch, n, wc->addr);
+        sent += n;
+    }
+    
+    release_mutex(&wc->MTX);
+    return sent;
+}
 
-        wc->sampleRTT = (pkt->td->time_recv.tv_sec -        //set the new sampleRTT
-                         pkt->td->time_send.tv_sec) *       //using  the arrival time
-                        1000000 +                           //and the send time of
-                        (pkt->td->time_recv.tv_usec -       //the packet
-                        pkt->td->time_send.tv_usec);        //
-        
-        //If this function is used by sender process, then wc->output must be -1
-        if (wc->output == -1) {
-            release_mutex(&wc->MTX);
-            delete_contiguous(wc);                          //delete all contiguous pkt
-            get_mutex(&wc->MTX);
+
+int window_controller_resend_ranges(struct window_controller *wc, struct packet *nack) {
+    struct packet *batch[IO_BATCH_SIZE];
+    struct packet *pkt;
+    long long int first, last, seq, lo, hi, now = get_monotonic_nsec();
+    int i, n = 0, sent = 0;
+    
+    get_mutex(&wc->MTX);
+    
+    if (window_is_empty(wc->w) == 1) {
+        release_mutex(&wc->MTX);
+        return 0;
+    }
+    //Only the packets in the window can be sent again
+    lo = wc->w->buffer[wc->w->S]->seq;
+    hi = wc->w->buffer[(wc->w->E - 1 + wc->w->dim) % wc->w->dim]->seq;
+    
+    for (i = 0; i < (int) nack->dimension; ++i) {
+        packet_get_nack_range(nack, i, &first, &last);
+        for (seq = first > lo ? first : lo; seq <= last && seq <= hi; ++seq) {
+            pkt = window_search_by_seq(wc->w, seq);
+            //A packet already sent again less than a RTT ago can still arrive
+            if (pkt == NULL || pkt->acked == 1 ||
+                (pkt->retransmitted == 1 && now - pkt->td->time_send < rto_srtt(wc->rto)))
+                continue;
+            if (sent + n == 0)  //Only one reduction of the congestion window
+                congestion_control_on_loss(wc->cc, pkt->seq, hi);
+            pkt->retransmitted = 1;     //Its RTT is no longer sampled
+            pkt->td->time_send = now;
+            if (pkt->seq > wc->high_rxt)
+                wc->high_rxt = pkt->seq;
+            batch[n++] = pkt;
+            if (n == IO_BATCH_SIZE) {
+                send_pkts(wc->sockfd, batch, n, wc->addr);
+                sent += n;
+                n = 0;
+            }
         }
     }
+    if (n > 0) {
+        send_pkts(wc->sockfd, batch, n, wc->addr);
+        sent += n;
+    }
+    
+    release_mutex(&wc->MTX);
+    return sent;
+}
 
-    //A new ACK is arrived, so the dynamic timeout must be updated
-    calculate_dynamic_timeout(wc);
+
+void window_controller_fill_sack(struct window_controller *wc, struct packet *ack, long long int min) {
+    int i;
+    
+    packet_set_sack(ack, min - 1);
     
+    get_mutex(&wc->MTX);
+    //Mark all the packets received out of order, waiting in the sliding window
+    for (i = 1; i < wc->rb->dim && wc->rb->num > 0; ++i)
+        if (reorder_buffer_contains(wc->rb, min + i) == 1)
+            packet_sack_mark(ack, min + i);
     release_mutex(&wc->MTX);
-    return 1;
+}
+
+
+int window_controller_fill_nack(struct window_controller *wc, struct packet *nack) {
+    long long int seq, first = -1, missing = -1, now = get_monotonic_usec();
+    int repeat;
+    
+    packet_set_nack(nack);
+    
+    get_mutex(&wc->MTX);
+    //No holes: all the packets up to the highest one received are received
+    if (reorder_buffer_is_empty(wc->rb) == 1) {
+        release_mutex(&wc->MTX);
+        return 0;
+    }
+    //The first packet missing changed: its NACKs are counted again
+    if (wc->rb->base != wc->nack_base) {
+        wc->nack_base = wc->rb->base;
+        wc->nacks = 0;
+    }
+    repeat = wc->nacks < NACK_MAX_REPEATS && now - wc->nack_time >= NACK_INTERVAL_USEC;
+    //No packet received after the last check, and it is not the time to repeat
+    if (wc->highest - 1 <= wc->high_nack && repeat == 0) {
+        release_mutex(&wc->MTX);
+        return 0;
+    }
+    //Search the ranges of packets missing before the highest one received: the
+    //ones after it can still be in flight
+    for (seq = wc->rb->base; seq < wc->highest; ++seq) {
+        if (reorder_buffer_contains(wc->rb, seq) == 0) {
+            if (first == -1)
+                first = seq;                //A new range starts
+        }
+        else if (first != -1) {
+            if (packet_nack_add(nack, first, seq - 1) == 1)
+                break;                      //No more space in the packet
+            missing = seq - 1;
+            first = -1;
+        }
+    }
+    //The last hole ends before the highest packet received
+    if (first != -1 && packet_nack_add(nack, first, wc->highest - 1) == 0)
+        missing = wc->highest - 1;
+    //A hole opened or extended by the packets received after the last check is
+    //requested at once, the others only when it is the time to repeat
+    if (missing > wc->high_nack)
+        wc->nack_time = now;
+    else if (repeat == 1) {
+        wc->nacks++;
+        wc->nack_time = now;
+    }
+    else
+        nack->dimension = 0;
+    wc->high_nack = wc->highest - 1;
+    release_mutex(&wc->MTX);
+    
+    return (int) nack->dimension;
 }
 
 
@@ -285,18 +620,21 @@ int window_controller_resend_packet(struct window_controller *wc, long long int
     //...otherwise
     else {
         pkt->retries = (pkt->retries) + 1;                  //increase retries
-        if (pkt->retries == MAX_RETRIES_SENDING_PKT) {      //control max retries
-            fprintf(stderr, "Generic error: lost connection or line too busy\n");
-            exit(EXIT_FAILURE);
+        if (pkt->retries >= MAX_RETRIES_SENDING_PKT) {      //control max retries
+            release_mutex(&wc->MTX);
+            return 2;
         }
         
+        //The timer expired: the network is congested
+        congestion_control_on_timeout(wc->cc, seq, wc->w->buffer[(wc->w->E - 1 + wc->w->dim) % wc->w->dim]->seq);
+        
         send_pkt(wc->sockfd, pkt, wc->addr);                //resend pkt
+        pkt->retransmitted = 1;                             //Its RTT is no longer sampled
         
-        gettimeofday(&pkt->td->time_send, NULL);            //update send time for pkt
+        pkt->td->time_send = get_monotonic_nsec();          //update send time for pkt
         
-        //Increase the timeout twice
-        pkt->td->timeout.tv_sec = pkt->td->timeout.tv_sec * 2;
-        pkt->td->timeout.tv_usec = pkt->td->timeout.tv_usec * 2;
+        //The timeout is doubled by 'time_controller' on the copy of 'time_data'
+        //kept in its 'timer_wheel', when the timer is added again
         
         release_mutex(&wc->MTX);
         
@@ -306,13 +644,18 @@ int window_controller_resend_packet(struct window_controller *wc, long long int
 
 void window_controller_dispose(struct window_controller *wc) {
     struct packet *pkt = NULL;
-    //Delete all pkt in the window
-    while (window_is_empty(wc->w) == 0) {
-        pkt = window_get_pkt(wc->w);
-        free(pkt);
+    //Return all pkts in the window to the pool (the receiver does not keep them)
+    if (wc->rb != NULL)
+        reorder_buffer_delete(wc->rb);
+    else {
+        while (window_is_empty(wc->w) == 0) {
+            pkt = window_get_pkt(wc->w);
+            packet_pool_put(wc->pool, pkt);
+        }
+        window_delete(wc->w);   //delete window memory
+        congestion_control_delete(wc->cc);
+        pacer_delete(wc->pacer);
+        rto_delete(wc->rto);
     }
-    
-    free(wc->w->buffer);        //delete buffer memory
-    free(wc->w);                //delete window memory
     free(wc);                   //delete window_controller memory
 }
\ No newline at end of file
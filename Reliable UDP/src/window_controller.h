@@ -31,15 +31,22 @@
 //  The major operations that this data structure can execute are:
 //  - add a new packet in window, set a timer for it and send it
 //  - set a packet 'acked' and remove all acked packets in order from the window
-//  - write contiguous packet, starting from a specific sequence number
+//  - write each packet received at its offset in the file, and move the window
+//    over the packets received in order
 //  - resend a packet already added in window, and update retries and timer
+//  - resend the packets that the ACKs show as lost, without waiting for the timer
+//  - request again the ranges of packets missing (NACK), and resend them
+//  - limit the packets in flight with a congestion window ('congestion_control')
+//    and spread them over the RTT ('pacer')
 //  One of the most important feature is the automatic calculation of the timer for
 //  each packet added in the sliding window by 'window_controller_add_packet'.
 //  In fact, for each ACK arrived, a new timer is calculated for the next packets to be send.
-//  The 'sampleRTT' is updated for each ACK arrived, so the timeout can be different
-//  for every packet.
-//  All operations are synchronized with semaphores and condition, to ensuring mutual
-//  exclusion for each process/thread.
+//  The RTT is sampled on each ACK of a packet sent only once (see 'rto.h'), so
+//  the timeout can be different for every packet.
+//  All operations are synchronized with a mutex, to ensuring mutual exclusion
+//  for each process/thread. A single thread owns the sliding window of the
+//  sender (see 'send_range()' in 'put.c'): it adds a packet only when there is
+//  a free slot ('window_controller_can_send()'), so it never waits for one.
 
 
 #ifndef __Reliable_UDP__window_controller__
@@ -47,26 +54,41 @@
 
 
 #include "window.h"
+#include "reorder_buffer.h"
+#include "io_engine.h"
+#include "packet_pool.h"
+#include "congestion_control.h"
+#include "pacer.h"
+#include "rto.h"
 #include "time_controller.h"
 #include "utils.h"
 #include "settings.h"
 
+#include <sys/uio.h>
+
 
 struct window_controller {
-    struct window *w;              //Pointer to a 'window' data structure
-    pthread_mutex_t m_zero;        //Mutex that can be locked whel last pkt is sent
+    struct window *w;              //Pointer to a 'window' data structure (used by the sender, otherwise NULL)
+    struct reorder_buffer *rb;     //Pointer to a 'reorder_buffer' data structure (used by the receiver, otherwise NULL)
     pthread_mutex_t MTX;           //Mutex that can be locked to ensuring mutual exclusion for each process/thread
-    pthread_cond_t full;           //Used to wait until it is free at least one slot in the window
-    pthread_cond_t empty;          //Used to wait until it is full at least one slot in the window
-    pthread_cond_t zero;           //Used to wait until window is empty
     struct time_controller *tc;    //Pointer to a 'time_controller' data structure (can be NULL)
-    struct timeval dynamicTimeout; //Represent the timeout updated for each ACK received (in secs and usecs)
-    long double estimatedRTT;      //Exponential weighted moving average (EWMA) for RTT
-    long double devRTT;            //EWMA for deviance between sampleRTT and estimatedRTT
-    long double sampleRTT;         //Sample of RTT time, updated for each ACK received
+    struct congestion_control *cc; //Congestion control of the sender (NULL for the receiver)
+    struct pacer *pacer;           //Pacing of the new packets sent (NULL for the receiver)
+    long long int last_cumulative; //Last cumulative ACK received by the sender
+    int dupacks;                   //Number of ACKs in a row with the same cumulative ACK
+    long long int high_rxt;        //Highest sequence number sent again by fast retransmit
+    long long int highest;         //Receiver: highest sequence number received
+    long long int high_nack;       //Receiver: packets up to here were checked for holes by 'window_controller_fill_nack()'
+    long long int nack_base;       //Receiver: first packet missing when its NACKs were counted
+    long long int nack_time;       //Receiver: when the last PKT_NACK was prepared (usecs of CLOCK_MONOTONIC)
+    int nacks;                     //Receiver: PKT_NACK repeated for the same first packet missing
+    struct packet_pool *pool;      //Pool of the packets in the window, where they are returned when they leave it
+    struct rto_estimator *rto;     //Timeout calculated from the RTT samples (NULL for the receiver)
     int sockfd;                    //Communication socket
     struct sockaddr_in addr;       //Valid address structure
     int output;                    //File descriptor to writing (can be -1 if you don't have to write file)
+    struct io_engine *io;          //Engine that writes the packets received (NULL to write them with 'pwrite()')
+    unsigned int conn;             //Connection ID put in the packets sent by the sender (0 if not used)
 };
 
 
@@ -85,15 +107,43 @@ struct window_controller {
  *  - output:   File descriptor to write file. It must be -1 if the sender process
  *              is using a 'window_controller', because only receiving process
  *              have to write an output file
+ *  - pool:     The 'packet_pool' from which the packets added in the window are
+ *              taken. The window keeps only pointers to them: each packet is
+ *              returned to the pool when it leaves the window (it is acked by
+ *              the sender process). The receiving process does not keep the
+ *              packets: each one is returned as soon as it is written
+ *  - cc:       The congestion control algorithm used by the sender process
+ *              (see 'congestion_control.h'). It is ignored if tc == NULL
  *
  *  Return:     A pointer to a valid 'window_controller' data structure
  */
-struct window_controller *new_window_controller(int dim, struct time_controller *tc, int sockfd, struct sockaddr_in addr, int output);
+struct window_controller *new_window_controller(int dim, struct time_controller *tc, int sockfd, struct sockaddr_in addr, int output, struct packet_pool *pool, int cc);
+
+
+/*  This function sets the sequence number of the first packet of the transfer,
+ *  that is 1 unless the file is split into many streams (see 'streams.h'): the
+ *  receiver expects it as the first packet, and the sender as the first one that
+ *  can be acked. It must be called before the first packet is added.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - first:    Sequence number of the first packet
+ *
+ *  Return:     Nothing
+ */
+void window_controller_start_at(struct window_controller *wc, long long int first);
 
 
-/*  This function allows to add a packet in the sliding window. The packet will
- *  be added only if window is not full. If it is full, the process will wait
- *  on the condition 'is_full' until a signal will be lauched.
+/*  This function allows to add a packet in the sliding window. The sender
+ *  process must check first that the window has a free slot and that the
+ *  congestion window allows to send ('window_controller_can_send()'): otherwise
+ *  the process exits with an error. The sender process also waits for the
+ *  'pacer', without holding the mutex.
+ *  The receiving process writes the packet in the output file at its own offset
+ *  ((seq - 1) * MAX_BLOCK_SIZE) with 'pwrite()', even if the previous packets are
+ *  still missing, marks it as received and returns it to the 'packet_pool'.
+ *  If the field 'io' is set (see 'io_engine.h'), the write is only queued, and
+ *  the packet is returned to the pool when the write is completed.
  *
  *  Parameters:
  *  - dim:      Pointer to 'window_controller' through wich execute the adding operation
@@ -104,10 +154,51 @@ struct window_controller *new_window_controller(int dim, struct time_controller
 void window_controller_add_packet(struct window_controller *wc, struct packet *pkt);
 
 
+/*  This function is used by the sending process to add many packets in the
+ *  sliding window. The packets are sent together with 'send_pkts()' (see
+ *  'utils.h') and added in the window. They must be no more than the ones
+ *  allowed by 'window_controller_can_send()', as for 'window_controller_add_packet()'.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the adding operation
+ *  - pkts:     Array of the packets that have to be added, with contiguous
+ *              sequence numbers
+ *  - n:        Number of packets in 'pkts'
+ *
+ *  Return:     Nothing
+ */
+void window_controller_add_packets(struct window_controller *wc, struct packet **pkts, int n);
+
+
+/*  This function is used by the sender process when it can not wait (see
+ *  'session.h'): it returns how many packets can be added now with
+ *  'window_controller_add_packets()' without waiting, for the free slots of the
+ *  window, the congestion window and the 'pacer'.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *
+ *  Return:     The number of packets that can be sent now
+ */
+int window_controller_can_send(struct window_controller *wc);
+
+
+/*  This function returns how long the sender process has to wait for the
+ *  'pacer' before sending a new packet.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *
+ *  Return:     The time to wait in usecs (0 if a packet can be sent now), -1 if
+ *              the window is full: the sender has to wait for an ACK
+ */
+long long int window_controller_send_delay(struct window_controller *wc);
+
+
 /*  This function can set a specific packet (already added in sliding window) as acked.
- *  Also, if this function is used by sender process, all contiguous packets
- *  already added will be deleted. Otherwise, if this function is used by
- *  receiving process, the dynamic timout will be updated.
+ *  It is used only by the sending process: all contiguous packets already acked
+ *  are deleted, and the RTT of the packet (if it was not sent again) is sampled
+ *  by the 'rto' estimator (see 'rto.h').
  *
  *  Parameters:
  *  - wc:       Pointer to 'window_controller' through wich execute the operation
@@ -118,15 +209,119 @@ void window_controller_add_packet(struct window_controller *wc, struct packet *p
 int window_controller_set_ack(struct window_controller *wc, long long int seq);
 
 
-/*  This function checks if the sliding window ('window') included in the
- *  'window_controller' data structure is full.
+/*  This function processes a cumulative and selective ACK (a packet with
+ *  PKT_FLAG_SACK, see 'packet.h') with a single lock of the mutex. All the
+ *  packets with sequence number <= cumulative ACK, and all the packets marked
+ *  in the SACK bitmap, are set as acked, and all contiguous acked packets are
+ *  deleted from the sliding window. The RTT is sampled on the packet that
+ *  generated the ACK ('seq' of the ACK), and the dynamic timeout is updated.
+ *  This function is used only by the sender process.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - ack:      The ACK received
+ *
+ *  Return:     The number of packets acked for the first time by this ACK
+ */
+int window_controller_set_sack(struct window_controller *wc, struct packet *ack);
+
+
+/*  This function is used by the sender process, after 'window_controller_set_sack()',
+ *  to detect the packets lost from the order of the ACKs and send them again
+ *  immediately (fast retransmit), without waiting for their timeout. A packet
+ *  not yet acked is lost if:
+ *  - it is the first packet of the window, and DUPACK_THRESHOLD ACKs in a row
+ *    did not move the cumulative ACK (duplicate ACKs), or
+ *  - at least DUPACK_THRESHOLD packets sent after it were selectively acked
+ *    (a hole in the SACK bitmap)
+ *  Each packet is sent again by this function only once: if it is lost again,
+ *  its timer will expire. The congestion control is informed of the loss.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - ack:      The ACK received (a packet with PKT_FLAG_SACK)
+ *
+ *  Return:     The number of packets sent again
+ */
+int window_controller_fast_retransmit(struct window_controller *wc, struct packet *ack);
+
+
+/*  This function is used by the sender process when a PKT_NACK arrives: all the
+ *  packets of its ranges that are in the sliding window and not yet acked are
+ *  sent again in batches with 'send_pkts()'. A packet already sent again less
+ *  than a smoothed RTT ago is skipped, because it can still arrive: so the
+ *  NACKs repeated for the same range do not multiply the retransmissions. The
+ *  congestion control is informed of the loss once for each NACK.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - nack:     The PKT_NACK received (see 'packet_set_nack()' in 'packet.h')
+ *
+ *  Return:     The number of packets sent again
+ */
+int window_controller_resend_ranges(struct window_controller *wc, struct packet *nack);
+
+
+/*  This function is used by the receiving process to prepare a cumulative and
+ *  selective ACK. The cumulative ACK is the last sequence number received in
+ *  order, and all the packets received after it are marked in the SACK bitmap.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - ack:      The ACK to fill
+ *  - min:      The next sequence number that has to be received (see 'window_controller_advance()')
+ *
+ *  Return:     Nothing
+ */
+void window_controller_fill_sack(struct window_controller *wc, struct packet *ack, long long int min);
+
+
+/*  This function is used by the receiving process after each packet received,
+ *  to prepare a PKT_NACK with the ranges of the packets missing before the
+ *  highest one received (at most NACK_MAX_RANGES, the first ones): the packets
+ *  after it can still be in flight. The packets already received are kept:
+ *  only the missing ones are requested again. The PKT_NACK has to be sent only
+ *  if a packet received out of order opened or extended a hole, or, while the
+ *  holes remain, if the last one was sent at least NACK_INTERVAL_USEC ago (at
+ *  most NACK_MAX_REPEATS times for the same first packet missing, see
+ *  'settings.h'). Otherwise, the lost packets are sent again by the timeout of
+ *  the sender.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - nack:     The packet to fill
+ *
+ *  Return:     The number of ranges in 'nack' (0 if it has not to be sent)
+ */
+int window_controller_fill_nack(struct window_controller *wc, struct packet *nack);
+
+
+/*  This function is used by the receiving process to check if a packet can be
+ *  added in the sliding window, that is if its sequence number is in the range
+ *  of the 'reorder_buffer'.
+ *
+ *  Parameters:
+ *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - seq:      Sequence number of the packet received
+ *
+ *  Return:     1 if the packet can be added, otherwise 0
+ */
+int window_controller_in_window(struct window_controller *wc, long long int seq);
+
+
+/*  This function is used by the receiving process to check if a packet was
+ *  already received. The set of the packets received is not saved for the
+ *  whole file: all the packets before the first one missing were received,
+ *  and the others are marked in the 'reorder_buffer'. So the memory used
+ *  depends only on the dimension of the window.
  *
  *  Parameters:
  *  - wc:       Pointer to 'window_controller' through wich execute the operation
+ *  - seq:      Sequence number of the packet received
  *
- *  Return:     1 if sliding window is full, otherwise 0
+ *  Return:     1 if the packet was already received, otherwise 0
  */
-int window_controller_is_full(struct window_controller *wc);
+int window_controller_is_received(struct window_controller *wc, long long int seq);
 
 
 /*  This function checks if the sliding window ('window') included in the
@@ -146,8 +341,9 @@ int window_controller_is_empty(struct window_controller *wc);
  *  timer. In particular, if the 'retries' of a packet is greaten than
  *  MAX_RETRIES_SENDING_PKT (macro in settings.h), then this means that the line 
  *  can be very busy (loss percentage setted too high in settings.h), and so
- *  the communication is stopped. Also, when a packet is re-sent, its timeout
- *  is increased twice, in according to the fact that the line can be very busy.
+ *  the communication have to be stopped by the caller. Also, when a packet is re-sent, its timeout
+ *  is doubled by 'time_controller' when its timer is added again, in according
+ *  to the fact that the line can be very busy.
  *  This function is used automatically by 'time_controller' when a timeout
  *  has expired.
  *
@@ -155,24 +351,24 @@ int window_controller_is_empty(struct window_controller *wc);
  *  - wc:       Pointer to 'window_controller' through wich execute the operation
  *  - seq:      Sequence number of the packet that have to be resend
  *
- *  Return:     1 if the packet was not found into sliding window, otherwise 0
+ *  Return:     0 on success, 1 if the packet was not found into sliding window,
+ *              2 if the packet was already sent MAX_RETRIES_SENDING_PKT times
+ *              (it is not sent again: the connection is lost)
  */
 int window_controller_resend_packet(struct window_controller *wc, long long int seq);
 
 
-/*  This function writes all contiguous packets into sliding window in a file,
- *  starting from a specific sequence number. The file that have to be written
- *  is identified by file descriptor 'output' saved into 'window_controller'
- *  data structure.
+/*  This function is used by the receiving process to move the sliding window
+ *  over all the contiguous packets received, starting from the first packet not
+ *  yet received. The packets are already written in the file by
+ *  'window_controller_add_packet()', so nothing is written here.
  *
  *  Parameters:
  *  - wc:       Pointer to 'window_controller' through wich execute the operation
- *  - seq:      Sequence number that represent the starting point to writing
- *              all contiguous packets
  *
- *  Return:     The last sequence number that will have to be written
+ *  Return:     The next sequence number that has to be received
  */
-long long int write_contiguous(struct window_controller *wc, long long int min);
+long long int window_controller_advance(struct window_controller *wc);
 
 
 /*  This function frees all the memory occupied by the data structure and its parameters
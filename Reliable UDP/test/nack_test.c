@@ -0,0 +1,190 @@
+//
+//  nack_test.c
+//  Reliable UDP
+//
+//  Created by Simone Minasola on 16/08/15.
+//  Copyright (c) 2015 Simone Minasola. All rights reserved.
+//  <simone.minasola@gmail.com>
+//
+//  GPLV3
+//  This file is part of Reliable UDP.
+//
+//  Reliable UDP is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  Reliabe UDP is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with Reliabe UDP.  If not, see <http://www.gnu.org/licenses/>.
+
+/*  This test checks the recovery of a packet lost on the network with the
+ *  PKT_NACK of the receiving process. A sender and a receiver exchange NUMBER
+ *  packets on two sockets of the loopback interface, and the receiver drops the
+ *  packet LOST: the sender has to send it again from the ranges of the PKT_NACK,
+ *  long before its timer expires.
+ *
+ *  Build and run it with 'make TEST'.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "../src/window_controller.h"
+#include "../src/time_controller.h"
+#include "../src/reorder_buffer.h"
+#include "../src/packet_pool.h"
+#include "../src/window.h"
+#include "../src/utils.h"
+#include "../src/settings.h"
+
+#define NUMBER      5
+#define LOST        2
+#define WAIT_USEC   1000000
+
+
+/*  Exit with an error message if the condition is false */
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "nack_test.c:%d: check failed: %s\n",           \
+                    __LINE__, #cond);                                       \
+            exit(EXIT_FAILURE);                                             \
+        }                                                                   \
+    } while (0)
+
+
+/*  Create a socket bound to a free port of the loopback interface */
+static int new_socket(struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    
+    if (sockfd < 0) {
+        perror("socket() in new_socket()");
+        exit(EXIT_FAILURE);
+    }
+    memset((void*)addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = 0;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sockfd, (struct sockaddr*)addr, sizeof(*addr)) < 0 ||
+        getsockname(sockfd, (struct sockaddr*)addr, &len) < 0) {
+        perror("bind() in new_socket()");
+        exit(EXIT_FAILURE);
+    }
+    
+    return sockfd;
+}
+
+
+/*  Receive a packet, waiting at most WAIT_USEC usecs */
+static struct packet *receive(int sockfd, struct packet_pool *pool) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    
+    CHECK(wait_pkt(sockfd, WAIT_USEC) == 1);
+    return recv_pkt(sockfd, pool, &addr, &len);
+}
+
+
+int main() {
+    struct sockaddr_in saddr, raddr;
+    struct packet *pkts[NUMBER], *pkt;
+    struct packet *nack = new_packet(PKT_NACK, 0, NULL, 0);
+    char data[] = "Reliable UDP";
+    char path[] = "/tmp/nack_test_XXXXXX";
+    long long int seq, first, last;
+    int i;
+    
+    int ssock = new_socket(&saddr);
+    int rsock = new_socket(&raddr);
+    int output = mkstemp(path);
+    CHECK(output != -1);
+    unlink(path);
+    
+    //Sender: the same data structures of 'send_range()' in 'put.c'
+    struct time_controller *tc = new_time_controller(WINDOW_DIMENSION, NULL, LS_CLIENT, NULL);
+    struct packet_pool *spool = new_packet_pool(WINDOW_DIMENSION + IO_BATCH_SIZE);
+    struct window_controller *swc = new_window_controller(WINDOW_DIMENSION, tc, ssock, raddr, -1, spool, CC_NONE);
+    window_controller_start_at(swc, 1);
+    tc->wc = swc;
+    //Receiver: the same data structures of 'receive_range()' in 'get.c'
+    struct packet_pool *rpool = new_packet_pool(IO_BATCH_SIZE);
+    struct window_controller *rwc = new_window_controller(WINDOW_DIMENSION, NULL, rsock, saddr, output, rpool, CC_NONE);
+    window_controller_start_at(rwc, 1);
+    
+    //Send all the packets
+    CHECK(window_controller_can_send(swc) >= NUMBER);
+    for (i = 0; i < NUMBER; ++i)
+        pkts[i] = packet_pool_new_packet(spool, PKT_DATA, i + 1, data, sizeof(data));
+    window_controller_add_packets(swc, pkts, NUMBER);
+    
+    //Receive them, without the lost one: the first packet after the hole opens
+    //it, and the PKT_NACK is sent at once
+    for (i = 0; i < NUMBER; ++i) {
+        pkt = receive(rsock, rpool);
+        seq = pkt->seq;
+        if (seq == LOST) {
+            packet_pool_put(rpool, pkt);
+            continue;
+        }
+        window_controller_add_packet(rwc, pkt);
+        window_controller_advance(rwc);
+        if (seq == LOST + 1) {
+            CHECK(window_controller_fill_nack(rwc, nack) == 1);
+            packet_get_nack_range(nack, 0, &first, &last);
+            CHECK(first == LOST && last == LOST);
+            send_pkt(rsock, nack, saddr);
+        }
+    }
+    
+    //The PKT_NACK is repeated while the hole remains, at most NACK_MAX_REPEATS
+    //times and not before NACK_INTERVAL_USEC usecs
+    struct packet *repeat = new_packet(PKT_NACK, 0, NULL, 0);
+    for (i = 0; i < NACK_MAX_REPEATS; ++i) {
+        usleep(NACK_INTERVAL_USEC);
+        CHECK(window_controller_fill_nack(rwc, repeat) == 1);
+    }
+    usleep(NACK_INTERVAL_USEC);
+    CHECK(window_controller_fill_nack(rwc, repeat) == 0);
+    packet_delete(repeat);
+    
+    //The sender sends the lost packet again from the ranges of the PKT_NACK...
+    pkt = receive(ssock, spool);
+    CHECK(pkt->type == PKT_NACK);
+    CHECK(window_controller_resend_ranges(swc, pkt) == 1);
+    packet_pool_put(spool, pkt);
+    pkt = window_search_by_seq(swc->w, LOST);
+    CHECK(pkt != NULL && pkt->retransmitted == 1);
+    //...and not because its timer expired
+    CHECK(pkt->retries == 0);
+    
+    //The receiver has no more holes
+    pkt = receive(rsock, rpool);
+    CHECK(pkt->seq == LOST);
+    window_controller_add_packet(rwc, pkt);
+    CHECK(window_controller_advance(rwc) == NUMBER + 1);
+    CHECK(window_controller_fill_nack(rwc, nack) == 0);
+    
+    printf("nack_test: OK\n");
+    
+    window_controller_dispose(swc);
+    time_controller_dispose(tc);
+    window_controller_dispose(rwc);
+    packet_pool_delete(spool);
+    packet_pool_delete(rpool);
+    packet_delete(nack);
+    close(output);
+    close(ssock);
+    close(rsock);
+    return EXIT_SUCCESS;
+}